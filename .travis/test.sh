@@ -8,6 +8,41 @@ do_test_encoding() {
     echo "Done $1"
 }
 
+# Regex mode split with --node must give each candidate to exactly one node
+do_test_regex_node() {
+    echo "Testing regex --node split"
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' > regex-all.txt
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' --node=1/3 > regex-node.txt
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' --node=2-3/3 >> regex-node.txt
+    sort regex-all.txt > regex-all.sorted
+    sort regex-node.txt > regex-node.sorted
+    test "$(wc -l < regex-all.txt)" -eq 67600
+    cmp regex-all.sorted regex-node.sorted
+    rm -f regex-all.txt regex-node.txt regex-all.sorted regex-node.sorted
+    echo "Done regex --node split"
+}
+
+# An interrupted regex session, restored, must go on exactly where it stopped.
+# Runs stopped by --max-candidates exit with status 1.  With --node, that
+# limit is divided by the node count.
+do_test_regex_restore() {
+    echo "Testing regex restore"
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' > regex-all.txt
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' --session=regex-rst \
+        --max-candidates=30000 > regex-rst.txt || true
+    ../run/john --restore=regex-rst >> regex-rst.txt || true
+    ../run/john --restore=regex-rst >> regex-rst.txt
+    cmp regex-all.txt regex-rst.txt
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' --node=2/3 > regex-all.txt
+    ../run/john --stdout --regex='[a-z]{2}[0-9]{2}' --node=2/3 \
+        --session=regex-rst --max-candidates=30000 > regex-rst.txt || true
+    ../run/john --restore=regex-rst >> regex-rst.txt || true
+    ../run/john --restore=regex-rst >> regex-rst.txt
+    cmp regex-all.txt regex-rst.txt
+    rm -f regex-all.txt regex-rst.txt regex-rst.log
+    echo "Done regex restore"
+}
+
 # There is a bug in echo -e in Travis
 echo '[Local:Disabled:Formats]' > john-local.conf
 echo 'Raw-SHA512-free-opencl = Y' >> john-local.conf
@@ -33,6 +68,11 @@ else
         do_test_encoding cpu
     fi
 
+    if ../run/john --list=build-info | grep -q '^Regex library' ; then
+        do_test_regex_node
+        do_test_regex_restore
+    fi
+
     if test "$OPENCL" = "yes" ; then
         ../run/john -test-full=0 --format=opencl
 
@@ -167,7 +167,7 @@ static int cmp_one(void *binary, int index)
 
 static int cmp_exact(char *source, int index)
 {
-#if BF_mt == 1
+#if BF_mt == 1 && !BF_SIMD
 	BF_std_crypt_exact(index);
 #endif
 
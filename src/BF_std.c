@@ -33,6 +33,10 @@
 #include "arch.h"
 #include "common.h"
 #include "BF_std.h"
+#if BF_SIMD
+#include <immintrin.h>
+#include "memory.h"
+#endif
 #include "memdbg.h"
 
 BF_binary BF_out[BF_N];
@@ -89,7 +93,7 @@ BF_binary BF_out[BF_N];
 	for_each_index()
 #endif
 
-#if BF_mt == 1
+#if BF_mt == 1 && !BF_SIMD
 /* Current Blowfish context */
 #if BF_ASM
 extern
@@ -359,6 +363,187 @@ extern void (*BF_body)(void);
 
 #endif
 
+#if BF_SIMD
+/*
+ * BF_SIMD_LANES instances, one per 32-bit lane of a vector.  The S-boxes of
+ * all lanes are interleaved, so that a lane's entry x is at x * BF_SIMD_LANES
+ * plus the lane number, and the S-box and P-box updates after each block are
+ * plain vector stores.  The lookups are gathers.
+ */
+#if __AVX512F__
+typedef __m512i BF_vec;
+#define BF_SIMD_SHIFT			4
+#define vload(p)			_mm512_load_si512((void *)(p))
+#define vstore(p, x)			_mm512_store_si512((void *)(p), x)
+#define vset1(x)			_mm512_set1_epi32(x)
+#define vxor				_mm512_xor_si512
+#define vand				_mm512_and_si512
+#define vadd				_mm512_add_epi32
+#define vsrli				_mm512_srli_epi32
+#define vslli				_mm512_slli_epi32
+#define vgather(base, idx)		_mm512_i32gather_epi32(idx, base, 4)
+#define vlanes() \
+	_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#else
+typedef __m256i BF_vec;
+#define BF_SIMD_SHIFT			3
+#define vload(p)			_mm256_load_si256((void *)(p))
+#define vstore(p, x)			_mm256_store_si256((void *)(p), x)
+#define vset1(x)			_mm256_set1_epi32(x)
+#define vxor				_mm256_xor_si256
+#define vand				_mm256_and_si256
+#define vadd				_mm256_add_epi32
+#define vsrli				_mm256_srli_epi32
+#define vslli				_mm256_slli_epi32
+#define vgather(base, idx)		_mm256_i32gather_epi32((int *)(base), idx, 4)
+#define vlanes()			_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)
+#endif
+
+struct BF_simd_ctx {
+	BF_vec S[4][0x100];
+	BF_vec P[BF_ROUNDS + 2];
+};
+
+#define BF_SIMD_INDEX(x, n) \
+	vadd(vslli(vand(vsrli(x, n), mask), BF_SIMD_SHIFT), lanes)
+
+#define BF_SIMD_ROUND(ctx, L, R, N) \
+	tmp1 = vgather((int *)ctx->S[3], BF_SIMD_INDEX(L, 0)); \
+	tmp2 = vgather((int *)ctx->S[2], BF_SIMD_INDEX(L, 8)); \
+	tmp3 = vgather((int *)ctx->S[1], BF_SIMD_INDEX(L, 16)); \
+	tmp4 = vgather((int *)ctx->S[0], BF_SIMD_INDEX(L, 24)); \
+	tmp3 = vadd(tmp3, tmp4); \
+	tmp3 = vxor(tmp3, tmp2); \
+	R = vxor(R, ctx->P[N + 1]); \
+	tmp3 = vadd(tmp3, tmp1); \
+	R = vxor(R, tmp3);
+
+#define BF_SIMD_ENCRYPT(ctx, L, R) \
+	L = vxor(L, ctx->P[0]); \
+	BF_SIMD_ROUND(ctx, L, R, 0); \
+	BF_SIMD_ROUND(ctx, R, L, 1); \
+	BF_SIMD_ROUND(ctx, L, R, 2); \
+	BF_SIMD_ROUND(ctx, R, L, 3); \
+	BF_SIMD_ROUND(ctx, L, R, 4); \
+	BF_SIMD_ROUND(ctx, R, L, 5); \
+	BF_SIMD_ROUND(ctx, L, R, 6); \
+	BF_SIMD_ROUND(ctx, R, L, 7); \
+	BF_SIMD_ROUND(ctx, L, R, 8); \
+	BF_SIMD_ROUND(ctx, R, L, 9); \
+	BF_SIMD_ROUND(ctx, L, R, 10); \
+	BF_SIMD_ROUND(ctx, R, L, 11); \
+	BF_SIMD_ROUND(ctx, L, R, 12); \
+	BF_SIMD_ROUND(ctx, R, L, 13); \
+	BF_SIMD_ROUND(ctx, L, R, 14); \
+	BF_SIMD_ROUND(ctx, R, L, 15); \
+	tmp4 = R; \
+	R = L; \
+	L = vxor(tmp4, ctx->P[BF_ROUNDS + 1]);
+
+/*
+ * Computes BF_out for the BF_SIMD_LANES keys starting at index.
+ */
+static void BF_simd_crypt(BF_salt *salt, int index)
+{
+	struct BF_simd_ctx *ctx;
+	BF_vec exp_key[BF_ROUNDS + 2], salt_w[4];
+	BF_vec L, R, tmp1, tmp2, tmp3, tmp4, *ptr;
+	BF_vec mask = vset1(0xFF), lanes = vlanes();
+	BF_vec out[6];
+	BF_word count, *w;
+	int i, j;
+
+	ctx = mem_alloc_align(sizeof(*ctx), MEM_ALIGN_CACHE);
+
+	for (i = 0; i < 4; i++)
+		salt_w[i] = vset1(salt->salt[i]);
+
+	for (i = 0; i < 4; i++)
+	for (j = 0; j < 0x100; j++)
+		ctx->S[i][j] = vset1(BF_init_state.S[i][j]);
+
+	for (i = 0; i < BF_ROUNDS + 2; i++) {
+		w = (BF_word *)&ctx->P[i];
+		for (j = 0; j < BF_SIMD_LANES; j++)
+			w[j] = BF_init_key[index + j][i];
+		w = (BF_word *)&exp_key[i];
+		for (j = 0; j < BF_SIMD_LANES; j++)
+			w[j] = BF_exp_key[index + j][i];
+	}
+
+	L = R = vset1(0);
+	for (i = 0; i < BF_ROUNDS + 2; i += 2) {
+		L = vxor(L, salt_w[i & 2]);
+		R = vxor(R, salt_w[(i & 2) + 1]);
+		BF_SIMD_ENCRYPT(ctx, L, R);
+		ctx->P[i] = L;
+		ctx->P[i + 1] = R;
+	}
+
+	ptr = ctx->S[0];
+	do {
+		ptr += 4;
+		L = vxor(L, salt_w[(BF_ROUNDS + 2) & 3]);
+		R = vxor(R, salt_w[(BF_ROUNDS + 3) & 3]);
+		BF_SIMD_ENCRYPT(ctx, L, R);
+		vstore(ptr - 4, L);
+		vstore(ptr - 3, R);
+
+		L = vxor(L, salt_w[(BF_ROUNDS + 4) & 3]);
+		R = vxor(R, salt_w[(BF_ROUNDS + 5) & 3]);
+		BF_SIMD_ENCRYPT(ctx, L, R);
+		vstore(ptr - 2, L);
+		vstore(ptr - 1, R);
+	} while (ptr < &ctx->S[3][0xFF]);
+
+	count = 1 << salt->rounds;
+	do {
+		for (j = 0; j < 2; j++) {
+			for (i = 0; i < BF_ROUNDS + 2; i++)
+				ctx->P[i] = vxor(ctx->P[i],
+				    j ? salt_w[i & 3] : exp_key[i]);
+
+			L = R = vset1(0);
+			for (i = 0; i < BF_ROUNDS + 2; i += 2) {
+				BF_SIMD_ENCRYPT(ctx, L, R);
+				ctx->P[i] = L;
+				ctx->P[i + 1] = R;
+			}
+
+			ptr = ctx->S[0];
+			do {
+				ptr += 2;
+				BF_SIMD_ENCRYPT(ctx, L, R);
+				vstore(ptr - 2, L);
+				vstore(ptr - 1, R);
+			} while (ptr < &ctx->S[3][0xFF]);
+		}
+	} while (--count);
+
+	for (i = 0; i < 6; i += 2) {
+		L = vset1(BF_magic_w[i]);
+		R = vset1(BF_magic_w[i + 1]);
+
+		count = 64;
+		do {
+			BF_SIMD_ENCRYPT(ctx, L, R);
+		} while (--count);
+
+		out[i] = L;
+		out[i + 1] = R;
+	}
+
+	for (j = 0; j < BF_SIMD_LANES; j++) {
+		for (i = 0; i < 6; i++)
+			BF_out[index + j][i] = ((BF_word *)&out[i])[j];
+/* This has to be bug-compatible with the original implementation :-) */
+		BF_out[index + j][5] &= ~(BF_word)0xFF;
+	}
+
+	MEM_FREE(ctx);
+}
+#endif
+
 void BF_std_set_key(char *key, int index, int sign_extension_bug) {
 	char *ptr = key;
 	int i, j;
@@ -383,6 +568,15 @@ void BF_std_set_key(char *key, int index, int sign_extension_bug) {
 
 void BF_std_crypt(BF_salt *salt, int n)
 {
+#if BF_SIMD
+	int t;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) private(t) shared(n, salt)
+#endif
+	for (t = 0; t < n; t += BF_SIMD_LANES)
+		BF_simd_crypt(salt, t);
+#else
 #if BF_mt > 1
 	int t;
 #endif
@@ -545,9 +739,10 @@ void BF_std_crypt(BF_salt *salt, int n)
 		}
 #endif
 	}
+#endif
 }
 
-#if BF_mt == 1
+#if BF_mt == 1 && !BF_SIMD
 void BF_std_crypt_exact(int index)
 {
 	BF_word L, R;
@@ -22,7 +22,28 @@
 #include "formats.h"
 #include "BF_common.h"
 
-#if BF_X2 == 3
+/*
+ * With AVX-512 or AVX2, we can instead run 16 or 8 instances at once, in the
+ * 32-bit lanes of vectors, doing the S-box lookups with gather instructions.
+ * Whether that beats BF_X2 interleaving of scalar code depends on the CPU's
+ * gathers and L1 data cache size (the S-boxes take 4 KiB per lane), so it is
+ * only used if BF_SIMD is defined to 1.
+ */
+#ifndef BF_SIMD
+#define BF_SIMD				0
+#endif
+#if BF_SIMD && !((__AVX512F__ || __AVX2__) && !BF_ASM)
+#undef BF_SIMD
+#define BF_SIMD				0
+#endif
+
+#if BF_SIMD && __AVX512F__
+#define BF_SIMD_LANES			16
+#define BF_Nmin				BF_SIMD_LANES
+#elif BF_SIMD
+#define BF_SIMD_LANES			8
+#define BF_Nmin				BF_SIMD_LANES
+#elif BF_X2 == 3
 #define BF_Nmin				3
 #elif BF_X2
 #define BF_Nmin				2
@@ -44,7 +65,11 @@
  */
 extern BF_binary BF_out[BF_N];
 
-#if BF_X2 == 3
+#if BF_SIMD && __AVX512F__
+#define BF_ALGORITHM_NAME		"Blowfish 512/512 AVX512F gather"
+#elif BF_SIMD
+#define BF_ALGORITHM_NAME		"Blowfish 256/256 AVX2 gather"
+#elif BF_X2 == 3
 #define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR " X3"
 #elif BF_X2
 #define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR " X2"
@@ -59,11 +84,11 @@ extern void BF_std_set_key(char *key, int index, int sign_extension_bug);
 
 /*
  * Main hashing routine, sets first two words of BF_out
- * (or all words in an OpenMP-enabled build).
+ * (or all words in an OpenMP-enabled or BF_SIMD build).
  */
 extern void BF_std_crypt(BF_salt *salt, int n);
 
-#if BF_mt == 1
+#if BF_mt == 1 && !BF_SIMD
 /*
  * Calculates the rest of BF_out, for exact comparison.
  */
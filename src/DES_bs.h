@@ -83,7 +83,9 @@ extern DES_bs_vector DES_bs_P[64];
 
 #if defined(_OPENMP) && !DES_BS_ASM
 #define DES_bs_mt			1
-#if __AVX2__
+#if __AVX512F__
+#define DES_bs_cpt			8
+#elif __AVX2__
 #define DES_bs_cpt			16
 #else
 #define DES_bs_cpt			32
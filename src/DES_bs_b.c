@@ -326,6 +326,37 @@ typedef struct {
 	(dst).f = vec_sel((a).f, (b).f, (vector bool int)(c).f); \
 	(dst).g = vec_sel((a).g, (b).g, (vector bool int)(c).g)
 
+#elif defined(__AVX512F__) && DES_BS_DEPTH == 512
+#include <immintrin.h>
+
+typedef __m512i vtype;
+
+#define vst(dst, ofs, src) \
+	_mm512_store_si512((vtype *)((DES_bs_vector *)&(dst) + (ofs)), (src))
+
+#define vxorf(a, b) \
+	_mm512_xor_si512((a), (b))
+
+#define vand(dst, a, b) \
+	(dst) = _mm512_and_si512((a), (b))
+#define vor(dst, a, b) \
+	(dst) = _mm512_or_si512((a), (b))
+#define vandn(dst, a, b) \
+	(dst) = _mm512_andnot_si512((b), (a))
+#define vsel(dst, a, b, c) \
+	(dst) = _mm512_ternarylogic_epi32((b), (a), (c), 0xE4)
+
+/* Any function of three inputs, as in lop3.b32: a is 0xF0, b 0xCC, c 0xAA */
+#define vlut3(a, b, c, imm) \
+	_mm512_ternarylogic_epi32((a), (b), (c), (imm))
+
+#define vshl1(dst, src) \
+	(dst) = _mm512_add_epi64((src), (src))
+#define vshl(dst, src, shift) \
+	(dst) = _mm512_slli_epi64((src), (shift))
+#define vshr(dst, src, shift) \
+	(dst) = _mm512_srli_epi64((src), (shift))
+
 #elif defined(__MIC__) && DES_BS_DEPTH == 512
 #include <immintrin.h>
 
@@ -1257,7 +1288,9 @@ void DES_bs_set_salt(ARCH_WORD salt)
 #if !DES_BS_ASM
 
 /* Include the S-boxes here so that the compiler can inline them */
-#if DES_BS == 3
+#if DES_BS == 4
+#include "sboxes-t.c"
+#elif DES_BS == 3
 #include "sboxes-s.c"
 #elif DES_BS == 2
 #include "sboxes.c"
@@ -124,6 +124,20 @@ static unsigned char cursalt[SALT_SIZE];
 static int CryptType;
 static MD5_word (*sout);
 static int omp_para = 1;
+
+/*
+ * The keys and their hashes in the order they're computed in: grouped by
+ * length, so that most vectors' lanes follow identical block layouts.
+ */
+static char (*sorted_key)[PLAINTEXT_LENGTH + 1];
+static MD5_word (*sorted_out);
+static int *key_order;
+
+/* Index of word w of key index's hash in sout */
+#define SOUT_POS(index, w) \
+	(((index) & (SIMD_COEF_32 - 1)) + \
+	 (unsigned int)(index) / SIMD_COEF_32 * SIMD_COEF_32 * 4 + \
+	 (w) * SIMD_COEF_32)
 #endif
 
 static void init(struct fmt_main *self)
@@ -146,12 +160,22 @@ static void init(struct fmt_main *self)
 #ifdef SIMD_PARA_MD5
 	sout = mem_calloc(self->params.max_keys_per_crypt,
 	                  sizeof(*sout) * BINARY_SIZE);
+	sorted_key = mem_calloc_align(self->params.max_keys_per_crypt,
+	                              sizeof(*sorted_key), MEM_ALIGN_CACHE);
+	sorted_out = mem_calloc_align(self->params.max_keys_per_crypt,
+	                              sizeof(*sorted_out) * BINARY_SIZE,
+	                              MEM_ALIGN_SIMD);
+	key_order = mem_calloc(self->params.max_keys_per_crypt,
+	                       sizeof(*key_order));
 #endif
 }
 
 static void done(void)
 {
 #ifdef SIMD_PARA_MD5
+	MEM_FREE(key_order);
+	MEM_FREE(sorted_out);
+	MEM_FREE(sorted_key);
 	MEM_FREE(sout);
 #endif
 	MEM_FREE(saved_key);
@@ -284,18 +308,54 @@ static char *get_key(int index)
 	return saved_key[index];
 }
 
+#ifdef SIMD_PARA_MD5
+/*
+ * Counting sort of the keys by length into sorted_key, so that md5cryptsse()
+ * can put the intermediate digests in place a whole vector at a time.
+ */
+static void sort_keys(int count)
+{
+	int start[PLAINTEXT_LENGTH + 2];
+	int index;
+
+	memset(start, 0, sizeof(start));
+	for (index = 0; index < count; index++)
+		start[strlen(saved_key[index]) + 1]++;
+	for (index = 1; index <= PLAINTEXT_LENGTH; index++)
+		start[index] += start[index - 1];
+	for (index = 0; index < count; index++)
+		key_order[start[strlen(saved_key[index])]++] = index;
+
+	for (index = 0; index < count; index++)
+		memcpy(sorted_key[index], saved_key[key_order[index]],
+		       sizeof(*sorted_key));
+}
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
 #ifdef SIMD_PARA_MD5
+	int index, n = MD5_N * omp_para;
 #ifdef _OPENMP
 	int t;
+#endif
+
+	sort_keys(n);
+#ifdef _OPENMP
 #pragma omp parallel for
 	for (t = 0; t < omp_para; t++)
-		md5cryptsse((unsigned char *)(&saved_key[t*MD5_N]), cursalt, (char *)(&sout[t*MD5_N*BINARY_SIZE/sizeof(MD5_word)]), CryptType);
+		md5cryptsse((unsigned char *)(&sorted_key[t*MD5_N]), cursalt, (char *)(&sorted_out[t*MD5_N*BINARY_SIZE/sizeof(MD5_word)]), CryptType);
 #else
-	md5cryptsse((unsigned char *)saved_key, cursalt, (char *)sout, CryptType);
+	md5cryptsse((unsigned char *)sorted_key, cursalt, (char *)sorted_out, CryptType);
 #endif
+	for (index = 0; index < n; index++) {
+		int w;
+
+		for (w = 0; w < BINARY_SIZE / sizeof(MD5_word); w++)
+			sout[SOUT_POS(key_order[index], w)] =
+				sorted_out[SOUT_POS(index, w)];
+	}
 #else
 	MD5_std_crypt(count);
 #endif
@@ -60,6 +60,7 @@ john_register_one(&fmt_NETLMv2);
 #include "md5.h"
 #include "hmacmd5.h"
 #include "byteorder.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #ifndef uchar
@@ -114,10 +115,7 @@ static unsigned char *challenge;
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_plain = mem_calloc(self->params.max_keys_per_crypt,
 	                         sizeof(*saved_plain));
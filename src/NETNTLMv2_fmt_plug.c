@@ -59,6 +59,7 @@ john_register_one(&fmt_NETNTLMv2);
 #include "hmacmd5.h"
 #include "unicode.h"
 #include "byteorder.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #ifndef uchar
@@ -120,10 +121,7 @@ static int keys_prepared;
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_plain = mem_calloc(self->params.max_keys_per_crypt,
 	                         sizeof(*saved_plain));
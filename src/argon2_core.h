@@ -35,6 +35,7 @@ enum argon2_core_constants {
     ARGON2_BLOCK_SIZE = 1024,
     ARGON2_QWORDS_IN_BLOCK = ARGON2_BLOCK_SIZE / 8,
     ARGON2_OWORDS_IN_BLOCK = ARGON2_BLOCK_SIZE / 16,
+    ARGON2_HWORDS_IN_BLOCK = ARGON2_BLOCK_SIZE / 32,
 
     /* Number of pseudo-random values generated by one call to Blake in Argon2i
        to
@@ -75,7 +76,7 @@ void argon2_xor_block(block *dst, const block *src);
  */
 typedef struct Argon2_instance_t {
     block *memory;          /* Memory pointer */
-    void *pseudo_rands;
+    void *pseudo_rands;     /* segment_length values per lane */
     uint32_t version;
     uint32_t passes;        /* Number of passes */
     uint32_t memory_blocks; /* Number of blocks in memory */
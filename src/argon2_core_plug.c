@@ -26,6 +26,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "argon2_core.h"
 //#include "argon2_thread.h"
@@ -214,7 +217,11 @@ int argon2_fill_memory_blocks(argon2_instance_t *instance) {
             //int rc;
             uint32_t l;
 
-            /* 2. Calling threads */
+            /* 2. Calling threads: the lanes of a slice are filled in
+             * parallel, unless we're already running one hash per thread */
+#ifdef _OPENMP
+#pragma omp parallel for if (instance->threads > 1 && !omp_in_parallel())
+#endif
             for (l = 0; l < instance->lanes; ++l) {
                 argon2_position_t position;
 
@@ -34,7 +34,11 @@ john_register_one(&fmt_argon2);
 #define FORMAT_TAG_i            "$argon2i$"
 #define FORMAT_TAG_LEN          (sizeof(FORMAT_TAG_d)-1)
 
-#if defined(__XOP__)
+#if defined(__AVX512VL__)
+#define ALGORITHM_NAME          "Blake2 AVX512VL"
+#elif defined(__AVX2__)
+#define ALGORITHM_NAME          "Blake2 AVX2"
+#elif defined(__XOP__)
 #define ALGORITHM_NAME          "Blake2 XOP"
 #elif defined(__AVX__)
 #define ALGORITHM_NAME          "Blake2 AVX"
@@ -86,13 +90,19 @@ struct argon2_salt {
 };
 
 static struct argon2_salt saved_salt;
-static region_t * memory;
-static void **pseudo_rands;
+
+/*
+ * One arena, with room for a hash per thread (slots == threads) of the
+ * largest m_cost we've seen, or if that can't be had, for just one hash
+ * (slots == 1), whose lanes are then filled in parallel instead.
+ */
+static region_t memory;
+static uint64_t *pseudo_rands;
+static int slots;
+static uint32_t arena_blocks;
 
 static char *saved_key;
 static int threads;
-static size_t saved_mem_size;
-static uint32_t saved_segment_length;
 
 static unsigned char *crypted;
 
@@ -100,7 +110,6 @@ static void *get_salt(char *ciphertext);
 
 static void init(struct fmt_main *self)
 {
-	int i;
 #ifdef _OPENMP
 	int omp_t = omp_get_max_threads();
 	threads=omp_get_max_threads();
@@ -117,31 +126,54 @@ static void init(struct fmt_main *self)
 	crypted = malloc(self->params.max_keys_per_crypt * (BINARY_SIZE));
 	memset(crypted, 0, self->params.max_keys_per_crypt * (BINARY_SIZE));
 
-	memory=malloc(threads*sizeof(region_t));
-	pseudo_rands=malloc(threads*sizeof(void*));
-
-	for (i=0;i<threads;i++)
-	{
-		init_region_t(&memory[i]);
-		pseudo_rands[i]=NULL;
-	}
-
-	saved_mem_size=0;
-	saved_segment_length=0;
+	init_region_t(&memory);
+	pseudo_rands=NULL;
+	slots=0;
+	arena_blocks=0;
 }
 
 static void done(void)
 {
-	int i;
 	free(saved_key);
 	free(crypted);
-	for (i=0;i<threads;i++)
-	{
-		free_region_t(&memory[i]);
-		free(pseudo_rands[i]);
+	free_region_t(&memory);
+	MEM_FREE(pseudo_rands);
+}
+
+/* Memory blocks actually used for a salt, as argon2_ctx() rounds them */
+static uint32_t salt_memory_blocks(struct argon2_salt *salt)
+{
+	uint32_t memory_blocks = salt->m_cost;
+
+	if (memory_blocks < 2 * ARGON2_SYNC_POINTS * salt->lanes)
+		memory_blocks = 2 * ARGON2_SYNC_POINTS * salt->lanes;
+
+	return memory_blocks;
+}
+
+static void alloc_arena(uint32_t memory_blocks)
+{
+	size_t mem_size = sizeof(block) * memory_blocks;
+
+	if (memory_blocks <= arena_blocks)
+		return;
+
+	free_region_t(&memory);
+	MEM_FREE(pseudo_rands);
+
+	slots = threads;
+	if (!alloc_region_t(&memory, mem_size * slots) && slots > 1) {
+		slots = 1;
+		alloc_region_t(&memory, mem_size);
+	}
+	if (!memory.aligned) {
+		fprintf(stderr, "argon2: can't allocate memory\n");
+		error();
 	}
-	free(memory);
-	free(pseudo_rands);
+	pseudo_rands = mem_alloc(sizeof(uint64_t) *
+		(memory_blocks / ARGON2_SYNC_POINTS) * slots);
+
+	arena_blocks = memory_blocks;
 }
 
 static void print_memory(double memory)
@@ -159,10 +191,26 @@ static void print_memory(double memory)
 static void reset(struct db_main *db)
 {
 	static int printed=0;
+	uint32_t memory_blocks=0, salt_blocks;
+	int i;
+
+	if (!db) {
+		for (i = 0; tests[i].ciphertext; i++) {
+			salt_blocks = salt_memory_blocks(get_salt(tests[i].ciphertext));
+			memory_blocks = MAX(memory_blocks, salt_blocks);
+		}
+	} else {
+		struct db_salt *salts = db->salts;
+		while (salts != NULL) {
+			salt_blocks = salt_memory_blocks(salts->salt);
+			memory_blocks = MAX(memory_blocks, salt_blocks);
+			salts = salts->next;
+		}
+	}
+	alloc_arena(memory_blocks);
 
 	if (!printed && options.verbosity > VERB_LEGACY)
 	{
-		int i;
 		uint32_t m_cost, prev_m_cost;
 		m_cost=prev_m_cost=0;
 		if (!db) {
@@ -291,43 +339,9 @@ static void *get_salt(char *ciphertext)
 
 static void set_salt(void *salt)
 {
-	uint32_t i;
-	size_t mem_size;
-	uint32_t segment_length, memory_blocks;
 	memcpy(&saved_salt,salt,sizeof(struct argon2_salt));
 
-
-	mem_size=sizeof(block)*saved_salt.m_cost;
-
-	memory_blocks = saved_salt.m_cost;
-
-        if (memory_blocks < 2 * ARGON2_SYNC_POINTS * saved_salt.lanes) {
-           memory_blocks = 2 * ARGON2_SYNC_POINTS * saved_salt.lanes;
-        }
-
-	segment_length = memory_blocks / (saved_salt.lanes * ARGON2_SYNC_POINTS);
-
-	if (mem_size>saved_mem_size)
-	{
-		if (saved_mem_size>0)
-			for (i=0;i<threads;i++)
-				free_region_t(&memory[i]);
-		for (i=0;i<threads;i++)
-			alloc_region_t(&memory[i],mem_size);
-
-		saved_mem_size=mem_size;
-	}
-
-	if (segment_length>saved_segment_length)
-	{
-		if (saved_segment_length>0)
-			for (i=0;i<threads;i++)
-				free(pseudo_rands[i]);
-		for (i=0;i<threads;i++)
-			pseudo_rands[i]=malloc(sizeof(uint64_t) * segment_length);
-
-		saved_segment_length=segment_length;
-	}
+	alloc_arena(salt_memory_blocks(&saved_salt));
 }
 
 static int cmp_all(void *binary, int count)
@@ -350,18 +364,39 @@ static int cmp_exact(char *source, int index)
 	return 1;
 }
 
+static void hash_one(int index, int slot)
+{
+	argon2_hash(saved_salt.t_cost, saved_salt.m_cost, saved_salt.lanes,
+	    saved_key + index * (PLAINTEXT_LENGTH + 1),
+	    strlen(saved_key + index * (PLAINTEXT_LENGTH + 1)),
+	    saved_salt.salt, saved_salt.salt_length,
+	    crypted + index * BINARY_SIZE, saved_salt.hash_size, 0, 0,
+	    saved_salt.type, ARGON2_VERSION_NUMBER,
+	    (block *)memory.aligned + (size_t)slot * arena_blocks,
+	    pseudo_rands + (size_t)slot * (arena_blocks / ARGON2_SYNC_POINTS));
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int i;
 	const int count = *pcount;
 
+/*
+ * With fewer keys than threads, or memory for just one hash, do the keys one
+ * at a time and have argon2_fill_memory_blocks() fill the lanes in parallel.
+ */
+	if (slots < threads ||
+	    (count < threads && saved_salt.lanes > 1)) {
+		for (i = 0; i < count; i++)
+			hash_one(i, 0);
+		return count;
+	}
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-	for (i = 0; i < count; i++) {
-		argon2_hash(saved_salt.t_cost, saved_salt.m_cost, saved_salt.lanes, saved_key + i * (PLAINTEXT_LENGTH + 1), strlen(saved_key + i * (PLAINTEXT_LENGTH + 1)), saved_salt.salt,
-		    saved_salt.salt_length, crypted + i * BINARY_SIZE, saved_salt.hash_size, 0, 0, saved_salt.type, ARGON2_VERSION_NUMBER, memory[THREAD_NUMBER%threads].aligned, pseudo_rands[THREAD_NUMBER%threads]);
-	}
+	for (i = 0; i < count; i++)
+		hash_one(i, THREAD_NUMBER % slots);
 
 	return count;
 }
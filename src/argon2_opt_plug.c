@@ -23,22 +23,40 @@
 #include "blamka-round-opt.h"
 #include "memdbg.h"
 
-/* LEGACY CODE: version 1.2.1 and earlier
-* Function fills a new memory block by overwriting @next_block.
-* @param state Pointer to the just produced block. Content will be updated(!)
-* @param ref_block Pointer to the reference block
-* @param next_block Pointer to the block to be XORed over. May coincide with @ref_block
-* @pre all block pointers must be valid
-*/
-static void fill_block(__m128i *state, const uint8_t *ref_block, uint8_t *next_block) {
-    __m128i block_XY[ARGON2_OWORDS_IN_BLOCK];
+#if defined(__AVX2__)
+#define VEC                 __m256i
+#define VECS_IN_BLOCK       ARGON2_HWORDS_IN_BLOCK
+#define VEC_XOR             _mm256_xor_si256
+#define VEC_LOADU(p)        _mm256_loadu_si256((VEC const *)(p))
+#define VEC_STOREU(p, x)    _mm256_storeu_si256((VEC *)(p), (x))
+#else
+#define VEC                 __m128i
+#define VECS_IN_BLOCK       ARGON2_OWORDS_IN_BLOCK
+#define VEC_XOR             _mm_xor_si128
+#define VEC_LOADU(p)        _mm_loadu_si128((VEC const *)(p))
+#define VEC_STOREU(p, x)    _mm_storeu_si128((VEC *)(p), (x))
+#endif
+
+/*
+ * The BlaMka permutation of a block: the eight rows, then the eight columns,
+ * of 16 words each.
+ */
+static void blamka_rounds(VEC *state) {
     uint32_t i;
 
-    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {
-        block_XY[i] = state[i] = _mm_xor_si128(
-            state[i], _mm_loadu_si128((__m128i const *)(&ref_block[16 * i])));
+#if defined(__AVX2__)
+    for (i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_ROWS_256(state[8 * i + 0], state[8 * i + 1],
+            state[8 * i + 2], state[8 * i + 3], state[8 * i + 4],
+            state[8 * i + 5], state[8 * i + 6], state[8 * i + 7]);
     }
 
+    for (i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_COLS_256(state[4 * 0 + i], state[4 * 1 + i],
+            state[4 * 2 + i], state[4 * 3 + i], state[4 * 4 + i],
+            state[4 * 5 + i], state[4 * 6 + i], state[4 * 7 + i]);
+    }
+#else
     for (i = 0; i < 8; ++i) {
         BLAKE2_ROUND(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2],
             state[8 * i + 3], state[8 * i + 4], state[8 * i + 5],
@@ -50,10 +68,30 @@ static void fill_block(__m128i *state, const uint8_t *ref_block, uint8_t *next_b
             state[8 * 3 + i], state[8 * 4 + i], state[8 * 5 + i],
             state[8 * 6 + i], state[8 * 7 + i]);
     }
+#endif
+}
 
-    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {
-        state[i] = _mm_xor_si128(state[i], block_XY[i]);
-        _mm_storeu_si128((__m128i *)(&next_block[16 * i]), state[i]);
+/* LEGACY CODE: version 1.2.1 and earlier
+* Function fills a new memory block by overwriting @next_block.
+* @param state Pointer to the just produced block. Content will be updated(!)
+* @param ref_block Pointer to the reference block
+* @param next_block Pointer to the block to be XORed over. May coincide with @ref_block
+* @pre all block pointers must be valid
+*/
+static void fill_block(VEC *state, const uint8_t *ref_block, uint8_t *next_block) {
+    VEC block_XY[VECS_IN_BLOCK];
+    uint32_t i;
+
+    for (i = 0; i < VECS_IN_BLOCK; i++) {
+        block_XY[i] = state[i] = VEC_XOR(
+            state[i], VEC_LOADU(&ref_block[sizeof(VEC) * i]));
+    }
+
+    blamka_rounds(state);
+
+    for (i = 0; i < VECS_IN_BLOCK; i++) {
+        state[i] = VEC_XOR(state[i], block_XY[i]);
+        VEC_STOREU(&next_block[sizeof(VEC) * i], state[i]);
     }
 }
 
@@ -65,33 +103,23 @@ static void fill_block(__m128i *state, const uint8_t *ref_block, uint8_t *next_b
  * @param next_block Pointer to the block to be XORed over. May coincide with @ref_block
  * @pre all block pointers must be valid
  */
-static void fill_block_with_xor(__m128i *state, const uint8_t *ref_block,
+static void fill_block_with_xor(VEC *state, const uint8_t *ref_block,
                          uint8_t *next_block) {
-    __m128i block_XY[ARGON2_OWORDS_IN_BLOCK];
+    VEC block_XY[VECS_IN_BLOCK];
     uint32_t i;
 
-    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {
-       state[i] = _mm_xor_si128(
-            state[i], _mm_loadu_si128((__m128i const *)(&ref_block[16 * i])));
-        block_XY[i] =  _mm_xor_si128(
-            state[i], _mm_loadu_si128((__m128i const *)(&next_block[16 * i])));
+    for (i = 0; i < VECS_IN_BLOCK; i++) {
+        state[i] = VEC_XOR(
+            state[i], VEC_LOADU(&ref_block[sizeof(VEC) * i]));
+        block_XY[i] = VEC_XOR(
+            state[i], VEC_LOADU(&next_block[sizeof(VEC) * i]));
     }
 
-    for (i = 0; i < 8; ++i) {
-        BLAKE2_ROUND(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2],
-                     state[8 * i + 3], state[8 * i + 4], state[8 * i + 5],
-                     state[8 * i + 6], state[8 * i + 7]);
-    }
-
-    for (i = 0; i < 8; ++i) {
-        BLAKE2_ROUND(state[8 * 0 + i], state[8 * 1 + i], state[8 * 2 + i],
-                     state[8 * 3 + i], state[8 * 4 + i], state[8 * 5 + i],
-                     state[8 * 6 + i], state[8 * 7 + i]);
-    }
+    blamka_rounds(state);
 
-    for (i = 0; i < ARGON2_OWORDS_IN_BLOCK; i++) {
-        state[i] = _mm_xor_si128(state[i], block_XY[i]);
-        _mm_storeu_si128((__m128i *)(&next_block[16 * i]), state[i]);
+    for (i = 0; i < VECS_IN_BLOCK; i++) {
+        state[i] = VEC_XOR(state[i], block_XY[i]);
+        VEC_STOREU(&next_block[sizeof(VEC) * i], state[i]);
     }
 }
 
@@ -123,8 +151,8 @@ static void generate_addresses(const argon2_instance_t *instance,
         for (i = 0; i < instance->segment_length; ++i) {
             if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
                 /*Temporary zero-initialized blocks*/
-                __m128i zero_block[ARGON2_OWORDS_IN_BLOCK];
-                __m128i zero2_block[ARGON2_OWORDS_IN_BLOCK];
+                VEC zero_block[VECS_IN_BLOCK];
+                VEC zero2_block[VECS_IN_BLOCK];
                 memset(zero_block, 0, sizeof(zero_block));
                 memset(zero2_block, 0, sizeof(zero2_block));
                 argon2_init_block_value(&address_block, 0);
@@ -150,7 +178,7 @@ void argon2_fill_segment(const argon2_instance_t *instance,
     uint64_t pseudo_rand, ref_index, ref_lane;
     uint32_t prev_offset, curr_offset;
     uint32_t starting_index, i;
-    __m128i state[64];
+    VEC state[VECS_IN_BLOCK];
     int data_independent_addressing;
 
     /* Pseudo-random values that determine the reference block position */
@@ -162,7 +190,9 @@ void argon2_fill_segment(const argon2_instance_t *instance,
 
     data_independent_addressing = (instance->type == Argon2_i);
 
-    pseudo_rands = instance->pseudo_rands;
+    /* Each lane has its own, so that lanes can be filled in parallel */
+    pseudo_rands = (uint64_t *)instance->pseudo_rands +
+        (size_t)position.lane * instance->segment_length;
 
     if (data_independent_addressing) {
         generate_addresses(instance, &position, pseudo_rands);
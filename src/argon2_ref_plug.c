@@ -172,7 +172,9 @@ void argon2_fill_segment(const argon2_instance_t *instance,
 
     data_independent_addressing = (instance->type == Argon2_i);
 
-    pseudo_rands = instance->pseudo_rands;
+    /* Each lane has its own, so that lanes can be filled in parallel */
+    pseudo_rands = (uint64_t *)instance->pseudo_rands +
+        (size_t)position.lane * instance->segment_length;
 
     if (data_independent_addressing) {
         generate_addresses(instance, &position, pseudo_rands);
@@ -35,6 +35,7 @@
 #include <sys/times.h>
 #endif
 #include <stdlib.h> /* setenv */
+#include <math.h>
 
 #include "times.h"
 
@@ -55,6 +56,9 @@
 
 #ifndef BENCH_BUILD
 #include "options.h"
+#include "path.h"
+#include "cracker.h"
+#include "omp_autotune.h"
 #else
 /*
  * This code was copied from loader.c.  It has been stripped to bare bones
@@ -196,6 +200,41 @@ void clk_tck_init(void)
 
 int benchmark_time = BENCHMARK_TIME;
 int benchmark_level = -1;
+int benchmark_repeat = 1;
+char *benchmark_output, *benchmark_compare;
+char *benchmark_hashes, *benchmark_threads;
+
+/*
+ * Statistics of one benchmark's c/s over the repeated runs.
+ */
+struct bench_stats {
+	double median, stddev, min, max;
+};
+
+#ifndef BENCH_BUILD
+/* Tunable cost values of the first test vector, as benchmarked */
+static unsigned int bench_cost[FMT_TUNABLE_COSTS];
+static int bench_costs;
+
+/* A result read back from a --bench-output file */
+struct bench_record {
+	struct bench_record *next;
+	char *format, *test;
+	double median, stddev;
+};
+
+static struct bench_record *bench_baseline;
+static FILE *bench_output_file;
+static double bench_threshold;
+static int bench_regressions, bench_improvements;
+
+/* Database of generated hashes that crypt_all() results are looked up in */
+static struct db_main *bench_scaling_db;
+
+/* Parsed --bench-hashes and --bench-threads */
+static int bench_hash_count[BENCHMARK_SCALING_MAX], bench_hash_counts;
+static int bench_thread_count[BENCHMARK_SCALING_MAX], bench_thread_counts;
+#endif
 
 volatile int bench_running;
 
@@ -412,6 +451,11 @@ char *benchmark_format(struct fmt_main *format, int salts,
 	format->methods.set_salt(two_salts[0]);
 
 #ifndef BENCH_BUILD
+	for (i = 0; i < FMT_TUNABLE_COSTS &&
+		     format->methods.tunable_cost_value[i] != NULL; i++)
+		bench_cost[i] = t_cost[0][i];
+	bench_costs = i;
+
 	*cost_msg = 0;
 	for (i = 0; i < FMT_TUNABLE_COSTS &&
 		     format->methods.tunable_cost_value[i] != NULL; i++) {
@@ -527,6 +571,12 @@ char *benchmark_format(struct fmt_main *format, int salts,
 
 		if (salts > 1) format->methods.set_salt(two_salts[index & 1]);
 #ifndef BENCH_BUILD
+		if (bench_scaling_db)
+			crk_bench_compare(bench_scaling_db,
+			    bench_scaling_db->salts,
+			    format->methods.crypt_all(&count,
+			    bench_scaling_db->salts));
+		else
 		format->methods.cmp_all(binary,
 		    format->methods.crypt_all(&count, test_db->salts));
 #else
@@ -588,6 +638,529 @@ char *benchmark_format(struct fmt_main *format, int salts,
 	return event_abort ? "" : NULL;
 }
 
+static int bench_cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void bench_get_stats(double *cps, int count, struct bench_stats *stats)
+{
+	double sum, var;
+	int i;
+
+	qsort(cps, count, sizeof(*cps), bench_cmp_double);
+
+	stats->min = cps[0];
+	stats->max = cps[count - 1];
+	if (count & 1)
+		stats->median = cps[count / 2];
+	else
+		stats->median = (cps[count / 2 - 1] + cps[count / 2]) / 2;
+
+	for (sum = 0, i = 0; i < count; i++)
+		sum += cps[i];
+	for (var = 0, i = 0; i < count; i++)
+		var += (cps[i] - sum / count) * (cps[i] - sum / count);
+	stats->stddev = count > 1 ? sqrt(var / (count - 1)) : 0;
+}
+
+/*
+ * Runs benchmark_format() benchmark_repeat times.  Returns the median run (by
+ * real c/s) in results, and the stats over all runs.
+ */
+static char *benchmark_repeated(struct fmt_main *format, int salts,
+	struct bench_results *results, struct db_main *test_db,
+	struct bench_stats *real, struct bench_stats *virtual)
+{
+	int count = benchmark_repeat > 1 ? benchmark_repeat : 1;
+	struct bench_results *runs;
+	double *cps_real, *cps_virtual, median;
+	char *result = NULL;
+	int i, best;
+
+	runs = mem_alloc(count * sizeof(*runs));
+	cps_real = mem_alloc(count * sizeof(*cps_real));
+	cps_virtual = mem_alloc(count * sizeof(*cps_virtual));
+
+	for (i = 0; i < count; i++) {
+		double crypts;
+
+		if ((result = benchmark_format(format, salts, &runs[i],
+		    test_db)))
+			goto out;
+
+		crypts = (double)runs[i].crypts.hi * 4294967296.0 +
+			runs[i].crypts.lo;
+		cps_real[i] = crypts * clk_tck / runs[i].real;
+		cps_virtual[i] = crypts * clk_tck / runs[i].virtual;
+	}
+
+/* Pick the run closest to the median for the usual output */
+	best = 0;
+	if (count > 1) {
+		double *sorted = mem_alloc(count * sizeof(*sorted));
+
+		memcpy(sorted, cps_real, count * sizeof(*sorted));
+		bench_get_stats(sorted, count, real);
+		median = real->median;
+		MEM_FREE(sorted);
+		for (i = 1; i < count; i++)
+			if (fabs(cps_real[i] - median) <
+			    fabs(cps_real[best] - median))
+				best = i;
+	}
+	memcpy(results, &runs[best], sizeof(*results));
+
+	bench_get_stats(cps_real, count, real);
+	bench_get_stats(cps_virtual, count, virtual);
+
+out:
+	MEM_FREE(cps_virtual);
+	MEM_FREE(cps_real);
+	MEM_FREE(runs);
+
+	return result;
+}
+
+#ifndef BENCH_BUILD
+static void bench_put_string(FILE *file, char *s)
+{
+	putc('"', file);
+	while (*s) {
+		if (*s == '"' || *s == '\\')
+			putc('\\', file);
+		if ((unsigned char)*s >= 0x20)
+			putc(*s, file);
+		s++;
+	}
+	putc('"', file);
+}
+
+/*
+ * Returns the value of a string field in one of our JSON lines, or NULL.
+ */
+static char *bench_get_string(char *line, char *key)
+{
+	char pattern[64], *p, *q, *value;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+	if (!(p = strstr(line, pattern)))
+		return NULL;
+	p += strlen(pattern);
+
+	value = q = mem_alloc_tiny(strlen(p) + 1, MEM_ALIGN_NONE);
+	while (*p && *p != '"') {
+		if (*p == '\\' && p[1])
+			p++;
+		*q++ = *p++;
+	}
+	*q = 0;
+
+	return value;
+}
+
+/*
+ * Gets the value of a number field in one of our JSON lines.  Returns zero
+ * on success.
+ */
+static int bench_get_number(char *line, char *key, double *value)
+{
+	char pattern[64], *p;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+	if (!(p = strstr(line, pattern)))
+		return -1;
+
+	return sscanf(p + strlen(pattern), "%lf", value) != 1;
+}
+
+static struct bench_record *bench_load(char *name)
+{
+	struct bench_record *head = NULL, **tail = &head;
+	char line[LINE_BUFFER_SIZE];
+	FILE *file;
+
+	if (!(file = fopen(path_expand(name), "r")))
+		pexit("fopen: %s", path_expand(name));
+
+	while (fgets(line, sizeof(line), file)) {
+		struct bench_record record, *copy;
+
+		if (!(record.format = bench_get_string(line, "format")) ||
+		    !(record.test = bench_get_string(line, "test")) ||
+		    bench_get_number(line, "real_cps_median", &record.median))
+			continue;
+		if (bench_get_number(line, "real_cps_stddev", &record.stddev))
+			record.stddev = 0;
+
+		copy = mem_alloc_tiny(sizeof(*copy), MEM_ALIGN_WORD);
+		memcpy(copy, &record, sizeof(*copy));
+		copy->next = NULL;
+		*tail = copy;
+		tail = &copy->next;
+	}
+
+	if (ferror(file))
+		pexit("fgets");
+	fclose(file);
+
+	return head;
+}
+
+static struct bench_record *bench_find(struct bench_record *list,
+	char *format, char *test)
+{
+	for (; list; list = list->next)
+		if (!strcmp(list->format, format) && !strcmp(list->test, test))
+			return list;
+
+	return NULL;
+}
+
+static void bench_init_compare(void)
+{
+	int threshold = cfg_get_int(SECTION_OPTIONS, NULL,
+	                            "BenchRegressionThreshold");
+
+	if (threshold < 0)
+		threshold = BENCHMARK_REGRESSION;
+	bench_threshold = threshold;
+	bench_regressions = bench_improvements = 0;
+}
+
+/*
+ * Reports a change beyond the threshold, returning -1 for a regression, 1
+ * for an improvement or 0 otherwise.
+ */
+static int bench_check(char *prefix, struct bench_record *old,
+	double median)
+{
+	double change = 100 * (median - old->median) / old->median;
+	char *verdict;
+	int ret;
+
+	if (change < -bench_threshold) {
+		verdict = "REGRESSION";
+		bench_regressions++;
+		ret = -1;
+	} else if (change > bench_threshold) {
+		verdict = "improvement";
+		bench_improvements++;
+		ret = 1;
+	} else {
+		verdict = NULL;
+		ret = 0;
+	}
+
+	if (prefix || verdict)
+		printf("%s%.0f -> %.0f c/s real (%+.1f%%)%s%s\n",
+		       prefix ? prefix : "", old->median, median, change,
+		       verdict ? ", " : "", verdict ? verdict : "");
+
+	return ret;
+}
+
+static void bench_write(struct fmt_main *format, char *test, int salts,
+	int threads, struct bench_stats *real, struct bench_stats *virtual)
+{
+	FILE *file = bench_output_file;
+	int i;
+
+	fprintf(file, "{\"format\": ");
+	bench_put_string(file, format->params.label);
+	fprintf(file, ", \"algorithm\": ");
+	bench_put_string(file, format->params.algorithm_name);
+	fprintf(file, ", \"test\": ");
+	bench_put_string(file, test);
+	fprintf(file, ", \"salts\": %d, \"time\": %d, \"repeats\": %d, "
+	        "\"threads\": %d, \"simd_coef_32\": %d, \"min_keys\": %d, "
+	        "\"max_keys\": %d, \"costs\": [",
+	        salts, benchmark_time, benchmark_repeat > 1 ?
+	        benchmark_repeat : 1, threads,
+#ifdef SIMD_COEF_32
+	        SIMD_COEF_32,
+#else
+	        0,
+#endif
+	        format->params.min_keys_per_crypt,
+	        format->params.max_keys_per_crypt);
+	for (i = 0; i < bench_costs; i++) {
+		fprintf(file, "%s{\"name\": ", i ? ", " : "");
+		bench_put_string(file, format->params.tunable_cost_name[i]);
+		fprintf(file, ", \"value\": %u}", bench_cost[i]);
+	}
+	fprintf(file, "], \"real_cps_median\": %.2f, \"real_cps_stddev\": %.2f, "
+	        "\"real_cps_min\": %.2f, \"real_cps_max\": %.2f, "
+	        "\"virtual_cps_median\": %.2f, \"virtual_cps_stddev\": %.2f}\n",
+	        real->median, real->stddev, real->min, real->max,
+	        virtual->median, virtual->stddev);
+	fflush(file);
+}
+
+/*
+ * Writes and/or compares the results of one benchmark, as requested.
+ */
+static void bench_report(struct fmt_main *format, char *test, int salts,
+	int threads, struct bench_stats *real, struct bench_stats *virtual)
+{
+	struct bench_record *old;
+
+	if (!john_main_process || !benchmark_time)
+		return;
+
+	if (benchmark_repeat > 1)
+		printf("%s:\tmedian of %d runs, stddev %.1f%%\n", test,
+		       benchmark_repeat, real->median ?
+		       100 * real->stddev / real->median : 0);
+
+	if (bench_output_file)
+		bench_write(format, test, salts, threads, real, virtual);
+
+	if (bench_baseline && real->median > 0 &&
+	    (old = bench_find(bench_baseline, format->params.label, test)) &&
+	    old->median > 0)
+		bench_check("Baseline:\t", old, real->median);
+}
+
+int benchmark_compare_files(char *old_name, char *new_name)
+{
+	struct bench_record *old_list, *new_list, *old, *new;
+	double log_sum = 0;
+	int count = 0;
+
+	old_list = bench_load(old_name);
+	new_list = bench_load(new_name);
+	bench_init_compare();
+
+	for (new = new_list; new; new = new->next) {
+		char prefix[LINE_BUFFER_SIZE];
+
+		if (!(old = bench_find(old_list, new->format, new->test)) ||
+		    old->median <= 0 || new->median <= 0)
+			continue;
+
+		count++;
+		log_sum += log(new->median / old->median);
+
+		snprintf(prefix, sizeof(prefix), "%s, %s: ",
+		         new->format, new->test);
+		if (fabs(100 * (new->median - old->median) / old->median) >
+		    bench_threshold)
+			bench_check(prefix, old, new->median);
+	}
+
+	printf("Compared %d benchmarks: %d regressions and %d improvements "
+	       "beyond %.0f%%", count, bench_regressions, bench_improvements,
+	       bench_threshold);
+	if (count)
+		printf(", geometric mean ratio %.3f", exp(log_sum / count));
+	putchar('\n');
+
+	return bench_regressions != 0;
+}
+#endif
+
+/*
+ * Parses a comma separated list of positive counts, with optional K or M
+ * suffixes, into values.  Returns the number of counts or 0 if invalid.
+ */
+static int bench_parse_counts(char *list, int *values)
+{
+	char *p = list, *end;
+	int n = 0;
+
+	do {
+		long value = strtol(p, &end, 10);
+
+		if (*end == 'k' || *end == 'K') {
+			value *= 1000;
+			end++;
+		} else if (*end == 'm' || *end == 'M') {
+			value *= 1000000;
+			end++;
+		}
+
+		if (end == p || value < 1 || value > 100000000 ||
+		    (*end && *end != ',') || n >= BENCHMARK_SCALING_MAX)
+			return 0;
+
+		values[n++] = value;
+		p = end + 1;
+	} while (*end);
+
+	return n;
+}
+
+static void bench_init_scaling(void)
+{
+	if (!benchmark_hashes && !benchmark_threads)
+		return;
+
+	if (!(bench_hash_counts = bench_parse_counts(benchmark_hashes ?
+	    benchmark_hashes : BENCHMARK_HASHES, bench_hash_count))) {
+		if (john_main_process)
+			fprintf(stderr, "Invalid --bench-hashes list\n");
+		error();
+	}
+
+	bench_thread_count[0] = 1;
+	bench_thread_counts = 1;
+#ifdef _OPENMP
+	bench_thread_count[0] = omp_get_max_threads();
+	if (benchmark_threads &&
+	    !(bench_thread_counts = bench_parse_counts(benchmark_threads,
+	    bench_thread_count))) {
+		if (john_main_process)
+			fprintf(stderr, "Invalid --bench-threads list\n");
+		error();
+	}
+#else
+	if (benchmark_threads && john_main_process)
+		fprintf(stderr, "Warning: --bench-threads ignored, "
+		        "this build has no OpenMP support\n");
+#endif
+}
+
+static void bench_size(char *buffer, size_t size)
+{
+	if (size >= 1 << 20)
+		sprintf(buffer, "%u MiB", (unsigned int)(size >> 20));
+	else if (size >= 1 << 10)
+		sprintf(buffer, "%u KiB", (unsigned int)(size >> 10));
+	else
+		sprintf(buffer, "%u B", (unsigned int)size);
+}
+
+/* One --bench-hashes/--bench-threads benchmark */
+struct bench_scaling {
+	int hashes, threads, hash_size;
+	struct bench_results results;
+	struct bench_stats real, virtual;
+};
+
+/*
+ * Benchmarks looking the computed hashes up in databases of each of the
+ * requested numbers of generated hashes, with each of the requested thread
+ * counts (for OpenMP formats), showing where bitmap and hash table lookups
+ * start to dominate.  Manages the test db on its own, as the format needs to
+ * be reinitialized for each thread count.
+ */
+static char *benchmark_scaling(struct fmt_main *format,
+	struct db_main **test_db)
+{
+	struct bench_scaling rows[BENCHMARK_SCALING_MAX * BENCHMARK_SCALING_MAX];
+	struct bench_scaling *row, *first;
+	int min_keys = format->params.min_keys_per_crypt;
+	int max_keys = format->params.max_keys_per_crypt;
+	int initialized = format->private.initialized;
+	int thread_counts = bench_thread_counts;
+	int i, j, n = 0;
+	char *result = NULL;
+
+	if (!(format->params.flags & FMT_OMP))
+		thread_counts = 1;
+
+	for (i = 0; i < thread_counts; i++) {
+		int threads = 1;
+
+#ifdef _OPENMP
+		if (format->params.flags & FMT_OMP) {
+			threads = bench_thread_count[i];
+			ldr_free_test_db(*test_db);
+			*test_db = NULL;
+			fmt_done(format);
+			if (!initialized) {
+				format->params.min_keys_per_crypt = min_keys;
+				format->params.max_keys_per_crypt = max_keys;
+			}
+			omp_set_num_threads(threads);
+		}
+#endif
+
+		/* (Ab)used to mute some messages from source() */
+		bench_running = 1;
+		*test_db = ldr_init_test_db(format, NULL);
+		bench_running = 0;
+
+		if (benchmark_time && *test_db)
+			omp_autotune_run(*test_db);
+
+		for (j = 0; j < bench_hash_counts; j++) {
+			row = &rows[n];
+			row->hashes = bench_hash_count[j];
+			row->threads = threads;
+
+			if (!*test_db || !(bench_scaling_db =
+			    ldr_init_scaling_db(*test_db, row->hashes)))
+				return "FAILED (no data)";
+			row->hash_size = bench_scaling_db->salts->hash_size;
+
+			result = benchmark_repeated(format, 1, &row->results,
+			    *test_db, &row->real, &row->virtual);
+
+			ldr_free_scaling_db(bench_scaling_db);
+			bench_scaling_db = NULL;
+
+			if (result)
+				return result;
+			n++;
+		}
+	}
+
+	if (!john_main_process)
+		return NULL;
+
+	printf(benchmark_time ? "DONE\n" : "PASS\n");
+	if (!benchmark_time)
+		return NULL;
+
+	for (i = 0; i < n; i++) {
+		char test[64], s_real[64], s_virtual[64];
+		char s_bitmap[32], s_hash[32];
+
+		row = &rows[i];
+		first = &rows[i - i % bench_hash_counts];
+
+		snprintf(test, sizeof(test), "%d hash%s, %d thread%s",
+		         row->hashes, row->hashes == 1 ? "" : "es",
+		         row->threads, row->threads == 1 ? "" : "s");
+		benchmark_cps(&row->results.crypts, row->results.real, s_real);
+		benchmark_cps(&row->results.crypts, row->results.virtual,
+		              s_virtual);
+		printf("%s:\t%s c/s real, %s c/s virtual (%.1f%%",
+		       test, s_real, s_virtual, first->real.median > 0 ?
+		       100 * row->real.median / first->real.median : 0);
+
+/* Speedup over the same number of hashes with the first thread count */
+		if (i >= bench_hash_counts && rows[i % bench_hash_counts].
+		    real.median > 0)
+			printf(", %.2fx", row->real.median /
+			       rows[i % bench_hash_counts].real.median);
+
+		if (row->hash_size >= 0) {
+			size_t bits = password_hash_sizes[row->hash_size];
+
+			bench_size(s_bitmap, bits / 8);
+			if ((bits >> PASSWORD_HASH_SHR) > 1) {
+				bench_size(s_hash, (bits >> PASSWORD_HASH_SHR) *
+				           sizeof(struct db_password *));
+				printf(", %s bitmap, %s hash table)\n",
+				       s_bitmap, s_hash);
+			} else
+				printf(", %s bitmap)\n", s_bitmap);
+		} else
+			puts(", no bitmap)");
+
+		bench_report(format, test, 1, row->threads,
+		             &row->real, &row->virtual);
+	}
+	putchar('\n');
+
+	return NULL;
+}
+
 void benchmark_cps(int64 *crypts, clock_t time, char *buffer)
 {
 	unsigned long long cps;
@@ -642,6 +1215,7 @@ int benchmark_all(void)
 	struct fmt_main *format;
 	char *result, *msg_1, *msg_m;
 	struct bench_results results_1, results_m;
+	struct bench_stats real_1, virtual_1, real_m, virtual_m;
 	char s_real[64], s_virtual[64];
 #if defined(HAVE_OPENCL)
 	char s_gpu[16 * MAX_GPU_DEVICES] = "";
@@ -656,6 +1230,7 @@ int benchmark_all(void)
 	int ompt;
 	int ompt_start = omp_get_max_threads();
 #endif
+	int threads;
 
 #if defined(HAVE_OPENCL)
 	if (!benchmark_time) {
@@ -670,6 +1245,14 @@ int benchmark_all(void)
 #endif
 
 #ifndef BENCH_BUILD
+	if (john_main_process && benchmark_output &&
+	    !(bench_output_file = fopen(path_expand(benchmark_output), "w")))
+		pexit("fopen: %s", path_expand(benchmark_output));
+	if (john_main_process && benchmark_compare)
+		bench_baseline = bench_load(benchmark_compare);
+	bench_init_compare();
+	bench_init_scaling();
+
 AGAIN:
 #endif
 	total = failed = 0;
@@ -728,6 +1311,11 @@ AGAIN:
 		// MPIOMPmutex may have capped the number of threads
 		ompt = omp_get_max_threads();
 #endif /* _OPENMP */
+		threads = 1;
+#ifdef _OPENMP
+		if (format->params.flags & FMT_OMP)
+			threads = ompt;
+#endif
 
 #ifdef HAVE_MPI
 		if (john_main_process)
@@ -801,22 +1389,41 @@ AGAIN:
 
 		total++;
 
+#ifndef BENCH_BUILD
+		if (bench_hash_counts) {
+			test_db = NULL;
+			if ((result = benchmark_scaling(format, &test_db))) {
+				puts(result);
+				failed++;
+			}
+#ifdef _OPENMP
+			omp_set_num_threads(ompt_start);
+#endif
+			goto next;
+		}
+#endif
+
 		/* (Ab)used to mute some messages from source() */
 		bench_running = 1;
 		test_db = ldr_init_test_db(format, NULL);
 		bench_running = 0;
 
-		if ((result = benchmark_format(format,
+#ifndef BENCH_BUILD
+		if (benchmark_time && test_db)
+			omp_autotune_run(test_db);
+#endif
+
+		if ((result = benchmark_repeated(format,
 		    format->params.salt_size ? BENCHMARK_MANY : 1,
-		    &results_m, test_db))) {
+		    &results_m, test_db, &real_m, &virtual_m))) {
 			puts(result);
 			failed++;
 			goto next;
 		}
 
 		if (msg_1)
-		if ((result = benchmark_format(format, 1, &results_1,
-		    test_db))) {
+		if ((result = benchmark_repeated(format, 1, &results_1,
+		    test_db, &real_1, &virtual_1))) {
 			puts(result);
 			failed++;
 			goto next;
@@ -894,6 +1501,11 @@ AGAIN:
 			msg_m, s_real);
 #endif
 
+#ifndef BENCH_BUILD
+		bench_report(format, msg_m, format->params.salt_size ?
+		             BENCHMARK_MANY : 1, threads, &real_m, &virtual_m);
+#endif
+
 		if (!msg_1) {
 #ifdef HAVE_MPI
 			if (john_main_process)
@@ -910,13 +1522,21 @@ AGAIN:
 #endif
 #if !defined(__DJGPP__) && !defined(__BEOS__) && !defined(__MINGW32__) && !defined (_MSC_VER)
 		if (benchmark_time)
-		printf("%s:\t%s c/s real, %s c/s virtual\n\n",
+		printf("%s:\t%s c/s real, %s c/s virtual\n",
 			msg_1, s_real, s_virtual);
 #else
 		if (benchmark_time)
-		printf("%s:\t%s c/s\n\n",
+		printf("%s:\t%s c/s\n",
 			msg_1, s_real);
 #endif
+#ifndef BENCH_BUILD
+		bench_report(format, msg_1, 1, threads, &real_1, &virtual_1);
+#endif
+#ifdef HAVE_MPI
+		if (john_main_process)
+#endif
+		if (benchmark_time)
+		putchar('\n');
 
 next:
 		fflush(stdout);
@@ -943,7 +1563,16 @@ next:
 #ifndef BENCH_BUILD
 	if (options.flags & FLG_LOOPTEST && !event_abort)
 		goto AGAIN;
-#endif
 
+	if (bench_output_file && fclose(bench_output_file))
+		pexit("fclose");
+	if (bench_baseline && !event_abort)
+		printf("%d regressions and %d improvements beyond %.0f%% "
+		       "compared to %s\n", bench_regressions,
+		       bench_improvements, bench_threshold, benchmark_compare);
+
+	return failed || bench_regressions || event_abort;
+#else
 	return failed || event_abort;
+#endif
 }
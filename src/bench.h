@@ -52,6 +52,24 @@ extern void clk_tck_init(void);
 extern int benchmark_time;
 extern int benchmark_level;  /* for full test */
 
+/*
+ * Number of timed runs per benchmark (--bench-repeat), the median of which
+ * is reported.
+ */
+extern int benchmark_repeat;
+
+/*
+ * File to write the results to as JSON lines (--bench-output), and a file of
+ * earlier results to compare them with (--bench-compare), if any.
+ */
+extern char *benchmark_output, *benchmark_compare;
+
+/*
+ * Comma separated loaded hash and thread counts to benchmark lookups with
+ * (--bench-hashes and --bench-threads), instead of the usual benchmarks.
+ */
+extern char *benchmark_hashes, *benchmark_threads;
+
 /*
  * Benchmarks the supplied cracking algorithm. Returns NULL on success,
  * an error message if the self-test fails or there are no test vectors
@@ -72,4 +90,11 @@ extern void benchmark_cps(int64 *crypts, clock_t time, char *buffer);
  */
 extern int benchmark_all(void);
 
+/*
+ * Compares two files written with --bench-output, printing the benchmarks
+ * that got slower or faster by more than BenchRegressionThreshold percent.
+ * Returns non-zero if any got slower.
+ */
+extern int benchmark_compare_files(char *old_name, char *new_name);
+
 #endif
@@ -160,4 +160,169 @@ inline static __m128i fBlaMka(__m128i x, __m128i y) {
         UNDIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1);                         \
     } while ((void)0, 0)
 
+#if defined(__AVX2__)
+/*
+ * The same rounds on 256-bit vectors, for a block held as 32 of them.  A row
+ * of the block is one whole BLAKE2 state (A, B, C, D each in one vector), so
+ * two rows are done at once.  Columns 2i and 2i+1 share their vectors, half
+ * each, and are likewise done together.
+ */
+#include <immintrin.h>
+
+#if defined(__AVX512VL__)
+#define _mm256_roti_epi64(x, c) _mm256_ror_epi64((x), -(c))
+#else
+#define r16_256                                                                \
+    (_mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,    \
+                      2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define r24_256                                                                \
+    (_mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,    \
+                      3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define _mm256_roti_epi64(x, c)                                                \
+    (-(c) == 32)                                                               \
+        ? _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))                   \
+        : (-(c) == 24)                                                         \
+              ? _mm256_shuffle_epi8((x), r24_256)                              \
+              : (-(c) == 16)                                                   \
+                    ? _mm256_shuffle_epi8((x), r16_256)                        \
+                    : _mm256_xor_si256(_mm256_srli_epi64((x), 63),             \
+                                       _mm256_add_epi64((x), (x)))
+#endif
+
+inline static __m256i fBlaMka256(__m256i x, __m256i y) {
+    const __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+#define G1_256(A0, B0, C0, D0, A1, B1, C1, D1)                                 \
+    do {                                                                       \
+        A0 = fBlaMka256(A0, B0);                                               \
+        A1 = fBlaMka256(A1, B1);                                               \
+                                                                               \
+        D0 = _mm256_xor_si256(D0, A0);                                         \
+        D1 = _mm256_xor_si256(D1, A1);                                         \
+                                                                               \
+        D0 = _mm256_roti_epi64(D0, -32);                                       \
+        D1 = _mm256_roti_epi64(D1, -32);                                       \
+                                                                               \
+        C0 = fBlaMka256(C0, D0);                                               \
+        C1 = fBlaMka256(C1, D1);                                               \
+                                                                               \
+        B0 = _mm256_xor_si256(B0, C0);                                         \
+        B1 = _mm256_xor_si256(B1, C1);                                         \
+                                                                               \
+        B0 = _mm256_roti_epi64(B0, -24);                                       \
+        B1 = _mm256_roti_epi64(B1, -24);                                       \
+    } while ((void)0, 0)
+
+#define G2_256(A0, B0, C0, D0, A1, B1, C1, D1)                                 \
+    do {                                                                       \
+        A0 = fBlaMka256(A0, B0);                                               \
+        A1 = fBlaMka256(A1, B1);                                               \
+                                                                               \
+        D0 = _mm256_xor_si256(D0, A0);                                         \
+        D1 = _mm256_xor_si256(D1, A1);                                         \
+                                                                               \
+        D0 = _mm256_roti_epi64(D0, -16);                                       \
+        D1 = _mm256_roti_epi64(D1, -16);                                       \
+                                                                               \
+        C0 = fBlaMka256(C0, D0);                                               \
+        C1 = fBlaMka256(C1, D1);                                               \
+                                                                               \
+        B0 = _mm256_xor_si256(B0, C0);                                         \
+        B1 = _mm256_xor_si256(B1, C1);                                         \
+                                                                               \
+        B0 = _mm256_roti_epi64(B0, -63);                                       \
+        B1 = _mm256_roti_epi64(B1, -63);                                       \
+    } while ((void)0, 0)
+
+/* Rows: each vector is a whole row of the 4x4 state */
+#define DIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1));            \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3));            \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1)                 \
+    do {                                                                       \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3));            \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3));            \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2));            \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2));            \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1));            \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1));            \
+    } while ((void)0, 0)
+
+/*
+ * Columns: a row of the state is split over the X0 and X1 vectors, with the
+ * first column's words in the low 128 bits and the second column's in the
+ * high ones, so everything stays within 128-bit lanes.
+ */
+#define SWAP64_256(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(1, 0, 3, 2))
+
+#define DIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1)                   \
+    do {                                                                       \
+        __m256i t0 = SWAP64_256(_mm256_blend_epi32(B1, B0, 0xCC));             \
+        __m256i t1 = SWAP64_256(_mm256_blend_epi32(B0, B1, 0xCC));             \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+                                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+                                                                               \
+        t0 = SWAP64_256(_mm256_blend_epi32(D0, D1, 0xCC));                     \
+        t1 = SWAP64_256(_mm256_blend_epi32(D1, D0, 0xCC));                     \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1)                 \
+    do {                                                                       \
+        __m256i t0 = SWAP64_256(_mm256_blend_epi32(B0, B1, 0xCC));             \
+        __m256i t1 = SWAP64_256(_mm256_blend_epi32(B1, B0, 0xCC));             \
+        B0 = t0;                                                               \
+        B1 = t1;                                                               \
+                                                                               \
+        t0 = C0;                                                               \
+        C0 = C1;                                                               \
+        C1 = t0;                                                               \
+                                                                               \
+        t0 = SWAP64_256(_mm256_blend_epi32(D1, D0, 0xCC));                     \
+        t1 = SWAP64_256(_mm256_blend_epi32(D0, D1, 0xCC));                     \
+        D0 = t0;                                                               \
+        D1 = t1;                                                               \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1)                  \
+    do {                                                                       \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+                                                                               \
+        DIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1);                  \
+                                                                               \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+                                                                               \
+        UNDIAGONALIZE_ROWS_256(A0, B0, C0, D0, A1, B1, C1, D1);                \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_COLS_256(A0, A1, B0, B1, C0, C1, D0, D1)                  \
+    do {                                                                       \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+                                                                               \
+        DIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1);                  \
+                                                                               \
+        G1_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+        G2_256(A0, B0, C0, D0, A1, B1, C1, D1);                                \
+                                                                               \
+        UNDIAGONALIZE_COLS_256(A0, B0, C0, D0, A1, B1, C1, D1);                \
+    } while ((void)0, 0)
+#endif /* __AVX2__ */
+
 #endif
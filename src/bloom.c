@@ -0,0 +1,104 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+#include <string.h>
+
+#include "arch.h"
+#include "common.h"
+#include "memory.h"
+#include "bloom.h"
+#include "memdbg.h"
+
+/* 64 bytes, the size of a block */
+#define BLOOM_BLOCK_SIZE		(BLOOM_BLOCK_WORDS * sizeof(uint64_t))
+
+/* Bits of hash needed to pick a bit within a block */
+#define BLOOM_BLOCK_SHIFT		9
+
+int bloom_init(struct bloom_filter *filter, size_t size)
+{
+	uint64_t blocks = 1;
+
+	memset(filter, 0, sizeof(*filter));
+
+	if (size < BLOOM_BLOCK_SIZE)
+		return 1;
+
+	while ((blocks << 1) <= size / BLOOM_BLOCK_SIZE)
+		blocks <<= 1;
+
+	filter->bits = mem_calloc_align(blocks, BLOOM_BLOCK_SIZE,
+	                                MEM_ALIGN_CACHE);
+	filter->mask = blocks - 1;
+	filter->max_items = blocks * BLOOM_BLOCK_SIZE * 8 / BLOOM_BITS_PER_ITEM;
+
+	return 0;
+}
+
+void bloom_done(struct bloom_filter *filter)
+{
+	MEM_FREE(filter->bits);
+	filter->mask = filter->items = filter->max_items = 0;
+}
+
+static MAYBE_INLINE uint64_t bloom_mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+
+	return x;
+}
+
+uint64_t bloom_hash(const char *data, int length, uint64_t tag)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL ^ bloom_mix(tag);
+
+	while (length-- && *data) {
+		hash ^= (unsigned char)*data++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return bloom_mix(hash);
+}
+
+int bloom_check_add(struct bloom_filter *filter, uint64_t hash)
+{
+	uint64_t *block, bits[BLOOM_BLOCK_WORDS];
+	uint64_t select = bloom_mix(hash);
+	int i, present = 1;
+
+	if (bloom_full(filter))
+		return 0;
+
+	block = &filter->bits[(hash & filter->mask) * BLOOM_BLOCK_WORDS];
+
+	memset(bits, 0, sizeof(bits));
+	for (i = 0; i < BLOOM_HASHES; i++) {
+		unsigned int bit = select & ((1 << BLOOM_BLOCK_SHIFT) - 1);
+
+		bits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+		select >>= BLOOM_BLOCK_SHIFT;
+	}
+
+	for (i = 0; i < BLOOM_BLOCK_WORDS; i++)
+		if ((block[i] & bits[i]) != bits[i]) {
+			present = 0;
+			block[i] |= bits[i];
+		}
+
+	if (present)
+		filter->hits++;
+	else
+		filter->items++;
+
+	return present;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Bloom filter for "have we tried this candidate already" checks.
+ */
+
+#ifndef _JOHN_BLOOM_H
+#define _JOHN_BLOOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Number of bits set (and checked) per item.  All of an item's bits are in
+ * the same 64-byte block, so a lookup costs at most one cache miss.
+ */
+#define BLOOM_HASHES			4
+#define BLOOM_BLOCK_WORDS		8
+
+/*
+ * We stop adding items (and treat every item as new) once there are fewer
+ * than this many bits per item, keeping false positives (candidates skipped
+ * that were never tried) below roughly 1 in 3000.
+ */
+#define BLOOM_BITS_PER_ITEM		32
+
+struct bloom_filter {
+/* The bit array, and its size in blocks minus 1 (a power of 2 minus 1) */
+	uint64_t *bits;
+	uint64_t mask;
+
+/* Number of items added so far, and how many we can add */
+	uint64_t items, max_items;
+
+/* Number of items found to be (probably) present */
+	uint64_t hits;
+};
+
+/*
+ * Allocates a filter of up to size bytes, rounded down to a power of 2.
+ * Returns zero on success, or non-zero if size is too small to bother.
+ */
+extern int bloom_init(struct bloom_filter *filter, size_t size);
+
+/*
+ * Frees the bit array.
+ */
+extern void bloom_done(struct bloom_filter *filter);
+
+/*
+ * Hashes a string (up to length chars or a NUL, whichever comes first)
+ * together with a 64-bit tag, such as a salt's sequential id.
+ */
+extern uint64_t bloom_hash(const char *data, int length, uint64_t tag);
+
+/*
+ * Returns 1 if the item was probably added before, otherwise adds it and
+ * returns 0.  Once the filter is full, always returns 0 without adding.
+ */
+extern int bloom_check_add(struct bloom_filter *filter, uint64_t hash);
+
+/*
+ * Returns non-zero once the filter has stopped accepting new items.
+ */
+#define bloom_full(filter) \
+	((filter)->items >= (filter)->max_items)
+
+#endif
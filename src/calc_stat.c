@@ -13,14 +13,35 @@
 #endif
 #include <math.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "arch.h"
+#include "params.h"
 #include "memory.h"
+#include "mkvlib.h"
 #include "memdbg.h"
 
 #define C2I(c) ((unsigned int)(unsigned char)(c))
 
-unsigned int *proba1;
-unsigned int *proba2;
-unsigned int *first;
+/*
+ * Lines are processed the way fgets() into a buffer of this size would
+ * return them, so longer lines count as several.
+ */
+#define LINE_SIZE 4096
+
+struct counts {
+	unsigned int proba1[256];
+	unsigned int proba2[256 * 256];
+	unsigned int nb_lignes;
+};
+
+static int npflag;
 
 #ifdef HAVE_LIBFUZZER
 int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
@@ -29,6 +50,201 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 }
 #endif
 
+static void usage(char *name)
+{
+	fprintf(stderr,
+	        "Usage: %s [-p] [-n LEVEL:MAXLEN] dictionary_file statfile\n"
+	        "\t-p: include non printable and 8-bit characters\n"
+	        "\t-n: also precompute the Markov mode tables for this level and\n"
+	        "\t    length, so that --markov=LEVEL with max length MAXLEN starts\n"
+	        "\t    instantly\n",
+	        name);
+}
+
+/* Counts one line, as returned by fgets() */
+static void count_line(struct counts *cnt, char *ligne, unsigned int nb_lignes)
+{
+	int i, np;
+
+	i = strlen(ligne) - 1;
+	while ((i > 0) && ((ligne[i] == '\n') || (ligne[i] == '\r'))) {
+		ligne[i] = 0;
+		i--;
+	}
+	for (i = 0; ligne[i]; i++) {
+		np = 0;
+		if (!npflag) {
+			if (C2I(ligne[i]) < 32) {
+				fprintf(stderr,
+				        "Warning, skipping non printable character 0x%02x line %d offset %d: %s\n",
+				        (unsigned char)ligne[i], nb_lignes, i, ligne);
+				np += 1;
+			}
+			if (C2I(ligne[i]) > 127) {
+				fprintf(stderr,
+				        "Warning, skipping non-ASCII character 0x%02x line %d offset %d: %s\n",
+				        (unsigned char)ligne[i], nb_lignes, i, ligne);
+				np += 1;
+			}
+			if ((i > 0) && (C2I(ligne[i - 1]) < 32)) {
+				np += 2;
+			}
+			if ((i > 0) && (C2I(ligne[i - 1]) > 127)) {
+				np += 2;
+			}
+		}
+		if ((i == 0) && ((np == 0) || (npflag == 1)))
+			cnt->proba1[C2I(ligne[0])]++;
+		if ((i > 0) && ((np == 0) || (npflag == 1)))
+			cnt->proba2[C2I(ligne[i - 1]) * 256 + C2I(ligne[i])]++;
+	}
+}
+
+#if defined(HAVE_MMAP)
+/*
+ * Length of the next piece fgets() would return, starting at ptr.
+ */
+static size_t next_piece(const char *ptr, const char *end)
+{
+	size_t max = end - ptr;
+	const char *nl;
+
+	if (max > LINE_SIZE - 1)
+		max = LINE_SIZE - 1;
+	if ((nl = memchr(ptr, '\n', max)))
+		return nl - ptr + 1;
+
+	return max;
+}
+
+/*
+ * Processes, or with cnt NULL only counts, the lines starting within
+ * [start, stop) of the mapping, first_line being the number of the first.
+ * Returns the number of lines.
+ */
+static unsigned int process_range(struct counts *cnt, const char *start,
+                                  const char *stop, const char *end,
+                                  unsigned int first_line)
+{
+	char ligne[LINE_SIZE];
+	const char *ptr = start;
+	unsigned int nb_lignes = 0;
+
+	while (ptr < stop) {
+		size_t len;
+
+/* A line longer than fgets() takes is several pieces, all of them ours */
+		do {
+			len = next_piece(ptr, end);
+			if (*ptr) {
+				if (cnt) {
+					memcpy(ligne, ptr, len);
+					ligne[len] = 0;
+					count_line(cnt, ligne,
+					           first_line + nb_lignes);
+				}
+				nb_lignes++;
+			}
+			ptr += len;
+		} while (ptr[-1] != '\n' && ptr < end);
+	}
+
+	return nb_lignes;
+}
+
+/*
+ * Splits the mapping in one piece per thread, starting at line boundaries.
+ * Warnings need the right line numbers, so unless -p was given we count the
+ * lines of each piece first.
+ */
+static void process_map(struct counts *cnt, int threads,
+                        const char *map, size_t size)
+{
+	const char **starts;
+	unsigned int *first_lines;
+	int t;
+
+	starts = mem_alloc((threads + 1) * sizeof(*starts));
+	first_lines = mem_calloc(threads + 1, sizeof(*first_lines));
+
+	for (t = 0; t < threads; t++) {
+		const char *ptr = map + size / threads * t;
+
+		if (t && ptr[-1] != '\n') {
+			ptr = memchr(ptr, '\n', map + size - ptr);
+			ptr = ptr ? ptr + 1 : map + size;
+		}
+		if (t && ptr < starts[t - 1])
+			ptr = starts[t - 1];
+		starts[t] = ptr;
+	}
+	starts[threads] = map + size;
+
+	if (!npflag) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+		for (t = 0; t < threads; t++)
+			first_lines[t + 1] = process_range(NULL, starts[t],
+			    starts[t + 1], map + size, 0);
+		for (t = 0; t < threads; t++)
+			first_lines[t + 1] += first_lines[t];
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+	for (t = 0; t < threads; t++)
+		cnt[t].nb_lignes = process_range(&cnt[t], starts[t],
+		    starts[t + 1], map + size, first_lines[t]);
+
+	MEM_FREE(first_lines);
+	MEM_FREE(starts);
+}
+#endif
+
+static void process_file(struct counts *cnt, FILE *fichier)
+{
+	char ligne[LINE_SIZE];
+
+	while (fgets(ligne, sizeof(ligne), fichier)) {
+		if (ligne[0] == 0)
+			continue;
+		count_line(cnt, ligne, cnt->nb_lignes);
+		cnt->nb_lignes++;
+	}
+}
+
+/*
+ * Loads the stats file we've just written the same way Markov mode will,
+ * and saves the nbparts table computed from it.
+ */
+static int write_nbparts(char *statfile, unsigned int max_lvl,
+                         unsigned int max_len)
+{
+	size_t size = 256 * (max_lvl + 1) * (max_len + 1) * sizeof(long long);
+	char *name;
+	int ret;
+
+	init_probatables(statfile);
+
+	nbparts = mem_calloc(1, size);
+	nb_parts(0, 0, 0, max_lvl, max_len);
+
+	name = nbparts_filename(statfile, max_lvl, max_len);
+	if ((ret = save_nbparts(name, max_lvl, max_len)))
+		fprintf(stderr, "could not write %s\n", name);
+	else
+		printf("Wrote %s (" LLu " candidates)\n", name, nbparts[0]);
+
+	MEM_FREE(nbparts);
+	MEM_FREE(proba1);
+	MEM_FREE(proba2);
+	MEM_FREE(first);
+
+	return ret;
+}
+
 #ifdef HAVE_LIBFUZZER
 int main_dummy(int argc, char **argv)
 #else
@@ -36,39 +252,40 @@ int main(int argc, char **argv)
 #endif
 {
 	FILE *fichier;
-	char *ligne;
 	int i;
 	int j;
-	int np;
-	int npflag;
+	int t;
+	int threads = 1;
+	int mapped = 0;
 	int args;
 	unsigned int nb_lignes;
 	unsigned int nb_lettres;
+	unsigned int nbp_lvl = 0, nbp_len = 0;
+	unsigned int *proba1, *proba2, *first;
+	struct counts *cnt;
 
 	FILE *statfile;
 
-	if ((argc != 3) && (argc != 4)) {
-		fprintf(stderr,
-		        "Usage: %s [-p] dictionary_file statfile\n\t-p: include non printable and 8-bit characters\n",
-		        argv[0]);
-		return -1;
+	npflag = 0;
+	for (args = 1; args < argc - 2; args++) {
+		if (!strcmp(argv[args], "-p"))
+			npflag = 1;
+		else if (!strcmp(argv[args], "-n") && args + 1 < argc - 2 &&
+		         sscanf(argv[args + 1], "%u:%u", &nbp_lvl, &nbp_len) == 2 &&
+		         nbp_len > 0 && nbp_len <= MAX_MKV_LEN &&
+		         nbp_lvl <= MAX_MKV_LVL)
+			args++;
+		else
+			break;
 	}
 
-	if (argc == 4) {
-		if (strcmp(argv[1], "-p")) {
-			fprintf(stderr,
-			        "Usage: %s [-p] dictionary_file statfile\n\t-p: include non printable and 8-bit characters\n",
-			        argv[0]);
-			return -1;
-		}
-		args = 1;
-		npflag = 1;
-	} else {
-		args = 0;
-		npflag = 0;
+	if (argc < 3 || args != argc - 2) {
+		usage(argv[0]);
+		return -1;
 	}
+	args--;
 
-	fichier = fopen(argv[1 + args], "r");
+	fichier = fopen(argv[1 + args], "rb");
 	if (!fichier) {
 		fprintf(stderr, "could not open %s\n", argv[1 + args]);
 		return -1;
@@ -80,63 +297,51 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
-	ligne = malloc(4096);
-	if (ligne == NULL) {
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	cnt = calloc(threads, sizeof(*cnt));
+	if (cnt == NULL) {
 		fprintf(stderr, "%s:%d: malloc failed\n", __FUNCTION__, __LINE__);
 		exit(EXIT_FAILURE);
 	}
 
-	proba2 = calloc(256 * 256, sizeof(unsigned int));
-	if (proba2 == NULL) {
-		fprintf(stderr, "%s:%d: malloc failed\n", __FUNCTION__, __LINE__);
-		exit(EXIT_FAILURE);
-	}
-	proba1 = calloc(256, sizeof(unsigned int));
-	if (proba1 == NULL) {
-		fprintf(stderr, "%s:%d: malloc failed\n", __FUNCTION__, __LINE__);
-		exit(EXIT_FAILURE);
+	statfile = fopen(argv[2 + args], "w");
+	if (!statfile) {
+		fprintf(stderr, "could not open %s\n", argv[2 + args]);
+		return -1;
 	}
 
-	statfile = fopen(argv[2 + args], "w");
+#if defined(HAVE_MMAP)
+	{
+		struct stat st;
+		char *map;
 
-	nb_lignes = 0;
-	while (fgets(ligne, 4096, fichier)) {
-		if (ligne[0] == 0)
-			continue;
-		i = strlen(ligne) - 1;
-		while ((i > 0) && ((ligne[i] == '\n') || (ligne[i] == '\r'))) {
-			ligne[i] = 0;
-			i--;
+		if (!fstat(fileno(fichier), &st) && S_ISREG(st.st_mode) &&
+		    st.st_size > 0 &&
+		    (unsigned long long)st.st_size <= (size_t)~0 &&
+		    (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+		                fileno(fichier), 0)) != MAP_FAILED) {
+			process_map(cnt, threads, map, st.st_size);
+			munmap(map, st.st_size);
+			mapped = 1;
 		}
-		for (i = 0; ligne[i]; i++) {
-			np = 0;
-			if (!npflag) {
-				if (C2I(ligne[i]) < 32) {
-					fprintf(stderr,
-					        "Warning, skipping non printable character 0x%02x line %d offset %d: %s\n",
-					        (unsigned char)ligne[i], nb_lignes, i, ligne);
-					np += 1;
-				}
-				if (C2I(ligne[i]) > 127) {
-					fprintf(stderr,
-					        "Warning, skipping non-ASCII character 0x%02x line %d offset %d: %s\n",
-					        (unsigned char)ligne[i], nb_lignes, i, ligne);
-					np += 1;
-				}
-				if ((i > 0) && (C2I(ligne[i - 1]) < 32)) {
-					np += 2;
-				}
-				if ((i > 0) && (C2I(ligne[i - 1]) > 127)) {
-					np += 2;
-				}
-			}
-			if ((i == 0) && ((np == 0) || (npflag == 1)))
-				proba1[C2I(ligne[0])]++;
-			if ((i > 0) && ((np == 0) || (npflag == 1)))
-				proba2[C2I(ligne[i - 1]) * 256 + C2I(ligne[i])]++;
-		}
-		nb_lignes++;
 	}
+#endif
+	if (!mapped)
+		process_file(&cnt[0], fichier);
+
+/* Add up the per-thread counters in the first one */
+	for (t = 1; t < threads; t++) {
+		for (i = 0; i < 256; i++)
+			cnt[0].proba1[i] += cnt[t].proba1[i];
+		for (i = 0; i < 256 * 256; i++)
+			cnt[0].proba2[i] += cnt[t].proba2[i];
+		cnt[0].nb_lignes += cnt[t].nb_lignes;
+	}
+	proba1 = cnt[0].proba1;
+	proba2 = cnt[0].proba2;
+	nb_lignes = cnt[0].nb_lignes;
 
 	for (i = 0; i < 256; i++) {
 		if ((proba1[i] == 0) || (i == 0)) {
@@ -189,14 +394,14 @@ int main(int argc, char **argv)
 
 	fclose(statfile);
 
-	MEM_FREE(proba1);
-	MEM_FREE(proba2);
-
+	MEM_FREE(cnt);
 	MEM_FREE(first);
 
-	MEM_FREE(ligne);
 	fclose(fichier);
 
+	if (nbp_len && write_nbparts(argv[2 + args], nbp_lvl, nbp_len))
+		return -1;
+
 	MEMDBG_PROGRAM_EXIT_CHECKS(stderr);
 
 	return 0;
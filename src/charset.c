@@ -11,6 +11,22 @@
 #endif
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !AC_BUILT || HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef _MSC_VER
+#include <io.h>
+#define fdopen _fdopen
+#endif
 
 #include "arch.h"
 #include "misc.h"
@@ -22,6 +38,10 @@
 #include "signals.h"
 #include "loader.h"
 #include "external.h"
+#include "options.h"
+#include "unicode.h"
+#include "john.h"
+#include "jumbo.h"
 #include "charset.h"
 #include "memdbg.h"
 
@@ -31,94 +51,446 @@ typedef unsigned int (*char_counters)
 typedef unsigned int (*crack_counters)
 	[CHARSET_LENGTH][CHARSET_LENGTH][CHARSET_SIZE];
 
+/*
+ * Plaintexts we build the per-position statistics from are spilled to one
+ * temporary file per length, as fixed-size records with no separators, so
+ * that we don't need to keep them in memory.  Each thread buffers this many
+ * bytes per length before appending them to the file.
+ */
+#define CHARSET_SPILL_SIZE		0x10000
+
+/* Number of spilled plaintexts we read back and count at a time */
+#define CHARSET_CHUNK_KEYS		0x100000
+
+/* Per-thread state while reading plaintexts */
+struct charset_reader {
+	unsigned long total, remaining;
+	unsigned int chars[CHARSET_SIZE];
+	char *spill[CHARSET_LENGTH];
+	int spill_length[CHARSET_LENGTH];
+};
+
 static CRC32_t checksum;
 
-static unsigned long charset_filter_plaintexts(struct db_main *db,
-    struct list_main **lists)
+static FILE *spill_files[CHARSET_LENGTH];
+static char spill_names[CHARSET_LENGTH][PATH_BUFFER_SIZE];
+static unsigned long spill_counts[CHARSET_LENGTH];
+
+static int charset_threads(void)
 {
-	int length, old_length;
-	unsigned long count;
-	struct list_entry *current, *next;
-	char *ptr, key[PLAINTEXT_BUFFER_SIZE];
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
 
-	for (length = 0; length <= CHARSET_LENGTH; length++)
-		list_init(&lists[length]);
+static void charset_spill_done(void)
+{
+	int length;
 
-	count = 0;
+	for (length = 0; length < CHARSET_LENGTH; length++)
+	if (spill_files[length]) {
+		fclose(spill_files[length]);
+		spill_files[length] = NULL;
+		unlink(spill_names[length]);
+	}
+}
 
-	if ((current = db->plaintexts->head))
-	do {
-		next = current->next;
+static void charset_spill_init(char *charset)
+{
+	int length;
 
-		if (!current->data[0])
-			continue;
+	for (length = 0; length < CHARSET_LENGTH; length++) {
+		int fd;
 
-		old_length = 0;
-		ptr = current->data;
-		if (f_filter) {
-			old_length = strlen(current->data);
-/*
- * The current->data string might happen to end near page boundary and the next
- * page might not be mapped, whereas ext_filter_body() may pre-read a few chars
- * beyond NUL for greater speed in uses during cracking.  Also, the external
- * filter() may make the string longer.  Finally, ext_filter_body() assumes
- * that the string passed to it fits in PLAINTEXT_BUFFER_SIZE.  Hence, we copy
- * the string here.
- */
-			if (old_length < sizeof(key)) {
-				memcpy(key, current->data, old_length + 1);
-			} else {
-				memcpy(key, current->data, sizeof(key) - 1);
-				key[sizeof(key) - 1] = 0;
+		snprintf(spill_names[length], sizeof(spill_names[length]),
+		    "%s.%02d", path_expand(charset), length + 1);
+/* Never overwrite a file of the user's that happens to have this name */
+#if defined (_MSC_VER) || defined(__MINGW32__)
+		fd = open(spill_names[length],
+		    O_RDWR | O_CREAT | O_EXCL | O_BINARY, 0600);
+#else
+		fd = open(spill_names[length], O_RDWR | O_CREAT | O_EXCL, 0600);
+#endif
+		if (fd < 0) {
+			int err = errno;
+
+			charset_spill_done();
+			if (err == EEXIST) {
+				fprintf(stderr, "Temporary file %s exists, "
+				    "please remove it\n", spill_names[length]);
+				error();
 			}
-			if (!ext_filter_body(key, key))
-				continue;
-			ptr = key;
+			errno = err;
+			pexit("open: %s", spill_names[length]);
 		}
+		if (!(spill_files[length] = fdopen(fd, "wb+")))
+			pexit("fdopen");
+		spill_counts[length] = 0;
+	}
+}
 
-		length = 0;
-		while (*ptr) {
-			int c = *(unsigned char *)ptr;
-			if (c < CHARSET_MIN || c > CHARSET_MAX)
-				break;
-			length++;
-			ptr++;
-		}
+static void charset_flush(struct charset_reader *reader, int length)
+{
+	if (!reader->spill_length[length])
+		return;
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+	{
+		if (fwrite(reader->spill[length], reader->spill_length[length],
+		    1, spill_files[length]) != 1)
+			pexit("fwrite");
+		spill_counts[length] +=
+		    reader->spill_length[length] / (length + 1);
+	}
+
+	reader->spill_length[length] = 0;
+}
+
+static void charset_reader_init(struct charset_reader *reader)
+{
+	int length;
+
+	memset(reader, 0, sizeof(*reader));
+	for (length = 0; length < CHARSET_LENGTH; length++)
+		reader->spill[length] = mem_alloc(CHARSET_SPILL_SIZE);
+}
+
+static void charset_reader_done(struct charset_reader *reader)
+{
+	int length;
+
+	for (length = 0; length < CHARSET_LENGTH; length++) {
+		charset_flush(reader, length);
+		MEM_FREE(reader->spill[length]);
+	}
+}
 
-		if (!*ptr) {
-			struct list_main *list;
 /*
- * lists[CHARSET_LENGTH] is a catch-all for excessive length strings that
- * nevertheless consist exclusively of characters in the CHARSET_MIN to
- * CHARSET_MAX range (including in their portion beyond CHARSET_LENGTH).
+ * Takes one plaintext (not necessarily NUL terminated) through the external
+ * filter, if any, and the CHARSET_MIN to CHARSET_MAX check.  If it passes,
+ * its characters are counted, and unless longer than CHARSET_LENGTH it is
+ * spilled for the per-position statistics.
  */
-			if (length > CHARSET_LENGTH)
-				list = lists[CHARSET_LENGTH];
-			else
-				list = lists[length - 1];
-			if (old_length) {
-				if (length > old_length) {
-					list_add(list, key);
-				} else {
-					memcpy(current->data, key, length + 1);
-					list_add_link(list, current);
-				}
-			} else {
+static void charset_add_plaintext(struct charset_reader *reader,
+    const char *data, size_t size)
+{
+	char key[PLAINTEXT_BUFFER_SIZE];
+	const unsigned char *ptr;
+	size_t length, i;
+
+	if (!size)
+		return;
+
+	if (f_filter) {
+/*
+ * The data might happen to end near page boundary and the next page might not
+ * be mapped, whereas ext_filter_body() may pre-read a few chars beyond NUL for
+ * greater speed in uses during cracking.  Also, the external filter() may make
+ * the string longer.  Finally, ext_filter_body() assumes that the string
+ * passed to it fits in PLAINTEXT_BUFFER_SIZE.  Hence, we copy the string here.
+ */
+		if (size > sizeof(key) - 1)
+			size = sizeof(key) - 1;
+		memcpy(key, data, size);
+		key[size] = 0;
+		if (!ext_filter_body(key, key))
+			return;
+		data = key;
+		size = strlen(key);
+	}
+
+	ptr = (const unsigned char *)data;
+	for (length = 0; length < size; length++)
+		if (!ptr[length] ||
+		    ptr[length] < CHARSET_MIN || ptr[length] > CHARSET_MAX)
+			break;
+	if (length < size && ptr[length])
+		return;
+	if (!length)
+		return;
+
+	reader->remaining++;
+
 /*
  * Truncate very long strings at PLAINTEXT_BUFFER_SIZE for consistency with
  * what would happen if we applied a dummy filter(), as well as for easy
  * testing against older revisions of this code.
  */
-				if (length >= PLAINTEXT_BUFFER_SIZE)
-					current->data
-					    [PLAINTEXT_BUFFER_SIZE - 1] = 0;
-				list_add_link(list, current);
+	for (i = 0; i < length && i < PLAINTEXT_BUFFER_SIZE - 1; i++)
+		reader->chars[ARCH_INDEX(ptr[i] - CHARSET_MIN)]++;
+
+/*
+ * Excessive length strings that nevertheless consist exclusively of
+ * characters in the CHARSET_MIN to CHARSET_MAX range only contribute to the
+ * overall character counts.
+ */
+	if (length > CHARSET_LENGTH)
+		return;
+
+	length--;
+	if (reader->spill_length[length] + length + 1 > CHARSET_SPILL_SIZE)
+		charset_flush(reader, length);
+	memcpy(reader->spill[length] + reader->spill_length[length],
+	    data, length + 1);
+	reader->spill_length[length] += length + 1;
+}
+
+/*
+ * Processes a pot file line from start up to (not including) end, the same
+ * way ldr_show_pot_line() would with DB_PLAINTEXTS.
+ */
+static void charset_add_pot_line(struct charset_reader *reader,
+    const char *start, const char *end)
+{
+	const char *plain, *ptr;
+
+	if (!(plain = memchr(start, options.loader.field_sep_char,
+	    end - start)))
+		return;
+
+	reader->total++;
+
+	for (ptr = ++plain; ptr < end; ptr++)
+		if (*ptr == '\r' || *ptr == '\n' || !*ptr)
+			break;
+
+	charset_add_plaintext(reader, plain, ptr - plain);
+}
+
+/*
+ * Returns the size of a UTF-8 BOM at the start of the pot file, to be
+ * skipped, warning or failing about BOMs the way the loader does.
+ */
+static size_t charset_check_bom(const char *data, size_t size)
+{
+	if (size >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3)) {
+		if (options.input_enc == UTF_8)
+			return 3;
+		if (john_main_process)
+			fprintf(stderr, "Warning: UTF-8 BOM seen in input file"
+			    " - You probably want --input-encoding=UTF8\n");
+	}
+	if (options.input_enc == UTF_8 && size >= 2 &&
+	    (!memcmp(data, "\xFE\xFF", 2) || !memcmp(data, "\xFF\xFE", 2))) {
+		if (john_main_process)
+			fprintf(stderr,
+			    "Error: UTF-16 BOM seen in input file.\n");
+		error();
+	}
+	return 0;
+}
+
+#if defined(HAVE_MMAP)
+/*
+ * Splits the memory mapped pot file into one piece per thread, at line
+ * boundaries.  A line belongs to the piece it starts in.
+ */
+static void charset_read_map(struct charset_reader *readers, int threads,
+    const char *map, size_t size)
+{
+	int t;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+#endif
+	for (t = 0; t < threads; t++) {
+		const char *ptr = map + size / threads * t;
+		const char *end = t == threads - 1 ?
+		    map + size : map + size / threads * (t + 1);
+
+		if (t && ptr[-1] != '\n') {
+			ptr = memchr(ptr, '\n', map + size - ptr);
+			ptr = ptr ? ptr + 1 : map + size;
+		}
+
+		while (ptr < end && !event_abort) {
+			const char *eol = memchr(ptr, '\n', map + size - ptr);
+
+			if (!eol)
+				eol = map + size;
+			charset_add_pot_line(&readers[t], ptr, eol);
+			ptr = eol + 1;
+		}
+	}
+}
+#endif
+
+/*
+ * Reads all plaintexts from the pot file, or from the database when limited
+ * to specific password files, merging the per-thread counters into reader.
+ */
+static void charset_read_plaintexts(struct db_main *db,
+    struct charset_reader *reader)
+{
+	struct charset_reader *readers;
+	int threads = f_filter ? 1 : charset_threads();
+	int t, i;
+
+	readers = mem_alloc(threads * sizeof(*readers));
+	for (t = 0; t < threads; t++)
+		charset_reader_init(&readers[t]);
+
+	if (options.flags & FLG_PASSWD) {
+		struct list_entry *current;
+
+		if ((current = db->plaintexts->head))
+		do {
+			readers[0].total++;
+			charset_add_plaintext(&readers[0],
+			    current->data, strlen(current->data));
+		} while ((current = current->next));
+	} else {
+		char *name = path_expand(options.activepot);
+		char line[LINE_BUFFER_SIZE], *ex_size_line;
+		FILE *file;
+		int mapped = 0;
+
+		if (!(file = fopen(name, "rb"))) {
+			if (errno != ENOENT)
+				pexit("fopen: %s", name);
+		} else {
+#if defined(HAVE_MMAP)
+			struct stat st;
+			char *map;
+
+			if (!fstat(fileno(file), &st) && st.st_size > 0 &&
+			    (unsigned long long)st.st_size <= (size_t)~0 &&
+			    (map = mmap(NULL, st.st_size, PROT_READ,
+			    MAP_SHARED, fileno(file), 0)) != MAP_FAILED) {
+				size_t bom = charset_check_bom(map, st.st_size);
+
+				charset_read_map(readers, threads,
+				    map + bom, st.st_size - bom);
+				munmap(map, st.st_size);
+				mapped = 1;
+			}
+#endif
+			if (!mapped)
+			while (!event_abort && (ex_size_line =
+			    fgetll(line, sizeof(line), file))) {
+				size_t bom = 0, len = strlen(ex_size_line);
+
+				if (!readers[0].total)
+					bom = charset_check_bom(ex_size_line,
+					    len);
+				charset_add_pot_line(&readers[0],
+				    ex_size_line + bom, ex_size_line + len);
+				if (ex_size_line != line)
+					MEM_FREE(ex_size_line);
+			}
+			if (ferror(file)) pexit("fgets");
+			fclose(file);
+		}
+	}
+
+	memset(reader, 0, sizeof(*reader));
+	for (t = 0; t < threads; t++) {
+		reader->total += readers[t].total;
+		reader->remaining += readers[t].remaining;
+		for (i = 0; i < CHARSET_SIZE; i++)
+			reader->chars[i] += readers[t].chars[i];
+		charset_reader_done(&readers[t]);
+	}
+	MEM_FREE(readers);
+
+	for (i = 0; i < CHARSET_LENGTH; i++)
+	if (fflush(spill_files[i]) || ferror(spill_files[i]))
+		pexit("fwrite: %s", spill_names[i]);
+}
+
+/*
+ * Counts the characters at pos, with the two preceding ones as context as
+ * available, of all spilled plaintexts of length.  Each thread counts its
+ * share of every chunk into its own counters, the first thread's being chars
+ * itself, then the rest are added to chars.
+ */
+static void charset_count_position(int length, int pos,
+    char_counters *counters, int threads)
+{
+	FILE *file = spill_files[length];
+	char_counters chars = counters[0];
+	size_t record = length + 1, count;
+	unsigned char *buffer;
+	int t;
+
+	buffer = mem_alloc(CHARSET_CHUNK_KEYS * record);
+
+/* Zeroize the same portion of the counters as is used below */
+	for (t = 0; t < threads; t++)
+	switch (pos) {
+	case 0:
+		memset((*counters[t])[CHARSET_SIZE][CHARSET_SIZE], 0,
+		    sizeof((*counters[t])[CHARSET_SIZE][CHARSET_SIZE]));
+		break;
+	case 1:
+		memset((*counters[t])[CHARSET_SIZE], 0,
+		    sizeof((*counters[t])[CHARSET_SIZE]));
+		break;
+	default:
+		memset(counters[t], 0, sizeof(*counters[t]));
+	}
+
+	if (fseek(file, 0, SEEK_SET)) pexit("fseek");
+	while ((count = fread(buffer, record, CHARSET_CHUNK_KEYS, file))) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+#endif
+		for (t = 0; t < threads; t++) {
+			char_counters counter = counters[t];
+			unsigned char *ptr = buffer + count / threads * t * record;
+			unsigned char *end = t == threads - 1 ?
+			    buffer + count * record :
+			    buffer + count / threads * (t + 1) * record;
+
+			switch (pos) {
+			case 0:
+				for (; ptr < end; ptr += record) {
+					int c = ARCH_INDEX(ptr[0] - CHARSET_MIN);
+					(*counter)[CHARSET_SIZE][CHARSET_SIZE][c]++;
+				}
+				break;
+			case 1:
+				for (; ptr < end; ptr += record) {
+					int b = ARCH_INDEX(ptr[0] - CHARSET_MIN);
+					int c = ARCH_INDEX(ptr[1] - CHARSET_MIN);
+					(*counter)[CHARSET_SIZE][b][c]++;
+					(*counter)[CHARSET_SIZE][CHARSET_SIZE][c]++;
+				}
+				break;
+			default:
+				for (ptr += pos - 2; ptr < end; ptr += record) {
+					int a = ARCH_INDEX(ptr[0] - CHARSET_MIN);
+					int b = ARCH_INDEX(ptr[1] - CHARSET_MIN);
+					int c = ARCH_INDEX(ptr[2] - CHARSET_MIN);
+					(*counter)[a][b][c]++;
+					(*counter)[CHARSET_SIZE][b][c]++;
+					(*counter)[CHARSET_SIZE][CHARSET_SIZE][c]++;
+				}
 			}
-			count++;
 		}
-	} while ((current = next));
+	}
+	if (ferror(file)) pexit("fread: %s", spill_names[length]);
 
-	return count;
+	MEM_FREE(buffer);
+
+	if (threads > 1) {
+		int a, first = pos > 1 ? 0 : CHARSET_SIZE;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+		for (a = first; a <= CHARSET_SIZE; a++) {
+			int b, c, i;
+			for (b = pos ? 0 : CHARSET_SIZE; b <= CHARSET_SIZE; b++)
+			for (c = 0; c < CHARSET_SIZE; c++)
+			for (i = 1; i < threads; i++)
+				(*chars)[a][b][c] += (*counters[i])[a][b][c];
+		}
+	}
 }
 
 static int cfputc(int c, FILE *stream)
@@ -209,35 +581,27 @@ static int cmp_count(const void *p1, const void *p2)
 	return c1->index - c2->index;
 }
 
-static void charset_generate_chars(struct list_main **lists,
+static void charset_generate_chars(struct charset_reader *reader,
 	FILE *file, struct charset_header *header,
 	char_counters chars, crack_counters cracks)
 {
-	struct list_entry *current;
 	unsigned char buffer[CHARSET_SIZE];
 	count_sort_t iv[CHARSET_SIZE];
-	int length, pos, count;
+	char_counters *counters;
+	int length, pos, count, threads;
 	int i, j, k;
 
 	memset(cracks, 0, sizeof(*cracks));
 
-/* Zeroize the same portion of "chars" as is used by the loop below */
-	memset((*chars)[0][0], 0, sizeof((*chars)[0][0]));
-
-	for (length = 0; length <= CHARSET_LENGTH; length++) {
-		if ((current = lists[length]->head))
-		do {
-			char *ptr;
-			for (ptr = current->data; *ptr; ptr++) {
-				int c = *(unsigned char *)ptr;
-				(*chars)[0][0][ARCH_INDEX(c - CHARSET_MIN)]++;
-			}
-		} while ((current = current->next));
-	}
+	threads = charset_threads();
+	counters = mem_alloc(threads * sizeof(*counters));
+	counters[0] = chars;
+	for (i = 1; i < threads; i++)
+		counters[i] = mem_alloc(sizeof(*counters[i]));
 
 	count = 0;
 	for (k = 0; k < CHARSET_SIZE; k++) {
-		unsigned int value = (*chars)[0][0][k];
+		unsigned int value = reader->chars[k];
 		if (value) {
 			iv[count].index = k;
 			iv[count++].value = value;
@@ -257,47 +621,12 @@ static void charset_generate_chars(struct list_main **lists,
 	for (length = 0; charset_new_length(length, header, file); length++)
 	for (pos = 0; pos <= length; pos++) {
 		if (event_abort)
-			return;
+			goto out;
 
-		if (!(current = lists[length]->head))
+		if (!spill_counts[length])
 			continue;
 
-		switch (pos) {
-		case 0:
-			memset((*chars)[CHARSET_SIZE][CHARSET_SIZE], 0,
-			    sizeof((*chars)[CHARSET_SIZE][CHARSET_SIZE]));
-			do {
-				unsigned char *ptr =
-				    (unsigned char *)current->data;
-				int c = ARCH_INDEX(ptr[0] - CHARSET_MIN);
-				(*chars)[CHARSET_SIZE][CHARSET_SIZE][c]++;
-			} while ((current = current->next));
-			break;
-		case 1:
-			memset((*chars)[CHARSET_SIZE], 0,
-			    sizeof((*chars)[CHARSET_SIZE]));
-			do {
-				unsigned char *ptr =
-				    (unsigned char *)current->data;
-				int b = ARCH_INDEX(ptr[0] - CHARSET_MIN);
-				int c = ARCH_INDEX(ptr[1] - CHARSET_MIN);
-				(*chars)[CHARSET_SIZE][b][c]++;
-				(*chars)[CHARSET_SIZE][CHARSET_SIZE][c]++;
-			} while ((current = current->next));
-			break;
-		default:
-			memset(chars, 0, sizeof(*chars));
-			do {
-				unsigned char *ptr =
-				    (unsigned char *)current->data;
-				int a = ARCH_INDEX(ptr[pos - 2] - CHARSET_MIN);
-				int b = ARCH_INDEX(ptr[pos - 1] - CHARSET_MIN);
-				int c = ARCH_INDEX(ptr[pos] - CHARSET_MIN);
-				(*chars)[a][b][c]++;
-				(*chars)[CHARSET_SIZE][b][c]++;
-				(*chars)[CHARSET_SIZE][CHARSET_SIZE][c]++;
-			} while ((current = current->next));
-		}
+		charset_count_position(length, pos, counters, threads);
 
 		cfputc(CHARSET_ESC, file); cfputc(CHARSET_NEW, file);
 		cfputc(length, file); cfputc(pos, file);
@@ -335,6 +664,11 @@ static void charset_generate_chars(struct list_main **lists,
 
 	cfputc(CHARSET_ESC, file); cfputc(CHARSET_NEW, file);
 	cfputc(CHARSET_LENGTH, file);
+
+out:
+	for (i = 1; i < threads; i++)
+		MEM_FREE(counters[i]);
+	MEM_FREE(counters);
 }
 
 static double powi(int x, unsigned int y)
@@ -626,7 +960,7 @@ out:
 	MEM_FREE(ratios);
 }
 
-static void charset_generate_all(struct list_main **lists, char *charset)
+static void charset_generate_all(struct charset_reader *reader, char *charset)
 {
 	FILE *file;
 	int was_error;
@@ -648,7 +982,7 @@ static void charset_generate_all(struct list_main **lists, char *charset)
 	printf("Generating charsets");
 	fflush(stdout);
 
-	charset_generate_chars(lists, file, header, chars, cracks);
+	charset_generate_chars(reader, file, header, chars, cracks);
 	if (!event_abort) {
 		printf(" DONE\nGenerating cracking order");
 		fflush(stdout);
@@ -659,6 +993,7 @@ static void charset_generate_all(struct list_main **lists, char *charset)
 	if (event_abort) {
 		fclose(file);
 		unlink(charset);
+		charset_spill_done();
 		putchar('\n');
 		check_abort(0); /* doesn't return because event_abort is set */
 		return; /* not reached */
@@ -693,17 +1028,25 @@ static void charset_generate_all(struct list_main **lists, char *charset)
 
 void do_makechars(struct db_main *db, char *charset)
 {
-	struct list_main *lists[CHARSET_LENGTH + 1];
+	struct charset_reader reader;
 	unsigned long total, remaining;
 
-	total = db->plaintexts->count;
+	charset_spill_init(charset);
+	charset_read_plaintexts(db, &reader);
+
+	if (event_abort) {
+		charset_spill_done();
+		check_abort(0); /* doesn't return because event_abort is set */
+	}
+
+	total = reader.total;
 
 	printf("Loaded %lu plaintext%s%s\n",
 		total,
 		total != 1 ? "s" : "",
 		total ? "" : ", exiting...");
 
-	remaining = charset_filter_plaintexts(db, lists);
+	remaining = reader.remaining;
 
 	if (remaining < total)
 		printf("Remaining %lu plaintext%s%s\n",
@@ -711,10 +1054,11 @@ void do_makechars(struct db_main *db, char *charset)
 			remaining != 1 ? "s" : "",
 			remaining ? "" : ", exiting...");
 
-	if (!remaining)
-		return;
+	if (remaining) {
+		CRC32_Init(&checksum);
 
-	CRC32_Init(&checksum);
+		charset_generate_all(&reader, charset);
+	}
 
-	charset_generate_all(lists, charset);
+	charset_spill_done();
 }
@@ -38,6 +38,7 @@
 
 #include "misc.h"
 #include "math.h"
+#include "timer.h"
 #include "memory.h"
 #include "signals.h"
 #include "idle.h"
@@ -90,12 +91,26 @@ static unsigned int crk_prefetch;
 #endif
 #endif
 static int crk_key_index, crk_last_key;
+static int crk_benchmarking;
 static void *crk_last_salt;
 void (*crk_fix_state)(void);
 static struct db_keys *crk_guesses;
 static int64 *crk_timestamps;
 static char crk_stdout_key[PLAINTEXT_BUFFER_SIZE];
 int64_t crk_pot_pos;
+int crk_timing, crk_salt_pos;
+void (*crk_guess_hook)(char *key, char *ciphertext, int from_pot);
+const char *crk_phase_names[CRK_PHASES] = {
+	"generate", "set_key", "crypt", "compare", "other"
+};
+static double crk_tick_secs, crk_phase_time[CRK_PHASES];
+static hr_timer crk_timing_start, crk_fill_start;
+static double crk_set_key_time, crk_timer_overhead;
+static unsigned long long crk_set_key_calls, crk_set_key_samples;
+static double *crk_salt_time;
+static int crk_salt_time_count;
+/* Password count when the salts were last ordered, for DB_COST_ORDER */
+static int crk_cost_order_count;
 
 /* expose max_keys_per_crypt to the world (needed in recovery.c) */
 int cracker_max_keys_per_crypt() {
@@ -146,6 +161,29 @@ static void crk_help(void)
 	printed = 1;
 }
 
+static void crk_init_format(struct db_main *db)
+{
+	crk_db = db;
+	memcpy(&crk_params, &db->format->params, sizeof(struct fmt_params));
+	memcpy(&crk_methods, &db->format->methods, sizeof(struct fmt_methods));
+
+#if CRK_PREFETCH && !defined(crk_prefetch)
+	{
+		unsigned int m = crk_params.max_keys_per_crypt;
+		if (m > CRK_PREFETCH) {
+			unsigned int n = (m + CRK_PREFETCH - 1) / CRK_PREFETCH;
+			crk_prefetch = (m + n - 1) / n;
+			/* CRK_PREFETCH / 2 < crk_prefetch <= CRK_PREFETCH */
+		} else {
+/* Actual prefetch will be capped to crypt_all() return value anyway, so let's
+ * not cap it to max_keys_per_crypt here in case crypt_all() generates more
+ * candidates on its own. */
+			crk_prefetch = CRK_PREFETCH;
+		}
+	}
+#endif
+}
+
 void crk_init(struct db_main *db, void (*fix_state)(void),
 	struct db_keys *guesses)
 {
@@ -173,25 +211,38 @@ void crk_init(struct db_main *db, void (*fix_state)(void),
 		fprintf(stderr, " \b");
 #endif
 
-	crk_db = db;
-	memcpy(&crk_params, &db->format->params, sizeof(struct fmt_params));
-	memcpy(&crk_methods, &db->format->methods, sizeof(struct fmt_methods));
+	crk_init_format(db);
+	crk_cost_order_count = db->password_count;
 
-#if CRK_PREFETCH && !defined(crk_prefetch)
-	{
-		unsigned int m = crk_params.max_keys_per_crypt;
-		if (m > CRK_PREFETCH) {
-			unsigned int n = (m + CRK_PREFETCH - 1) / CRK_PREFETCH;
-			crk_prefetch = (m + n - 1) / n;
-			/* CRK_PREFETCH / 2 < crk_prefetch <= CRK_PREFETCH */
-		} else {
-/* Actual prefetch will be capped to crypt_all() return value anyway, so let's
- * not cap it to max_keys_per_crypt here in case crypt_all() generates more
- * candidates on its own. */
-			crk_prefetch = CRK_PREFETCH;
+	if (!crk_timing &&
+	    (options.metrics_interval || (options.flags & FLG_PROFILE))) {
+		double ticks;
+
+		HRGETTICKS_PER_SEC(ticks);
+		if (ticks > 0) {
+			hr_timer start, end;
+			int i;
+
+			crk_tick_secs = 1.0 / ticks;
+			crk_timing = 1;
+
+/* What a timed set_key() call costs extra, to not count it as set_key() */
+			HRSETCURRENT(start);
+			for (i = 0; i < 1000; i++)
+				HRSETCURRENT(end);
+			crk_timer_overhead = (HRGETTICKS(end) - HRGETTICKS(start)) *
+				crk_tick_secs / 1000;
+
+			HRSETCURRENT(crk_timing_start);
 		}
 	}
-#endif
+
+	if (crk_timing && db->loaded && db->salt_count > crk_salt_time_count) {
+		MEM_FREE(crk_salt_time);
+		crk_salt_time_count = db->salt_count;
+		crk_salt_time = mem_calloc(crk_salt_time_count,
+		                           sizeof(*crk_salt_time));
+	}
 
 	if (db->loaded) crk_init_salt();
 	crk_last_key = crk_key_index = 0;
@@ -219,6 +270,9 @@ void crk_init(struct db_main *db, void (*fix_state)(void),
 	crk_help();
 
 	idle_init(db->format);
+
+	if (crk_timing)
+		HRSETCURRENT(crk_fill_start);
 }
 
 /*
@@ -339,6 +393,10 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 	int dupe;
 	char *key, *utf8key, *repkey, *replogin, *repuid;
 
+/* A false match against a generated hash, nothing was cracked */
+	if (crk_benchmarking)
+		return 0;
+
 	if (index >= 0 && index < crk_params.max_keys_per_crypt) {
 		dupe = !memcmp(&crk_timestamps[index],
 		               &status.crypts, sizeof(int64));
@@ -434,6 +492,10 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 			crk_guesses->ptr += crk_params.plaintext_length;
 			crk_guesses->count++;
 		}
+
+		if (crk_guess_hook && !dupe)
+			crk_guess_hook(crk_methods.get_key(index),
+			               (char*)ct, 0);
 	}
 
 	if (!(crk_params.flags & FMT_NOT_EXACT))
@@ -650,10 +712,23 @@ int crk_reload_pot(void)
 		fields[1] = ciphertext;
 		ciphertext = crk_methods.prepare(fields, crk_db->format);
 		if (ldr_trunc_valid(ciphertext, crk_db->format)) {
+			int count = crk_db->password_count;
+
 			ciphertext = crk_methods.split(ciphertext, 0,
 			                               crk_db->format);
 			if (crk_remove_pot_entry(ciphertext))
 				break;
+
+			if (crk_guess_hook && crk_db->password_count < count) {
+				char *key = p + 1;
+				char buf[PLAINTEXT_BUFFER_SIZE + 1];
+
+				if (options.store_utf8 &&
+				    options.target_enc != UTF_8)
+					key = utf8_to_cp_r(key, buf,
+					                   PLAINTEXT_BUFFER_SIZE);
+				crk_guess_hook(key, ciphertext, 1);
+			}
 		}
 	}
 
@@ -781,6 +856,11 @@ static int crk_process_event(void)
 		status_print();
 	}
 
+	if (event_metrics) {
+		event_metrics = 0;
+		status_write_metrics(crk_db, 0);
+	}
+
 	if (event_ticksafety) {
 		event_ticksafety = 0;
 		status_ticks_overflow_safety();
@@ -802,39 +882,17 @@ void crk_set_hybrid_fix_state_func_ptr(fix_state_fp fp)
 	fp_fix_state = fp;
 }
 
-static int crk_password_loop(struct db_salt *salt)
+/*
+ * Checks the first match computed hashes against the salt's loaded hashes.
+ * Returns non-zero when we're done with this salt (or everything).
+ */
+static int crk_compare(struct db_salt *salt, unsigned int match)
 {
-	int count;
-	unsigned int match, index;
+	unsigned int index;
 #if CRK_PREFETCH
 	unsigned int target;
 #endif
 
-#if !OS_TIMER
-	sig_timer_emu_tick();
-#endif
-
-	idle_yield();
-
-	if (event_pending && crk_process_event())
-		return -1;
-
-	if (fp_fix_state)
-		fp_fix_state();
-
-	count = crk_key_index;
-	match = crk_methods.crypt_all(&count, salt);
-	crk_last_key = count;
-
-	{
-		int64 effective_count;
-		mul32by32(&effective_count, salt->count, count);
-		status_update_crypts(&effective_count, count);
-	}
-
-	if (!match)
-		return 0;
-
 	if (!salt->bitmap) {
 		struct db_password *pw = salt->list;
 		do {
@@ -959,21 +1017,117 @@ static int crk_password_loop(struct db_salt *salt)
 	return 0;
 }
 
-static int crk_salt_loop(void)
+static int crk_password_loop(struct db_salt *salt)
+{
+	int count, done;
+	unsigned int match;
+	hr_timer start, end;
+	double crypt_time, cmp_time;
+
+#if !OS_TIMER
+	sig_timer_emu_tick();
+#endif
+
+	idle_yield();
+
+	if (event_pending && crk_process_event())
+		return -1;
+
+	if (fp_fix_state)
+		fp_fix_state();
+
+	if (crk_timing)
+		HRSETCURRENT(start);
+
+	count = crk_key_index;
+	match = crk_methods.crypt_all(&count, salt);
+	crk_last_key = count;
+
+	if (crk_timing) {
+		HRSETCURRENT(end);
+		crypt_time = (HRGETTICKS(end) - HRGETTICKS(start)) * crk_tick_secs;
+		crk_phase_time[CRK_PHASE_CRYPT] += crypt_time;
+		if (salt->sequential_id < crk_salt_time_count)
+			crk_salt_time[salt->sequential_id] += crypt_time;
+	}
+
+	{
+		int64 effective_count;
+		mul32by32(&effective_count, salt->count, count);
+		status_update_crypts(&effective_count, count);
+	}
+
+	if (!match)
+		return 0;
+
+	if (!crk_timing)
+		return crk_compare(salt, match);
+
+	done = crk_compare(salt, match);
+
+	HRSETCURRENT(start);
+	cmp_time = (HRGETTICKS(start) - HRGETTICKS(end)) * crk_tick_secs;
+	crk_phase_time[CRK_PHASE_CMP] += cmp_time;
+	if (salt->sequential_id < crk_salt_time_count)
+		crk_salt_time[salt->sequential_id] += cmp_time;
+
+	return done;
+}
+
+int crk_bench_compare(struct db_main *db, struct db_salt *salt, int match)
 {
 	int done;
+
+	crk_init_format(db);
+
+	crk_benchmarking = 1;
+	done = crk_compare(salt, match);
+	crk_benchmarking = 0;
+
+	return done;
+}
+
+/*
+ * Accounts the time since the key buffer started filling up to generation.
+ */
+static void crk_account_gen(void)
+{
+	hr_timer now;
+
+	HRSETCURRENT(now);
+	crk_phase_time[CRK_PHASE_GEN] +=
+	    (HRGETTICKS(now) - HRGETTICKS(crk_fill_start)) * crk_tick_secs;
+}
+
+static int crk_salt_loop(void)
+{
+	int done = 0, cost_order, resume_skip = 0;
 	struct db_salt *salt;
 
+	if (crk_timing)
+		crk_account_gen();
+
 	if (event_reload && crk_reload_pot())
 		return 1;
 
-	salt = crk_db->salts;
+	cost_order = crk_db->options->flags & DB_COST_ORDER;
 
 	/* on first run, right after restore, this can be non-zero */
 	if (status.resume_salt) {
-		struct db_salt *s = salt;
+		struct db_salt *s = crk_db->salts;
 		/* clear resume so it only works the first time */
 		status.resume_salt = 0;
+/*
+ * Salts may have been re-ordered since the batch was started, but only those
+ * already done in it can have moved, and only further down the list.  So we
+ * skip the salts that sorted before the one we were at when the batch began,
+ * possibly redoing some.  If the session wasn't ordered the same way as now,
+ * we redo the whole batch.
+ */
+		if (cost_order || status.resume_salt_priority >= 0)
+			s = NULL;
+		resume_skip = cost_order && status.resume_salt_priority >= 0;
+		salt = crk_db->salts;
 		while (s)
 		{
 			if (s->salt_md5[0] == status.resume_salt_md5[0] &&
@@ -985,13 +1139,31 @@ static int crk_salt_loop(void)
 			}
 			s = s->next;
 		}
+	} else {
+/* Re-prioritize the salts if hashes got cracked since we last did */
+		if (cost_order && crk_cost_order_count != crk_db->password_count) {
+			ldr_sort_salts_by_cost(crk_db);
+			crk_cost_order_count = crk_db->password_count;
+		}
+		salt = crk_db->salts;
 	}
+	crk_salt_pos = 0;
 	do {
+		double priority = cost_order ? ldr_salt_priority(salt) : -1;
+
+		if (resume_skip && ldr_salt_priority_cmp(priority,
+		    salt->salt_md5, status.resume_salt_priority,
+		    status.resume_salt_md5) < 0) {
+			crk_salt_pos++;
+			continue;
+		}
+		status.resume_salt_priority = priority;
 		crk_methods.set_salt(salt->salt);
 		status.resume_salt_md5 = (crk_db->salt_count > 1) ?
 			salt->salt_md5 : NULL;
 		if ((done = crk_password_loop(salt)))
 			break;
+		crk_salt_pos++;
 	} while ((salt = salt->next));
 	if (!salt || crk_db->salt_count < 2)
 		status.resume_salt_md5 = NULL;
@@ -1036,9 +1208,33 @@ static int crk_salt_loop(void)
 		status_print();
 	}
 
+	if (crk_timing)
+		HRSETCURRENT(crk_fill_start);
+
 	return ext_abort;
 }
 
+/*
+ * set_key(), timing one call out of CRK_SET_KEY_SAMPLE.
+ */
+static void crk_timed_set_key(char *key, int index)
+{
+	hr_timer start, end;
+
+	if (crk_set_key_calls++ % CRK_SET_KEY_SAMPLE) {
+		crk_methods.set_key(key, index);
+		return;
+	}
+
+	HRSETCURRENT(start);
+	crk_methods.set_key(key, index);
+	HRSETCURRENT(end);
+
+	crk_set_key_time += (HRGETTICKS(end) - HRGETTICKS(start)) *
+		crk_tick_secs;
+	crk_set_key_samples++;
+}
+
 /* this variable is used in salt-resume logic  */
 /* if the KPC is now larger than it was when   */
 /* the .rec file was made, then the first loop */
@@ -1046,36 +1242,52 @@ static int crk_salt_loop(void)
 /* .rec file.                                  */
 static int cracker_max_keys_to_use = 0;
 
+static MAYBE_INLINE void crk_init_max_keys(void)
+{
+	if (!cracker_max_keys_to_use) {
+		cracker_max_keys_to_use = crk_params.max_keys_per_crypt;
+		if (status.resume_salt) {
+			if (status.resume_salt_crypts_per <= 0)
+				/* No longer resume v1 salt, we do not know the restore KPC */
+				status.resume_salt = 0;
+			else if (status.resume_salt_crypts_per < cracker_max_keys_to_use)
+				/* NOTE this reduction can only happen the FIRST time */
+				cracker_max_keys_to_use = status.resume_salt_crypts_per;
+		}
+	}
+}
+
+/*
+ * Runs crypt_all() and friends once the key buffer is full.
+ */
+static MAYBE_INLINE int crk_keys_added(void)
+{
+	if (crk_key_index >= cracker_max_keys_to_use ||
+	    (options.force_maxkeys &&
+	     crk_key_index >= options.force_maxkeys)) {
+		int ret = crk_salt_loop();
+		/* From here on cracker_max_keys_to_use is set to max KPC */
+		cracker_max_keys_to_use = crk_params.max_keys_per_crypt;
+		return ret;
+	}
+
+	return 0;
+}
+
 int crk_process_key(char *key)
 {
 	if (crk_db->loaded) {
-		if (!cracker_max_keys_to_use) {
-			cracker_max_keys_to_use = crk_params.max_keys_per_crypt;
-			if (status.resume_salt) {
-				if (status.resume_salt_crypts_per <= 0)
-					/* No longer resume v1 salt, we do not know the restore KPC */
-					status.resume_salt = 0;
-				else if (status.resume_salt_crypts_per < cracker_max_keys_to_use)
-					/* NOTE this reduction can only happen the FIRST time */
-					cracker_max_keys_to_use = status.resume_salt_crypts_per;
-			}
-		}
+		crk_init_max_keys();
 
 		if (crk_key_index == 0)
 			crk_methods.clear_keys();
 
-		crk_methods.set_key(key, crk_key_index++);
-
-		if (crk_key_index >= cracker_max_keys_to_use ||
-		    (options.force_maxkeys &&
-		     crk_key_index >= options.force_maxkeys)) {
-			int ret = crk_salt_loop();
-			/* From here on cracker_max_keys_to_use is set to max KPC */
-			cracker_max_keys_to_use = crk_params.max_keys_per_crypt;
-			return ret;
-		}
+		if (crk_timing)
+			crk_timed_set_key(key, crk_key_index++);
+		else
+			crk_methods.set_key(key, crk_key_index++);
 
-		return 0;
+		return crk_keys_added();
 	}
 
 #if !OS_TIMER
@@ -1116,6 +1328,33 @@ int crk_process_key(char *key)
 	return ext_abort;
 }
 
+int crk_key_block(int *room)
+{
+	int max_keys;
+
+	if (!crk_db->loaded)
+		return -1;
+
+	crk_init_max_keys();
+
+	if (crk_key_index == 0)
+		crk_methods.clear_keys();
+
+	max_keys = cracker_max_keys_to_use;
+	if (options.force_maxkeys && options.force_maxkeys < max_keys)
+		max_keys = options.force_maxkeys;
+	*room = max_keys - crk_key_index;
+
+	return crk_key_index;
+}
+
+int crk_process_keys(int count)
+{
+	crk_key_index += count;
+
+	return crk_keys_added();
+}
+
 /* This function is used by single.c only */
 int crk_process_salt(struct db_salt *salt)
 {
@@ -1142,12 +1381,20 @@ int crk_process_salt(struct db_salt *salt)
 		strnzcpy(key, ptr, crk_params.plaintext_length + 1);
 		ptr += crk_params.plaintext_length;
 
-		crk_methods.set_key(key, index++);
+		if (crk_timing)
+			crk_timed_set_key(key, index++);
+		else
+			crk_methods.set_key(key, index++);
 		if (index >= crk_params.max_keys_per_crypt || !count ||
 		    (options.force_maxkeys && index >= options.force_maxkeys)) {
 			int done;
 			crk_key_index = index;
-			if ((done = crk_password_loop(salt)) >= 0) {
+			if (crk_timing)
+				crk_account_gen();
+			done = crk_password_loop(salt);
+			if (crk_timing)
+				HRSETCURRENT(crk_fill_start);
+			if (done >= 0) {
 /*
  * The approach we use here results in status.cands growing slower than it
  * ideally should until this loop completes (at which point status.cands has
@@ -1177,6 +1424,114 @@ int crk_process_salt(struct db_salt *salt)
 	return 0;
 }
 
+double crk_get_phase_times(double *times)
+{
+	hr_timer now;
+	double total, other;
+	int i;
+
+	if (!crk_timing) {
+		memset(times, 0, CRK_PHASES * sizeof(*times));
+		return 0;
+	}
+
+	HRSETCURRENT(now);
+	total = (HRGETTICKS(now) - HRGETTICKS(crk_timing_start)) *
+		crk_tick_secs;
+
+	memcpy(times, crk_phase_time, CRK_PHASES * sizeof(*times));
+
+/* What we timed for generation includes the set_key() calls */
+	if (crk_set_key_samples) {
+		double per_call = crk_set_key_time / crk_set_key_samples -
+			crk_timer_overhead;
+
+		if (per_call > 0)
+			times[CRK_PHASE_SET_KEY] = per_call * crk_set_key_calls;
+	}
+	if (times[CRK_PHASE_SET_KEY] > times[CRK_PHASE_GEN])
+		times[CRK_PHASE_SET_KEY] = times[CRK_PHASE_GEN];
+	times[CRK_PHASE_GEN] -= times[CRK_PHASE_SET_KEY];
+
+	other = total;
+	for (i = 0; i < CRK_PHASE_OTHER; i++)
+		other -= times[i];
+	times[CRK_PHASE_OTHER] = other > 0 ? other : 0;
+
+	return total;
+}
+
+static void crk_print_salt_profile(char *prefix, double total)
+{
+	char line[LINE_BUFFER_SIZE];
+	struct db_salt *salt, *top[5];
+	int i, j, n, len;
+
+	n = 0;
+	for (salt = crk_db->salts; salt; salt = salt->next) {
+		double time;
+
+		if (salt->sequential_id >= crk_salt_time_count)
+			continue;
+		time = crk_salt_time[salt->sequential_id];
+		for (i = n; i > 0 &&
+		     crk_salt_time[top[i - 1]->sequential_id] < time; i--)
+			if (i < 5)
+				top[i] = top[i - 1];
+		if (i < 5) {
+			top[i] = salt;
+			if (n < 5)
+				n++;
+		}
+	}
+
+	len = snprintf(line, sizeof(line),
+	    "%sProfile: busiest salts (of crypt + compare):", prefix);
+	for (j = 0; j < n && len < sizeof(line); j++)
+		len += snprintf(line + len, sizeof(line) - len,
+		    " #%d %.1f%% (%d hash%s)", top[j]->sequential_id,
+		    100 * crk_salt_time[top[j]->sequential_id] / total,
+		    top[j]->count, top[j]->count == 1 ? "" : "es");
+
+	fprintf(stderr, "%s\n", line);
+	log_event("%s", line + strlen(prefix));
+}
+
+void crk_print_profile(int final)
+{
+	char prefix[16], line[LINE_BUFFER_SIZE];
+	double times[CRK_PHASES], total;
+	int i, len;
+
+	if (!crk_timing || !(total = crk_get_phase_times(times)))
+		return;
+
+	prefix[0] = 0;
+#ifndef HAVE_MPI
+	if (options.fork)
+#else
+	if (options.fork || mpi_p > 1)
+#endif
+		sprintf(prefix, "%u ", options.node_min);
+
+	len = snprintf(line, sizeof(line), "%sProfile:", prefix);
+	for (i = 0; i < CRK_PHASES; i++)
+		len += snprintf(line + len, sizeof(line) - len, "%s %.1f%% %s",
+		    i ? "," : "", 100 * times[i] / total, crk_phase_names[i]);
+
+	if (!final) {
+		fprintf(stderr, "%s\n", line);
+		return;
+	}
+
+	log_event("%s", line + strlen(prefix));
+
+	if (crk_db->loaded && crk_db->salt_count > 1 &&
+	    times[CRK_PHASE_CRYPT] + times[CRK_PHASE_CMP] > 0)
+		crk_print_salt_profile(prefix,
+		    times[CRK_PHASE_CRYPT] + times[CRK_PHASE_CMP]);
+}
+
 char *crk_get_key1(void)
 {
 	if (options.secure)
@@ -1202,11 +1557,25 @@ char *crk_get_key2(void)
 		return NULL;
 }
 
+int crk_flush(void)
+{
+	if (crk_key_index && crk_db->salts && !event_abort)
+		return crk_salt_loop();
+
+	return event_abort;
+}
+
 void crk_done(void)
 {
 	if (crk_db->loaded) {
 		if (crk_key_index && crk_db->salts && !event_abort)
 			crk_salt_loop();
 	}
+
+	if (options.metrics_interval)
+		status_write_metrics(crk_db, 1);
+
+	if (options.flags & FLG_PROFILE)
+		crk_print_profile(1);
 	c_cleanup();
 }
@@ -16,6 +16,42 @@
 /* Our last read position in pot file (during crack) */
 extern int64_t crk_pot_pos;
 
+/*
+ * Phases of cracking we account time to while crk_timing is set (with
+ * --profile or --metrics-every).  Other is everything else: event
+ * processing, pot file syncing, fix_state(), etc.
+ */
+#define CRK_PHASE_GEN			0	/* Candidate generation */
+#define CRK_PHASE_SET_KEY		1	/* set_key(), sampled */
+#define CRK_PHASE_CRYPT			2	/* crypt_all() */
+#define CRK_PHASE_CMP			3	/* Comparisons against hashes */
+#define CRK_PHASE_OTHER			4
+#define CRK_PHASES			5
+
+extern int crk_timing;
+
+/*
+ * Fills times[CRK_PHASES] with the seconds spent in each phase since cracking
+ * started in this process, and returns the total.
+ */
+extern double crk_get_phase_times(double *times);
+
+/*
+ * Names of the phases, for printing.
+ */
+extern const char *crk_phase_names[CRK_PHASES];
+
+/*
+ * Prints the share of time spent in each phase on a line, for the status.
+ * If final, logs it instead and prints the salts we spent most time on.
+ */
+extern void crk_print_profile(int final);
+
+/*
+ * Position of the salt being processed within the current batch of keys.
+ */
+extern int crk_salt_pos;
+
 /*
  * Initializes the cracker for a password database (should not be empty).
  * If fix_state() is not NULL, it will be called when key buffer becomes
@@ -33,6 +69,19 @@ extern void crk_init(struct db_main *db, void (*fix_state)(void),
  */
 extern int crk_process_key(char *key);
 
+/*
+ * For setting keys in blocks, possibly from several threads at once (only
+ * with formats that have FMT_SETKEY_MT).  Returns the index of the next key
+ * to set and, in room, how many keys may be set from there on; the caller
+ * then sets them with the format's set_key() and passes their count to
+ * crk_process_keys(), which returns like crk_process_key().  Returns -1 if
+ * keys aren't being tried against loaded hashes (--stdout), in which case
+ * crk_process_key() must be used.  set_key() calls made this way are not
+ * timed for --profile.
+ */
+extern int crk_key_block(int *room);
+extern int crk_process_keys(int count);
+
 /*
  * Resets the guessed keys buffer and processes all the buffered keys for
  * this salt. The return value is the same as for crk_process_key().
@@ -46,6 +95,20 @@ extern int crk_process_salt(struct db_salt *salt);
 extern char *crk_get_key1(void);
 extern char *crk_get_key2(void);
 
+/*
+ * Compares the hashes computed by the last crypt_all() call against those
+ * loaded for salt, the way cracking does, but without processing any guesses.
+ * For benchmarking lookups in a database that isn't otherwise being cracked.
+ */
+extern int crk_bench_compare(struct db_main *db, struct db_salt *salt,
+	int match);
+
+/*
+ * Tries the keys buffered so far, without waiting for the buffer to fill.
+ * Returns non-zero if we should stop, like crk_process_key().
+ */
+extern int crk_flush(void);
+
 /*
  * Processes all the buffered keys (unless aborted).
  */
@@ -56,6 +119,14 @@ extern void crk_done(void);
  */
 extern int crk_reload_pot(void);
 
+/*
+ * If set, called with the plaintext (in the target encoding) and the
+ * ciphertext (as in the pot file) of each hash newly cracked by this process,
+ * or by another one as seen on pot sync.  Whoever sets it should call what
+ * was there before.
+ */
+extern void (*crk_guess_hook)(char *key, char *ciphertext, int from_pot);
+
 /*
  * Exported for stacked modes
  */
@@ -35,6 +35,7 @@ john_register_one(&fmt_cryptsha1);
 #include "pbkdf2_hmac_sha1.h"
 #include "base64_convert.h"
 #include "sha1crypt_common.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define SHA1_SIZE 20
@@ -86,10 +87,7 @@ static struct saltstruct {
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_key = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*saved_key));
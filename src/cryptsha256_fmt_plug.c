@@ -155,11 +155,6 @@ john_register_one(&fmt_cryptsha256);
 #ifdef SIMD_COEF_32
 #define MIN_KEYS_PER_CRYPT		(SIMD_COEF_32*SIMD_PARA_SHA256)
 #define MAX_KEYS_PER_CRYPT		(SIMD_COEF_32*SIMD_PARA_SHA256)
-#if ARCH_LITTLE_ENDIAN==1
-#define GETPOS(i, index)		( (index&(SIMD_COEF_32-1))*4 + ((i)&(0xffffffff-3))*SIMD_COEF_32 + (3-((i)&3)) + (unsigned int)index/SIMD_COEF_32*SHA_BUF_SIZ*4*SIMD_COEF_32 ) //for endianity conversion
-#else
-#define GETPOS(i, index)		( (index&(SIMD_COEF_32-1))*4 + ((i)&(0xffffffff-3))*SIMD_COEF_32 + ((i)&3) + (unsigned int)index/SIMD_COEF_32*SHA_BUF_SIZ*4*SIMD_COEF_32 )
-#endif
 #else
 #define MIN_KEYS_PER_CRYPT		1
 #define MAX_KEYS_PER_CRYPT		1
@@ -210,6 +205,27 @@ typedef struct cryptloopstruct_t {
 								// things slow down. For now, we are limiting ourselves to 35 byte password, which fits into 2 SHA256 buffers
 } cryptloopstruct;
 
+#ifdef SIMD_COEF_32
+/* One block of all lanes, in the interleaved layout SSEi_MIXED_IN wants */
+#define MIX_BLK_WORDS		(16*MAX_KEYS_PER_CRYPT)
+
+/* Word W of the lanes of vector k, in a 2 block mixed buffer */
+#define MIX_WORD(blk, W, k)	(&(blk)[((W)>>4)*MIX_BLK_WORDS + (k)*16*SIMD_COEF_32 + ((W)&15)*SIMD_COEF_32])
+
+/* The 8 buffers of the cryptloopstruct, converted once per group of keys to */
+/* BE words in SSEi_MIXED_IN layout, so that SIMDSHA256body() need not gather */
+/* and swap them on every round.  type[] is which of the 8 each round uses,   */
+/* and offs[] is the byte offset the round's digest goes to in the next one.  */
+/* Keys are sorted by length, so the lanes of a vector mostly share offsets;  */
+/* then the digests are put in place a vector at a time.                      */
+typedef struct mixloopstruct_t {
+	uint32_t buf[8][2][MIX_BLK_WORDS];
+	unsigned char offs[MAX_KEYS_PER_CRYPT][42];
+	unsigned char type[42];
+	unsigned char uniform[SIMD_PARA_SHA256];	// all lanes of vector have same offs
+} mixloopstruct;
+#endif
+
 static int (*saved_len);
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static uint32_t (*crypt_out)[BINARY_SIZE / sizeof(uint32_t)];
@@ -585,6 +601,100 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 	if (!idx) pstr->datlen[41] = dlen_ppsc;
 }
 
+#ifdef SIMD_COEF_32
+static void LoadMixStruct(mixloopstruct *mix, cryptloopstruct *crypt_struct)
+{
+	unsigned int i, j, k;
+
+	for (i = 0; i < 42; ++i) {
+		mix->type[i] = (crypt_struct->bufs[0][i] - crypt_struct->buf) / (2*64*BLKS);
+		for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k)
+			mix->offs[k][i] = crypt_struct->cptr[k][i] - crypt_struct->bufs[k][(i + 1) % 42];
+	}
+	for (i = 0; i < 8; ++i)
+	for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k) {
+		unsigned char *cp = &crypt_struct->buf[i*2*64*BLKS + k*2*64];
+		for (j = 0; j < 32; ++j, cp += 4) {
+			uint32_t w;
+
+			memcpy(&w, cp, 4);
+#if ARCH_LITTLE_ENDIAN==1
+			w = JOHNSWAP(w);
+#endif
+			MIX_WORD(mix->buf[i][0], j, k/SIMD_COEF_32)[k&(SIMD_COEF_32-1)] = w;
+		}
+	}
+	for (k = 0; k < SIMD_PARA_SHA256; ++k) {
+		mix->uniform[k] = 1;
+		for (j = 1; j < SIMD_COEF_32; ++j)
+			if (memcmp(mix->offs[k*SIMD_COEF_32], mix->offs[k*SIMD_COEF_32+j], sizeof(mix->offs[0])))
+				mix->uniform[k] = 0;
+	}
+}
+
+/* Puts the digest of lane l of vector k at byte offset n of a 2 block buffer */
+static MAYBE_INLINE void PutDigestLane(uint32_t *blk, unsigned int n, unsigned int k, unsigned int l, uint32_t *sse_out)
+{
+	unsigned int i, w = n >> 2, r = (n & 3) << 3;
+	uint32_t *d = &sse_out[k*8*SIMD_COEF_32 + l];
+
+	if (!r) {
+		for (i = 0; i < 8; ++i)
+			MIX_WORD(blk, w + i, k)[l] = d[i*SIMD_COEF_32];
+		return;
+	}
+	MIX_WORD(blk, w, k)[l] = (MIX_WORD(blk, w, k)[l] & (~0U << (32 - r))) | (d[0] >> r);
+	for (i = 1; i < 8; ++i)
+		MIX_WORD(blk, w + i, k)[l] = (d[(i-1)*SIMD_COEF_32] << (32 - r)) | (d[i*SIMD_COEF_32] >> r);
+	MIX_WORD(blk, w + 8, k)[l] = (MIX_WORD(blk, w + 8, k)[l] & (~0U >> r)) | (d[7*SIMD_COEF_32] << (32 - r));
+}
+
+/* The same for all lanes of vector k.  Shift counts must be immediates for */
+/* some archs, hence the switch.                                            */
+#define PUT_DIGEST_SHIFT(r)	\
+	vstore(x, vor(vand(vload(x), vset1_epi32(~0U << (32 - (r)))), vsrli_epi32(vload(&d[0]), (r))));	\
+	for (i = 1; i < 8; ++i) {	\
+		x = (vtype*)MIX_WORD(blk, w + i, k);	\
+		vstore(x, vor(vslli_epi32(vload(&d[i-1]), 32 - (r)), vsrli_epi32(vload(&d[i]), (r))));	\
+	}	\
+	x = (vtype*)MIX_WORD(blk, w + 8, k);	\
+	vstore(x, vor(vand(vload(x), vset1_epi32(~0U >> (r))), vslli_epi32(vload(&d[7]), 32 - (r))))
+
+static MAYBE_INLINE void PutDigestVec(uint32_t *blk, unsigned int n, unsigned int k, uint32_t *sse_out)
+{
+	unsigned int i, w = n >> 2;
+	vtype *d = (vtype*)&sse_out[k*8*SIMD_COEF_32];
+	vtype *x = (vtype*)MIX_WORD(blk, w, k);
+
+	switch (n & 3) {
+	case 0:
+		for (i = 0; i < 8; ++i)
+			vstore((vtype*)MIX_WORD(blk, w + i, k), vload(&d[i]));
+		break;
+	case 1: PUT_DIGEST_SHIFT(8); break;
+	case 2: PUT_DIGEST_SHIFT(16); break;
+	case 3: PUT_DIGEST_SHIFT(24); break;
+	}
+}
+#undef PUT_DIGEST_SHIFT
+
+/* Puts each lane's digest where the next round wants it */
+static MAYBE_INLINE void PutDigest(mixloopstruct *mix, int idx, uint32_t *sse_out)
+{
+	uint32_t *blk = mix->buf[mix->type[(idx + 1) % 42]][0];
+	unsigned int k, l;
+
+	for (k = 0; k < SIMD_PARA_SHA256; ++k) {
+		if (mix->uniform[k]) {
+			PutDigestVec(blk, mix->offs[k*SIMD_COEF_32][idx], k, sse_out);
+			continue;
+		}
+		for (l = 0; l < SIMD_COEF_32; ++l)
+			PutDigestLane(blk, mix->offs[k*SIMD_COEF_32+l][idx], k, l, sse_out);
+	}
+}
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
@@ -593,7 +703,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 #ifdef SIMD_COEF_32
 	// group based upon size splits.
-	MixOrder = mem_calloc((count+6*MAX_KEYS_PER_CRYPT), sizeof(int));
+	MixOrder = mem_calloc((2*count+6*MAX_KEYS_PER_CRYPT), sizeof(int));
 	{
 		static const int lens[17][6] = {
 			{0,12,24,38,39,40},  //  0 byte salt (down to 2 slots now, but probably NOT valid.)
@@ -613,13 +723,24 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 			{0, 5,10,12,24,37},  // 14 byte salt
 			{0, 5, 9,12,24,37},  // 15 byte salt
 			{0, 4, 8,12,24,36} };
-		int j;
+		int j, len, start[PLAINTEXT_LENGTH + 2];
+		int *sorted = &MixOrder[count + 6*MAX_KEYS_PER_CRYPT];
 		tot_todo = 0;
 		saved_len[count] = 0; // point all 'tail' MMX buffer elements to this location.
-		for (j = 0; j < 5; ++j) {
-			for (index = 0; index < count; ++index) {
-				if (saved_len[index] >= lens[cur_salt->len][j] && saved_len[index] < lens[cur_salt->len][j+1])
-					MixOrder[tot_todo++] = index;
+		// Counting sort by length, so that most SIMD groups are of a single
+		// length (see PutDigest), then cut that into the size splits.
+		memset(start, 0, sizeof(start));
+		for (index = 0; index < count; ++index)
+			++start[saved_len[index] + 1];
+		for (len = 1; len <= PLAINTEXT_LENGTH; ++len)
+			start[len] += start[len - 1];
+		for (index = 0; index < count; ++index)
+			sorted[start[saved_len[index]]++] = index;
+		for (j = 0, index = 0; j < 5; ++j) {
+			for (; index < count; ++index) {
+				if (saved_len[sorted[index]] >= lens[cur_salt->len][j+1])
+					break;
+				MixOrder[tot_todo++] = sorted[index];
 			}
 			while (tot_todo % MAX_KEYS_PER_CRYPT)
 				MixOrder[tot_todo++] = count;
@@ -655,8 +776,11 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		cryptloopstruct *crypt_struct;
 #ifdef SIMD_COEF_32
 		char tmp_sse_out[8*MAX_KEYS_PER_CRYPT*4+MEM_ALIGN_SIMD];
+		char tmp_mix[sizeof(mixloopstruct)+MEM_ALIGN_SIMD];
 		uint32_t *sse_out;
+		mixloopstruct *mix;
 		sse_out = (uint32_t *)mem_align(tmp_sse_out, MEM_ALIGN_SIMD);
+		mix = (mixloopstruct *)mem_align(tmp_mix, MEM_ALIGN_SIMD);
 #endif
 		crypt_struct = (cryptloopstruct *)mem_align(tmp_cls,MEM_ALIGN_SIMD);
 
@@ -746,37 +870,15 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 		idx = 0;
 #ifdef SIMD_COEF_32
+		LoadMixStruct(mix, crypt_struct);
 		for (cnt = 1; ; ++cnt) {
-			if (crypt_struct->datlen[idx]==128) {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA256body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-				SIMDSHA256body((__m128i *)&cp[64], sse_out, sse_out, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK|SSEi_RELOAD);
-			} else {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA256body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-			}
+			uint32_t *cp = mix->buf[mix->type[idx]][0];
+			SIMDSHA256body(cp, sse_out, NULL, SSEi_MIXED_IN);
+			if (crypt_struct->datlen[idx]==128)
+				SIMDSHA256body(&cp[MIX_BLK_WORDS], sse_out, sse_out, SSEi_MIXED_IN|SSEi_RELOAD);
 			if (cnt == cur_salt->rounds)
 				break;
-			{
-				unsigned int j, k;
-				for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k) {
-					uint32_t *o = (uint32_t *)crypt_struct->cptr[k][idx];
-#if !ARCH_ALLOWS_UNALIGNED
-					if (!is_aligned(o, 4)) {
-						unsigned char *cp = (unsigned char*)o;
-						for (j = 0; j < 32; ++j)
-							*cp++ = ((unsigned char*)sse_out)[GETPOS(j, k)];
-					} else
-#endif
-
-					for (j = 0; j < 8; ++j)
-#if ARCH_LITTLE_ENDIAN==1
-						*o++ = JOHNSWAP(sse_out[(j*SIMD_COEF_32)+(k&(SIMD_COEF_32-1))+k/SIMD_COEF_32*8*SIMD_COEF_32]);
-#else
-						*o++ = sse_out[(j*SIMD_COEF_32)+(k&(SIMD_COEF_32-1))+k/SIMD_COEF_32*8*SIMD_COEF_32];
-#endif
-				}
-			}
+			PutDigest(mix, idx, sse_out);
 			if (++idx == 42)
 				idx = 0;
 		}
@@ -139,11 +139,6 @@ john_register_one(&fmt_cryptsha512);
 #ifdef SIMD_COEF_64
 #define MIN_KEYS_PER_CRYPT		(SIMD_COEF_64*SIMD_PARA_SHA512)
 #define MAX_KEYS_PER_CRYPT		(SIMD_COEF_64*SIMD_PARA_SHA512)
-#if ARCH_LITTLE_ENDIAN==1
-#define GETPOS(i, index)        ( (index&(SIMD_COEF_64-1))*8 + ((i)&(0xffffffff-7))*SIMD_COEF_64 + (7-((i)&7)) + (unsigned int)index/SIMD_COEF_64*SHA_BUF_SIZ*SIMD_COEF_64*8 )
-#else
-#define GETPOS(i, index)        ( (index&(SIMD_COEF_64-1))*8 + ((i)&(0xffffffff-7))*SIMD_COEF_64 + ((i)&7) + (unsigned int)index/SIMD_COEF_64*SHA_BUF_SIZ*SIMD_COEF_64*8 )
-#endif
 #else
 #define MIN_KEYS_PER_CRYPT		1
 #define MAX_KEYS_PER_CRYPT		1
@@ -198,6 +193,27 @@ typedef struct cryptloopstruct_t {
 								// things slow down. For now, we are limiting ourselves to 35 byte password, which fits into 2 SHA512 buffers
 } cryptloopstruct;
 
+#ifdef SIMD_COEF_64
+/* One block of all lanes, in the interleaved layout SSEi_MIXED_IN wants */
+#define MIX_BLK_WORDS		(16*MAX_KEYS_PER_CRYPT)
+
+/* Word W of the lanes of vector k, in a 2 block mixed buffer */
+#define MIX_WORD(blk, W, k)	(&(blk)[((W)>>4)*MIX_BLK_WORDS + (k)*16*SIMD_COEF_64 + ((W)&15)*SIMD_COEF_64])
+
+/* The 8 buffers of the cryptloopstruct, converted once per group of keys to */
+/* BE words in SSEi_MIXED_IN layout, so that SIMDSHA512body() need not gather */
+/* and swap them on every round.  type[] is which of the 8 each round uses,   */
+/* and offs[] is the byte offset the round's digest goes to in the next one.  */
+/* Keys are sorted by length, so the lanes of a vector mostly share offsets;  */
+/* then the digests are put in place a vector at a time.                      */
+typedef struct mixloopstruct_t {
+	uint64_t buf[8][2][MIX_BLK_WORDS];
+	unsigned short offs[MAX_KEYS_PER_CRYPT][42];
+	unsigned char type[42];
+	unsigned char uniform[SIMD_PARA_SHA512];	// all lanes of vector have same offs
+} mixloopstruct;
+#endif
+
 static int (*saved_len);
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static uint32_t (*crypt_out)[BINARY_SIZE / sizeof(uint32_t)];
@@ -573,6 +589,104 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 	if (!idx) pstr->datlen[41] = dlen_ppsc;
 }
 
+#ifdef SIMD_COEF_64
+static void LoadMixStruct(mixloopstruct *mix, cryptloopstruct *crypt_struct)
+{
+	unsigned int i, j, k;
+
+	for (i = 0; i < 42; ++i) {
+		mix->type[i] = (crypt_struct->bufs[0][i] - crypt_struct->buf) / (2*128*BLKS);
+		for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k)
+			mix->offs[k][i] = crypt_struct->cptr[k][i] - crypt_struct->bufs[k][(i + 1) % 42];
+	}
+	for (i = 0; i < 8; ++i)
+	for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k) {
+		unsigned char *cp = &crypt_struct->buf[i*2*128*BLKS + k*2*128];
+		for (j = 0; j < 32; ++j, cp += 8) {
+			uint64_t w;
+
+			memcpy(&w, cp, 8);
+#if ARCH_LITTLE_ENDIAN==1
+			w = JOHNSWAP64(w);
+#endif
+			MIX_WORD(mix->buf[i][0], j, k/SIMD_COEF_64)[k&(SIMD_COEF_64-1)] = w;
+		}
+	}
+	for (k = 0; k < SIMD_PARA_SHA512; ++k) {
+		mix->uniform[k] = 1;
+		for (j = 1; j < SIMD_COEF_64; ++j)
+			if (memcmp(mix->offs[k*SIMD_COEF_64], mix->offs[k*SIMD_COEF_64+j], sizeof(mix->offs[0])))
+				mix->uniform[k] = 0;
+	}
+}
+
+/* Puts the digest of lane l of vector k at byte offset n of a 2 block buffer */
+static MAYBE_INLINE void PutDigestLane(uint64_t *blk, unsigned int n, unsigned int k, unsigned int l, uint64_t *sse_out)
+{
+	unsigned int i, w = n >> 3, r = (n & 7) << 3;
+	uint64_t *d = &sse_out[k*8*SIMD_COEF_64 + l];
+
+	if (!r) {
+		for (i = 0; i < 8; ++i)
+			MIX_WORD(blk, w + i, k)[l] = d[i*SIMD_COEF_64];
+		return;
+	}
+	MIX_WORD(blk, w, k)[l] = (MIX_WORD(blk, w, k)[l] & (~0ULL << (64 - r))) | (d[0] >> r);
+	for (i = 1; i < 8; ++i)
+		MIX_WORD(blk, w + i, k)[l] = (d[(i-1)*SIMD_COEF_64] << (64 - r)) | (d[i*SIMD_COEF_64] >> r);
+	MIX_WORD(blk, w + 8, k)[l] = (MIX_WORD(blk, w + 8, k)[l] & (~0ULL >> r)) | (d[7*SIMD_COEF_64] << (64 - r));
+}
+
+/* The same for all lanes of vector k.  Shift counts must be immediates for */
+/* some archs, hence the switch.                                            */
+#define PUT_DIGEST_SHIFT(r)	\
+	vstore(x, vor(vand(vload(x), vset1_epi64(~0ULL << (64 - (r)))), vsrli_epi64(vload(&d[0]), (r))));	\
+	for (i = 1; i < 8; ++i) {	\
+		x = (vtype*)MIX_WORD(blk, w + i, k);	\
+		vstore(x, vor(vslli_epi64(vload(&d[i-1]), 64 - (r)), vsrli_epi64(vload(&d[i]), (r))));	\
+	}	\
+	x = (vtype*)MIX_WORD(blk, w + 8, k);	\
+	vstore(x, vor(vand(vload(x), vset1_epi64(~0ULL >> (r))), vslli_epi64(vload(&d[7]), 64 - (r))))
+
+static MAYBE_INLINE void PutDigestVec(uint64_t *blk, unsigned int n, unsigned int k, uint64_t *sse_out)
+{
+	unsigned int i, w = n >> 3;
+	vtype *d = (vtype*)&sse_out[k*8*SIMD_COEF_64];
+	vtype *x = (vtype*)MIX_WORD(blk, w, k);
+
+	switch (n & 7) {
+	case 0:
+		for (i = 0; i < 8; ++i)
+			vstore((vtype*)MIX_WORD(blk, w + i, k), vload(&d[i]));
+		break;
+	case 1: PUT_DIGEST_SHIFT(8); break;
+	case 2: PUT_DIGEST_SHIFT(16); break;
+	case 3: PUT_DIGEST_SHIFT(24); break;
+	case 4: PUT_DIGEST_SHIFT(32); break;
+	case 5: PUT_DIGEST_SHIFT(40); break;
+	case 6: PUT_DIGEST_SHIFT(48); break;
+	case 7: PUT_DIGEST_SHIFT(56); break;
+	}
+}
+#undef PUT_DIGEST_SHIFT
+
+/* Puts each lane's digest where the next round wants it */
+static MAYBE_INLINE void PutDigest(mixloopstruct *mix, int idx, uint64_t *sse_out)
+{
+	uint64_t *blk = mix->buf[mix->type[(idx + 1) % 42]][0];
+	unsigned int k, l;
+
+	for (k = 0; k < SIMD_PARA_SHA512; ++k) {
+		if (mix->uniform[k]) {
+			PutDigestVec(blk, mix->offs[k*SIMD_COEF_64][idx], k, sse_out);
+			continue;
+		}
+		for (l = 0; l < SIMD_COEF_64; ++l)
+			PutDigestLane(blk, mix->offs[k*SIMD_COEF_64+l][idx], k, l, sse_out);
+	}
+}
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
@@ -581,7 +695,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 #ifdef SIMD_COEF_64
 	// group based upon size splits.
-	MixOrder = mem_calloc((count+6*MAX_KEYS_PER_CRYPT), sizeof(int));
+	MixOrder = mem_calloc((2*count+6*MAX_KEYS_PER_CRYPT), sizeof(int));
 	{
 		static const int lens[17][6] = {
 			{0,24,48,88,89,90},  //  0 byte salt
@@ -601,13 +715,24 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 			{0,17,24,34,48,81},  // 14 byte salt
 			{0,17,24,33,48,81},  // 15 byte salt
 			{0,16,24,32,48,80} };
-		int j;
+		int j, len, start[PLAINTEXT_LENGTH + 2];
+		int *sorted = &MixOrder[count + 6*MAX_KEYS_PER_CRYPT];
 		tot_todo = 0;
 		saved_len[count] = 0; // point all 'tail' MMX buffer elements to this location.
-		for (j = 0; j < 5; ++j) {
-			for (index = 0; index < count; ++index) {
-				if (saved_len[index] >= lens[cur_salt->len][j] && saved_len[index] < lens[cur_salt->len][j+1])
-					MixOrder[tot_todo++] = index;
+		// Counting sort by length, so that most SIMD groups are of a single
+		// length (see PutDigest), then cut that into the size splits.
+		memset(start, 0, sizeof(start));
+		for (index = 0; index < count; ++index)
+			++start[saved_len[index] + 1];
+		for (len = 1; len <= PLAINTEXT_LENGTH; ++len)
+			start[len] += start[len - 1];
+		for (index = 0; index < count; ++index)
+			sorted[start[saved_len[index]]++] = index;
+		for (j = 0, index = 0; j < 5; ++j) {
+			for (; index < count; ++index) {
+				if (saved_len[sorted[index]] >= lens[cur_salt->len][j+1])
+					break;
+				MixOrder[tot_todo++] = sorted[index];
 			}
 			while (tot_todo % MAX_KEYS_PER_CRYPT)
 				MixOrder[tot_todo++] = count;
@@ -643,8 +768,11 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		cryptloopstruct *crypt_struct;
 #ifdef SIMD_COEF_64
 		char tmp_sse_out[8*MAX_KEYS_PER_CRYPT*8+MEM_ALIGN_SIMD];
+		char tmp_mix[sizeof(mixloopstruct)+MEM_ALIGN_SIMD];
 		uint64_t *sse_out;
+		mixloopstruct *mix;
 		sse_out = (uint64_t *)mem_align(tmp_sse_out, MEM_ALIGN_SIMD);
+		mix = (mixloopstruct *)mem_align(tmp_mix, MEM_ALIGN_SIMD);
 #endif
 		crypt_struct = (cryptloopstruct *)mem_align(tmp_cls,MEM_ALIGN_SIMD);
 
@@ -734,36 +862,15 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 		idx = 0;
 #ifdef SIMD_COEF_64
+		LoadMixStruct(mix, crypt_struct);
 		for (cnt = 1; ; ++cnt) {
-			if (crypt_struct->datlen[idx]==256) {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA512body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-				SIMDSHA512body((__m128i *)&cp[128], sse_out, sse_out, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK|SSEi_RELOAD);
-			} else {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA512body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-			}
+			uint64_t *cp = mix->buf[mix->type[idx]][0];
+			SIMDSHA512body(cp, sse_out, NULL, SSEi_MIXED_IN);
+			if (crypt_struct->datlen[idx]==256)
+				SIMDSHA512body(&cp[MIX_BLK_WORDS], sse_out, sse_out, SSEi_MIXED_IN|SSEi_RELOAD);
 			if (cnt == cur_salt->rounds)
 				break;
-			{
-				int j, k;
-				for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k) {
-					uint64_t *o = (uint64_t *)crypt_struct->cptr[k][idx];
-#if !ARCH_ALLOWS_UNALIGNED
-					if (!is_aligned(o, 8)) {
-						unsigned char *cp = (unsigned char*)o;
-						for (j = 0; j < 64; ++j)
-							*cp++ = ((unsigned char*)sse_out)[GETPOS(j, k)];
-					} else
-#endif
-					for (j = 0; j < 8; ++j)
-#if ARCH_LITTLE_ENDIAN==1
-						*o++ = JOHNSWAP64(sse_out[j*SIMD_COEF_64+(k&(SIMD_COEF_64-1))+k/SIMD_COEF_64*8*SIMD_COEF_64]);
-#else
-						*o++ = sse_out[j*SIMD_COEF_64+(k&(SIMD_COEF_64-1))+k/SIMD_COEF_64*8*SIMD_COEF_64];
-#endif
-				}
-			}
+			PutDigest(mix, idx, sse_out);
 			if (++idx == 42)
 				idx = 0;
 		}
@@ -107,62 +107,65 @@ const uint8_t * decode64_uint32(uint32_t * dst, uint32_t dstbits,
 	return src;
 }
 
-uint8_t *
-escrypt_r(escrypt_local_t * local,
-    const uint8_t * passwd, size_t passwdlen,
-    const uint8_t * setting,
-    uint8_t * buf, size_t buflen)
+/*
+ * Parse the N, r, p and salt out of a $7$ setting.  Return the length of the
+ * setting up to the end of the salt (what the hash is appended to), or 0 if
+ * it is invalid or the hash wouldn't fit in buflen.
+ */
+static size_t escrypt_parse_setting(const uint8_t * setting, size_t buflen,
+    uint64_t * N, uint32_t * r, uint32_t * p,
+    const uint8_t ** salt, size_t * saltlen)
 {
-	uint8_t hash[HASH_SIZE];
-	const uint8_t * src, * salt;
-	uint8_t * dst;
-	size_t prefixlen, saltlen, need;
-	uint64_t N;
-	uint32_t r, p;
+	const uint8_t * src;
+	size_t prefixlen, need;
 
 	if (setting[0] != '$' || setting[1] != '7' || setting[2] != '$')
-		return NULL;
+		return 0;
 	src = setting + 3;
 
 	{
 		uint32_t N_log2;
 		if (decode64_one(&N_log2, *src))
-			return NULL;
+			return 0;
 		src++;
-		N = (uint64_t)1 << N_log2;
+		*N = (uint64_t)1 << N_log2;
 	}
 
-	src = decode64_uint32(&r, 30, src);
+	src = decode64_uint32(r, 30, src);
 	if (!src)
-		return NULL;
+		return 0;
 
-	src = decode64_uint32(&p, 30, src);
+	src = decode64_uint32(p, 30, src);
 	if (!src)
-		return NULL;
+		return 0;
 
 	prefixlen = src - setting;
 
-	salt = src;
-	src = (uint8_t *)strrchr((char *)salt, '$');
+	*salt = src;
+	src = (uint8_t *)strrchr((char *)*salt, '$');
 	if (src)
-		saltlen = src - salt;
+		*saltlen = src - *salt;
 	else
-		saltlen = strlen((char *)salt);
+		*saltlen = strlen((char *)*salt);
 
-	need = prefixlen + saltlen + 1 + HASH_LEN + 1;
-	if (need > buflen || need < saltlen)
-		return NULL;
+	need = prefixlen + *saltlen + 1 + HASH_LEN + 1;
+	if (need > buflen || need < *saltlen)
+		return 0;
 
-	if (escrypt_kdf(local, passwd, passwdlen, salt, saltlen,
-	    N, r, p, hash, sizeof(hash)))
-		return NULL;
+	return prefixlen + *saltlen;
+}
+
+static uint8_t * escrypt_encode(const uint8_t * setting, size_t settinglen,
+    const uint8_t * hash, uint8_t * buf, size_t buflen)
+{
+	uint8_t * dst;
 
 	dst = buf;
-	memcpy(dst, setting, prefixlen + saltlen);
-	dst += prefixlen + saltlen;
+	memcpy(dst, setting, settinglen);
+	dst += settinglen;
 	*dst++ = '$';
 
-	dst = encode64(dst, buflen - (dst - buf), hash, sizeof(hash));
+	dst = encode64(dst, buflen - (dst - buf), hash, HASH_SIZE);
 	/* Could zeroize hash[] here, but escrypt_kdf() doesn't zeroize its
 	 * memory allocations yet anyway. */
 	if (!dst || dst >= buf + buflen) /* Can't happen */
@@ -173,6 +176,61 @@ escrypt_r(escrypt_local_t * local,
 	return buf;
 }
 
+uint8_t *
+escrypt_r(escrypt_local_t * local,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * setting,
+    uint8_t * buf, size_t buflen)
+{
+	uint8_t hash[HASH_SIZE];
+	const uint8_t * salt;
+	size_t settinglen, saltlen;
+	uint64_t N;
+	uint32_t r, p;
+
+	if (!(settinglen = escrypt_parse_setting(setting, buflen,
+	    &N, &r, &p, &salt, &saltlen)))
+		return NULL;
+
+	if (escrypt_kdf(local, passwd, passwdlen, salt, saltlen,
+	    N, r, p, hash, sizeof(hash)))
+		return NULL;
+
+	return escrypt_encode(setting, settinglen, hash, buf, buflen);
+}
+
+/*
+ * As escrypt_r(), for two passwords at once with escrypt_kdf_2().  Both
+ * results are buflen bytes long.
+ */
+int
+escrypt_r_2(escrypt_local_t * local,
+    const uint8_t * passwd0, size_t passwdlen0,
+    const uint8_t * passwd1, size_t passwdlen1,
+    const uint8_t * setting,
+    uint8_t * buf0, uint8_t * buf1, size_t buflen)
+{
+	uint8_t hash0[HASH_SIZE], hash1[HASH_SIZE];
+	const uint8_t * salt;
+	size_t settinglen, saltlen;
+	uint64_t N;
+	uint32_t r, p;
+
+	if (!(settinglen = escrypt_parse_setting(setting, buflen,
+	    &N, &r, &p, &salt, &saltlen)))
+		return -1;
+
+	if (escrypt_kdf_2(local, passwd0, passwdlen0, passwd1, passwdlen1,
+	    salt, saltlen, N, r, p, hash0, hash1, HASH_SIZE))
+		return -1;
+
+	if (!escrypt_encode(setting, settinglen, hash0, buf0, buflen) ||
+	    !escrypt_encode(setting, settinglen, hash1, buf1, buflen))
+		return -1;
+
+	return 0;
+}
+
 uint8_t *
 escrypt(const uint8_t * passwd, const uint8_t * setting)
 {
@@ -338,3 +338,26 @@ escrypt_kdf(escrypt_local_t * local,
 	/* Success! */
 	return 0;
 }
+
+/**
+ * escrypt_kdf_2(local, passwd0, passwdlen0, passwd1, passwdlen1,
+ *     salt, saltlen, N, r, p, buf0, buf1, buflen):
+ * Compute two scrypt() hashes with the same salt and parameters, as for
+ * escrypt_kdf().  This implementation simply computes them one at a time.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+escrypt_kdf_2(escrypt_local_t * local,
+    const uint8_t * passwd0, size_t passwdlen0,
+    const uint8_t * passwd1, size_t passwdlen1,
+    const uint8_t * salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf0, uint8_t * buf1, size_t buflen)
+{
+	if (escrypt_kdf(local, passwd0, passwdlen0, salt, saltlen,
+	    N, r, p, buf0, buflen))
+		return -1;
+	return escrypt_kdf(local, passwd1, passwdlen1, salt, saltlen,
+	    N, r, p, buf1, buflen);
+}
@@ -214,6 +214,42 @@ integerify(const void * B, size_t r)
 	return *(const uint32_t *)((uintptr_t)(B) + (2 * r - 1) * 64);
 }
 
+/**
+ * smix_in(B, r, X):
+ * Load B into X, in the word order used by the SSE2 salsa20/8 code above.
+ */
+inline static void
+smix_in(const uint8_t * B, size_t r, uint32_t * X32)
+{
+	size_t k;
+	uint32_t i;
+
+	for (k = 0; k < 2 * r; k++) {
+		for (i = 0; i < 16; i++) {
+			X32[k * 16 + i] =
+			    le32dec(&B[(k * 16 + (i * 5 % 16)) * 4]);
+		}
+	}
+}
+
+/**
+ * smix_out(B, r, X):
+ * The reverse of smix_in().
+ */
+inline static void
+smix_out(uint8_t * B, size_t r, const uint32_t * X32)
+{
+	size_t k;
+	uint32_t i;
+
+	for (k = 0; k < 2 * r; k++) {
+		for (i = 0; i < 16; i++) {
+			le32enc(&B[(k * 16 + (i * 5 % 16)) * 4],
+			    X32[k * 16 + i]);
+		}
+	}
+}
+
 /**
  * smix(B, r, N, V, XY):
  * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
@@ -227,18 +263,11 @@ smix(uint8_t * B, size_t r, uint32_t N, void * V, void * XY)
 {
 	size_t s = 128 * r;
 	__m128i * X = V, * Y;
-	uint32_t * X32 = V;
 	uint32_t i, j;
-	size_t k;
 
 	/* 1: X <-- B */
 	/* 3: V_i <-- X */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			X32[k * 16 + i] =
-			    le32dec(&B[(k * 16 + (i * 5 % 16)) * 4]);
-		}
-	}
+	smix_in(B, r, V);
 
 	/* 2: for i = 0 to N - 1 do */
 	for (i = 1; i < N - 1; i += 2) {
@@ -263,7 +292,6 @@ smix(uint8_t * B, size_t r, uint32_t N, void * V, void * XY)
 	X = XY;
 	blockmix_salsa8(Y, X, r);
 
-	X32 = XY;
 	Y = (void *)((uintptr_t)(XY) + s);
 
 	/* 7: j <-- Integerify(X) mod N */
@@ -284,12 +312,156 @@ smix(uint8_t * B, size_t r, uint32_t N, void * V, void * XY)
 	}
 
 	/* 10: B' <-- X */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			le32enc(&B[(k * 16 + (i * 5 % 16)) * 4],
-			    X32[k * 16 + i]);
-		}
+	smix_out(B, r, XY);
+}
+
+#define PREFETCH_BLOCK(B, s) \
+	{ \
+		const char * P = (const char *)(B); \
+		size_t o; \
+		for (o = 0; o < (s); o += 64) \
+			_mm_prefetch(P + o, _MM_HINT_T0); \
+	}
+
+/**
+ * smix_2(B0, B1, r, N, V0, V1, XY0, XY1):
+ * Compute B0 = SMix_r(B0, N) and B1 = SMix_r(B1, N) together, as for smix().
+ * The two lanes are interleaved so that the random V_j reads of each are
+ * prefetched while the other one computes, hiding most of the memory latency
+ * that a single lane has to wait for when V is larger than the caches.
+ */
+static void
+smix_2(uint8_t * B0, uint8_t * B1, size_t r, uint32_t N,
+    void * V0, void * V1, void * XY0, void * XY1)
+{
+	size_t s = 128 * r;
+	__m128i * X0 = V0, * X1 = V1, * Y0, * Y1;
+	uint32_t i, j0, j1;
+
+	/* 1: X <-- B */
+	/* 3: V_i <-- X */
+	smix_in(B0, r, V0);
+	smix_in(B1, r, V1);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 1; i < N - 1; i += 2) {
+		/* 4: X <-- H(X) */
+		/* 3: V_i <-- X */
+		Y0 = (void *)((uintptr_t)(V0) + i * s);
+		Y1 = (void *)((uintptr_t)(V1) + i * s);
+		blockmix_salsa8(X0, Y0, r);
+		blockmix_salsa8(X1, Y1, r);
+
+		/* 4: X <-- H(X) */
+		/* 3: V_i <-- X */
+		X0 = (void *)((uintptr_t)(V0) + (i + 1) * s);
+		X1 = (void *)((uintptr_t)(V1) + (i + 1) * s);
+		blockmix_salsa8(Y0, X0, r);
+		blockmix_salsa8(Y1, X1, r);
 	}
+
+	/* 4: X <-- H(X) */
+	/* 3: V_i <-- X */
+	Y0 = (void *)((uintptr_t)(V0) + i * s);
+	Y1 = (void *)((uintptr_t)(V1) + i * s);
+	blockmix_salsa8(X0, Y0, r);
+	blockmix_salsa8(X1, Y1, r);
+
+	/* 4: X <-- H(X) */
+	/* 3: V_i <-- X */
+	X0 = XY0;
+	X1 = XY1;
+	blockmix_salsa8(Y0, X0, r);
+	blockmix_salsa8(Y1, X1, r);
+
+	Y0 = (void *)((uintptr_t)(XY0) + s);
+	Y1 = (void *)((uintptr_t)(XY1) + s);
+
+	/* 7: j <-- Integerify(X) mod N */
+	j0 = integerify(X0, r) & (N - 1);
+	j1 = integerify(X1, r) & (N - 1);
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 8: X <-- H(X \xor V_j) */
+		/* 7: j <-- Integerify(X) mod N */
+		PREFETCH_BLOCK((uintptr_t)(V1) + j1 * s, s)
+		j0 = blockmix_salsa8_xor(X0,
+		    (void *)((uintptr_t)(V0) + j0 * s), Y0, r) & (N - 1);
+		PREFETCH_BLOCK((uintptr_t)(V0) + j0 * s, s)
+		j1 = blockmix_salsa8_xor(X1,
+		    (void *)((uintptr_t)(V1) + j1 * s), Y1, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		/* 7: j <-- Integerify(X) mod N */
+		PREFETCH_BLOCK((uintptr_t)(V1) + j1 * s, s)
+		j0 = blockmix_salsa8_xor(Y0,
+		    (void *)((uintptr_t)(V0) + j0 * s), X0, r) & (N - 1);
+		PREFETCH_BLOCK((uintptr_t)(V0) + j0 * s, s)
+		j1 = blockmix_salsa8_xor(Y1,
+		    (void *)((uintptr_t)(V1) + j1 * s), X1, r) & (N - 1);
+	}
+
+	/* 10: B' <-- X */
+	smix_out(B0, r, XY0);
+	smix_out(B1, r, XY1);
+}
+
+#undef PREFETCH_BLOCK
+
+/**
+ * escrypt_kdf_size(N, r, p, B_size, V_size, XY_size):
+ * Check the parameters as described for escrypt_kdf(), and compute the sizes
+ * of its buffers.  Return the total size needed for one lane; or 0 on error,
+ * with errno set.
+ */
+static size_t
+escrypt_kdf_size(uint64_t N, uint32_t r, uint32_t p,
+    size_t * B_size, size_t * V_size, size_t * XY_size)
+{
+	size_t need;
+
+	/* Sanity-check parameters. */
+	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30)) {
+		errno = EFBIG;
+		return 0;
+	}
+	if (N > UINT32_MAX) {
+		errno = EFBIG;
+		return 0;
+	}
+	if (((N & (N - 1)) != 0) || (N == 0)) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (!r || !p) {
+		errno = EINVAL;
+		return 0;
+	}
+	if ((r > SIZE_MAX / 128 / p) ||
+#if SIZE_MAX / 256 <= UINT32_MAX
+	    (r > SIZE_MAX / 256) ||
+#endif
+	    (N > SIZE_MAX / 128 / r)) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	*B_size = (size_t)128 * r * p;
+	*V_size = (size_t)128 * r * N;
+	need = *B_size + *V_size;
+	if (need < *V_size) {
+		errno = ENOMEM;
+		return 0;
+	}
+	*XY_size = (size_t)256 * r + 64;
+	need += *XY_size;
+	if (need < *XY_size) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	return need;
 }
 
 /**
@@ -314,52 +486,16 @@ escrypt_kdf(escrypt_local_t * local,
 	uint32_t * V, * XY;
 	uint32_t i;
 
-	/* Sanity-check parameters. */
 #if SIZE_MAX > UINT32_MAX
 	if (buflen > (((uint64_t)(1) << 32) - 1) * 32) {
 		errno = EFBIG;
 		return -1;
 	}
 #endif
-	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30)) {
-		errno = EFBIG;
-		return -1;
-	}
-	if (N > UINT32_MAX) {
-		errno = EFBIG;
-		return -1;
-	}
-	if (((N & (N - 1)) != 0) || (N == 0)) {
-		errno = EINVAL;
+	if (!(need = escrypt_kdf_size(N, r, p, &B_size, &V_size, &XY_size)))
 		return -1;
-	}
-	if (!r || !p) {
-		errno = EINVAL;
-		return -1;
-	}
-	if ((r > SIZE_MAX / 128 / p) ||
-#if SIZE_MAX / 256 <= UINT32_MAX
-	    (r > SIZE_MAX / 256) ||
-#endif
-	    (N > SIZE_MAX / 128 / r)) {
-		errno = ENOMEM;
-		return -1;
-	}
 
 	/* Allocate memory. */
-	B_size = (size_t)128 * r * p;
-	V_size = (size_t)128 * r * N;
-	need = B_size + V_size;
-	if (need < V_size) {
-		errno = ENOMEM;
-		return -1;
-	}
-	XY_size = (size_t)256 * r + 64;
-	need += XY_size;
-	if (need < XY_size) {
-		errno = ENOMEM;
-		return -1;
-	}
 	if (local->size < need) {
 		if (free_region(local))
 			return -1;
@@ -385,3 +521,71 @@ escrypt_kdf(escrypt_local_t * local,
 	/* Success! */
 	return 0;
 }
+
+/**
+ * escrypt_kdf_2(local, passwd0, passwdlen0, passwd1, passwdlen1,
+ *     salt, saltlen, N, r, p, buf0, buf1, buflen):
+ * Compute two scrypt() hashes with the same salt and parameters, as for
+ * escrypt_kdf(), interleaving their SMix to hide memory latency.  This needs
+ * twice the memory of escrypt_kdf().
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+escrypt_kdf_2(escrypt_local_t * local,
+    const uint8_t * passwd0, size_t passwdlen0,
+    const uint8_t * passwd1, size_t passwdlen1,
+    const uint8_t * salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf0, uint8_t * buf1, size_t buflen)
+{
+	size_t B_size, V_size, XY_size, need;
+	uint8_t * B0, * B1;
+	uint32_t * V0, * V1, * XY0, * XY1;
+	uint32_t i;
+
+#if SIZE_MAX > UINT32_MAX
+	if (buflen > (((uint64_t)(1) << 32) - 1) * 32) {
+		errno = EFBIG;
+		return -1;
+	}
+#endif
+	if (!(need = escrypt_kdf_size(N, r, p, &B_size, &V_size, &XY_size)))
+		return -1;
+	if (need > SIZE_MAX / 2) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* Allocate memory. */
+	if (local->size < 2 * need) {
+		if (free_region(local))
+			return -1;
+		if (!alloc_region(local, 2 * need))
+			return -1;
+	}
+	B0 = (uint8_t *)local->aligned;
+	V0 = (uint32_t *)((uint8_t *)B0 + B_size);
+	XY0 = (uint32_t *)((uint8_t *)V0 + V_size);
+	B1 = (uint8_t *)B0 + need;
+	V1 = (uint32_t *)((uint8_t *)B1 + B_size);
+	XY1 = (uint32_t *)((uint8_t *)V1 + V_size);
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	PBKDF2_SHA256(passwd0, passwdlen0, salt, saltlen, 1, B0, B_size);
+	PBKDF2_SHA256(passwd1, passwdlen1, salt, saltlen, 1, B1, B_size);
+
+	/* 2: for i = 0 to p - 1 do */
+	for (i = 0; i < p; i++) {
+		/* 3: B_i <-- MF(B_i, N) */
+		smix_2(&B0[(size_t)128 * i * r], &B1[(size_t)128 * i * r],
+		    r, N, V0, V1, XY0, XY1);
+	}
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256(passwd0, passwdlen0, B0, B_size, 1, buf0, buflen);
+	PBKDF2_SHA256(passwd1, passwdlen1, B1, B_size, 1, buf1, buflen);
+
+	/* Success! */
+	return 0;
+}
@@ -68,11 +68,24 @@ extern int escrypt_kdf(escrypt_local_t * __local,
     uint64_t __N, uint32_t __r, uint32_t __p,
     uint8_t * __buf, size_t __buflen);
 
+extern int escrypt_kdf_2(escrypt_local_t * __local,
+    const uint8_t * __passwd0, size_t __passwdlen0,
+    const uint8_t * __passwd1, size_t __passwdlen1,
+    const uint8_t * __salt, size_t __saltlen,
+    uint64_t __N, uint32_t __r, uint32_t __p,
+    uint8_t * __buf0, uint8_t * __buf1, size_t __buflen);
+
 extern uint8_t * escrypt_r(escrypt_local_t * __local,
     const uint8_t * __passwd, size_t __passwdlen,
     const uint8_t * __setting,
     uint8_t * __buf, size_t __buflen);
 
+extern int escrypt_r_2(escrypt_local_t * __local,
+    const uint8_t * __passwd0, size_t __passwdlen0,
+    const uint8_t * __passwd1, size_t __passwdlen1,
+    const uint8_t * __setting,
+    uint8_t * __buf0, uint8_t * __buf1, size_t __buflen);
+
 extern uint8_t * escrypt(const uint8_t * __passwd, const uint8_t * __setting);
 
 extern uint8_t * escrypt_gensalt_r(
@@ -18,48 +18,26 @@
  * SUCH DAMAGE.
  */
 
-#ifndef _MSC_VER
-#ifndef __MINGW32__
-#include <sys/mman.h>
-#endif
-#endif
-
 #include "scrypt_platform.h"
 
 #include "../memdbg.h"
 #include "../memory.h"
 
+/*
+ * The regions are allocated with alloc_region_t(), so that large ones get
+ * huge pages where available.  size is what was mapped, which is at least
+ * what was asked for.
+ */
 static void *
 alloc_region(escrypt_region_t * region, size_t size)
 {
-	uint8_t * base, * aligned;
-#if defined(MAP_ANON) && !defined (MEMDBG_ON)
-	if ((base = mmap(NULL, size, PROT_READ | PROT_WRITE,
-#ifdef MAP_NOCORE
-	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
-#else
-	    MAP_ANON | MAP_PRIVATE,
-#endif
-	    -1, 0)) == MAP_FAILED)
-		base = NULL;
-	aligned = base;
-#elif defined(HAVE_POSIX_MEMALIGN) && !defined (MEMDBG_ON)
-	if ((errno = posix_memalign(&base, 64, size)) != 0)
-		base = NULL;
-	aligned = base;
-#else
-	base = aligned = NULL;
-	if (size + 63 < size)
-		errno = ENOMEM;
-	else if ((base = mem_alloc(size + 63)) != NULL) {
-		aligned = base + 63;
-		aligned -= (uintptr_t)aligned & 63;
-	}
-#endif
-	region->base = base;
-	region->aligned = aligned;
-	region->size = base ? size : 0;
-	return aligned;
+	region_t r;
+
+	alloc_region_t(&r, size);
+	region->base = r.base;
+	region->aligned = r.aligned;
+	region->size = r.base_size;
+	return r.aligned;
 }
 
 inline static void
@@ -72,16 +50,13 @@ init_region(escrypt_region_t * region)
 static int
 free_region(escrypt_region_t * region)
 {
-	if (region->base) {
-#if defined(MAP_ANON) && !defined (MEMDBG_ON)
-		if (munmap(region->base, region->size))
-			return -1;
-#elif defined(HAVE_POSIX_MEMALIGN) && !defined (MEMDBG_ON)
-		libc_free(region->base);
-#else
-		MEM_FREE(region->base);
-#endif
-	}
+	region_t r;
+
+	r.base = region->base;
+	r.aligned = region->aligned;
+	r.base_size = r.aligned_size = region->size;
+	if (free_region_t(&r))
+		return -1;
 	init_region(region);
 	return 0;
 }
@@ -76,6 +76,12 @@ struct db_salt;
  * identification of uncracked hashes for this salt.
  */
 #define FMT_REMOVE			0x00000010
+/*
+ * set_key() may be called for different indices from several threads at
+ * once (mask mode does that in OpenMP builds).  It must only write to the
+ * key storage of its index, not to any state shared between the keys.
+ */
+#define FMT_SETKEY_MT			0x00000020
 /*
  * Format has false positive matches. Thus, do not remove hashes when
  * a likely PW is found.  This should only be set for formats where a
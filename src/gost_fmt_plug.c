@@ -36,6 +36,7 @@ john_register_one(&fmt_gost);
 #define OMP_SCALE               512 // tuned K8-dual HT
 #endif
 #endif
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"gost"
@@ -87,10 +88,7 @@ static int is_cryptopro; /* non 0 for CryptoPro hashes */
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	gost_init_table();
 	saved_key = mem_calloc(self->params.max_keys_per_crypt,
@@ -115,6 +115,8 @@ static int john_omp_threads_new;
 #include "regex.h"
 
 #include "unicode.h"
+#include "omp_autotune.h"
+#include "lmnt.h"
 #if HAVE_OPENCL
 #include "common-gpu.h"
 #endif
@@ -1109,10 +1111,8 @@ static void john_load(void)
 			do {
 				ldr_show_pw_file(&database, current->data);
 			} while ((current = current->next));
-		} else {
-			database.options->flags |= DB_PLAINTEXTS;
-			ldr_show_pot_file(&database, options.activepot);
 		}
+/* Otherwise, do_makechars() streams the pot file on its own */
 
 		return;
 	}
@@ -1282,7 +1282,18 @@ static void john_load(void)
 				       database.min_cost[i]);
 			}
 		}
-		if ((options.flags & FLG_PWD_REQ) && !database.salts) exit(0);
+		if ((options.flags & FLG_PWD_REQ) && !database.salts) {
+			/* The LM passwords may all be in the pot, but not NT */
+			if ((options.flags & FLG_LM_NT) &&
+			    database.format == &fmt_LM) {
+				log_init(LOG_NAME, options.activepot,
+				         options.session);
+				lmnt_init(&database);
+				lmnt_done();
+				log_done();
+			}
+			exit(0);
+		}
 
 		if (options.regen_lost_salts)
 			build_fake_salts_for_regen_lost(database.salts);
@@ -1395,6 +1406,14 @@ static void CPU_detect_or_fallback(char **argv, int make_check)
 #error CPU_FALLBACK is incompatible with the current DOS and Windows code
 #endif
 		if (!make_check) {
+			char chain[128];
+			char *from = getenv("JOHN_CPU_FALLBACK");
+
+/* Tell the build we end up in which ones it was chosen over */
+			snprintf(chain, sizeof(chain), "%s%s%s",
+			         from ? from : "", from ? "," : "",
+			         CPU_req_name);
+			setenv("JOHN_CPU_FALLBACK", chain, 1);
 #ifdef JOHN_SYSTEMWIDE_EXEC
 #define CPU_FALLBACK_PATHNAME JOHN_SYSTEMWIDE_EXEC "/" CPU_FALLBACK_BINARY
 #else
@@ -1500,6 +1519,17 @@ static void john_init(char *name, int argc, char **argv)
 		}
 	}
 
+	if (benchmark_compare && !(options.flags & FLG_TEST_CHK)) {
+		if (options.passwd->count != 1) {
+			if (john_main_process)
+				fprintf(stderr, "--bench-compare needs --test "
+				        "or exactly one file to compare with\n");
+			error();
+		}
+		exit(benchmark_compare_files(benchmark_compare,
+		                             options.passwd->head->data));
+	}
+
 #if HAVE_OPENCL
 	gpu_id = -1;
 #endif
@@ -1720,6 +1750,8 @@ static void john_run(void)
 			}
 		}
 
+		omp_autotune_run(&database);
+
 		if (options.flags & FLG_MASK_CHK)
 			mask_init(&database, options.mask);
 
@@ -1732,6 +1764,9 @@ static void john_run(void)
 		/* Placed here to disregard load time. */
 		sig_init_late();
 
+		if (options.flags & FLG_LM_NT)
+			lmnt_init(&database);
+
 		/* Start a resumed session by emitting a status line. */
 		if (rec_restored)
 			event_pending = event_status = 1;
@@ -1774,6 +1809,9 @@ static void john_run(void)
 		if (options.flags & FLG_MASK_CHK)
 			mask_done();
 
+		if (options.flags & FLG_LM_NT)
+			lmnt_done();
+
 		status_print();
 
 #if OS_FORK
@@ -34,6 +34,10 @@
  #endif
 #endif
 #include <openssl/crypto.h>
+#if (__x86_64__ || __i386__) && (__GNUC__ >= 5 || __clang__)
+#include <cpuid.h>
+#define HAVE_CPUID_H 1
+#endif
 
 #include "arch.h"
 #include "simd-intrinsics.h"
@@ -116,6 +120,55 @@ static void listconf_list_method_names()
 	puts("clear_keys, crypt_all, get_hash, cmp_all, cmp_one, cmp_exact");
 }
 
+#ifdef HAVE_CPUID_H
+/*
+ * The SIMD instruction sets this CPU (and OS) can run, as our builds name
+ * them, best last.  A build is tied to one of these at compile time, with
+ * CPU_FALLBACK picking among several builds at startup.
+ */
+static void listconf_cpu_simd(char *out, size_t size)
+{
+	unsigned int eax, ebx, ecx, edx, xcr0 = 0;
+	unsigned int ecx1, edx1, ebx7 = 0, ecx81 = 0;
+
+/* Each leaf's registers are kept apart, the scratch ones are reused */
+	*out = 0;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx1))
+		return;
+
+	if (ecx1 & bit_OSXSAVE) {
+		unsigned int hi;
+
+		__asm__ __volatile__("xgetbv" : "=a" (xcr0), "=d" (hi) : "c" (0));
+	}
+	if (__get_cpuid_max(0, NULL) >= 7)
+		__cpuid_count(7, 0, eax, ebx7, ecx, edx);
+	if (__get_cpuid_max(0x80000000, NULL) >= 0x80000001)
+		__cpuid(0x80000001, eax, ebx, ecx81, edx);
+
+	if (edx1 & bit_SSE2)
+		strnzcat(out, "SSE2", size);
+	if (ecx1 & bit_SSSE3)
+		strnzcat(out, " SSSE3", size);
+	if (ecx1 & bit_SSE4_1)
+		strnzcat(out, " SSE4.1", size);
+	if ((xcr0 & 0x6) != 0x6)
+		return;
+	if (ecx1 & bit_AVX)
+		strnzcat(out, " AVX", size);
+	if (ecx81 & (1 << 11))
+		strnzcat(out, " XOP", size);
+	if (ebx7 & bit_AVX2)
+		strnzcat(out, " AVX2", size);
+	if ((xcr0 & 0xe6) != 0xe6)
+		return;
+	if (ebx7 & (1 << 16))
+		strnzcat(out, " AVX512F", size);
+	if (ebx7 & (1 << 30))
+		strnzcat(out, " AVX512BW", size);
+}
+#endif
+
 static void listconf_list_build_info(void)
 {
 	char DebuggingOptions[512], *cpdbg=DebuggingOptions;
@@ -138,6 +191,17 @@ static void listconf_list_build_info(void)
 #if CPU_REQ
 	printf("CPU tests: %s\n", CPU_req_name);
 #endif
+#ifdef HAVE_CPUID_H
+	{
+		char simd[64];
+
+		listconf_cpu_simd(simd, sizeof(simd));
+		printf("CPU SIMD support: %s\n", *simd ? simd : "none");
+	}
+#endif
+	if (getenv("JOHN_CPU_FALLBACK"))
+		printf("CPU fallback: chosen over %s build(s)\n",
+		       getenv("JOHN_CPU_FALLBACK"));
 #if CPU_FALLBACK
 	puts("CPU fallback binary: " CPU_FALLBACK_BINARY);
 #endif
@@ -647,6 +711,7 @@ void listconf_parse_late(void)
 			printf(" Uses a bitslice implementation      %s\n", (format->params.flags & FMT_BS) ? "yes" : "no");
 			printf(" The split() method unifies case     %s\n", (format->params.flags & FMT_SPLIT_UNIFIES_CASE) ? "yes" : "no");
 			printf(" Supports very long hashes           %s\n", (format->params.flags & FMT_HUGE_INPUT) ? "yes" : "no");
+			printf(" Thread-safe set_key()               %s\n", (format->params.flags & FMT_SETKEY_MT) ? "yes" : "no");
 
 #ifndef DYNAMIC_DISABLED
 			if (format->params.flags & FMT_DYNAMIC) {
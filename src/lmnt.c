@@ -0,0 +1,414 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ *
+ * LM passwords are case insensitive, so an LM password of n letters stands
+ * for 2^n NT candidates (at most 2^14).  Rather than going through the NT
+ * rules for every cracked LM password against every NT hash, in a separate
+ * run, we try those candidates right away against the one NT hash of the
+ * same user, stepping through them in Gray code order so that each differs
+ * from the previous one in the case of a single letter, and handing them to
+ * the NT format in batches of its keys per crypt.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "os.h"
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "common.h"
+#include "memory.h"
+#include "path.h"
+#include "formats.h"
+#include "loader.h"
+#include "logger.h"
+#include "status.h"
+#include "signals.h"
+#include "options.h"
+#include "unicode.h"
+#include "cracker.h"
+#include "john.h"
+#include "lmnt.h"
+#include "memdbg.h"
+
+extern struct fmt_main fmt_LM, fmt_NT;
+
+#define LM_TAG				"$LM$"
+#define LM_TAG_LEN			(sizeof(LM_TAG) - 1)
+
+/* LM hash of an empty half, as in passwords of up to 7 characters */
+#define LM_EMPTY_HALF			"aad3b435b51404ee"
+
+/* A hash table of 16-bit hash values, which are the first 4 hex digits */
+#define LMNT_HASH_SIZE			0x10000
+
+/* LM passwords are up to 14 characters */
+#define LMNT_MAX_TOGGLES		14
+
+struct lmnt_user {
+	struct lmnt_user *next;		/* in the list of all users */
+	struct lmnt_user *next_nt;	/* within an lmnt_nt_hash[] bucket */
+	char *login;
+	char *nt_hex;			/* as loaded */
+	char *nt_ciphertext;		/* as in the pot file */
+	void *nt_binary;
+	char *half[2];			/* plaintext halves, NULL if unknown */
+	int done;			/* tried already, or NT cracked */
+};
+
+/* One LM half hash, of one user's password */
+struct lmnt_half {
+	struct lmnt_half *next;		/* within an lmnt_lm_hash[] bucket */
+	struct lmnt_user *user;
+	int which;
+	char hex[17];
+};
+
+static struct lmnt_user *lmnt_users, **lmnt_users_tail = &lmnt_users;
+static struct lmnt_half **lmnt_lm_hash;
+static struct lmnt_user **lmnt_nt_hash;
+static int lmnt_active;
+static void (*lmnt_next_hook)(char *key, char *ciphertext, int from_pot);
+
+static unsigned int lmnt_user_count, lmnt_tried, lmnt_cracked;
+static uint64_t lmnt_crypts;
+
+static int lmnt_is_hex(char *s, int len)
+{
+	while (len--)
+		if (atoi16[ARCH_INDEX(*s++)] == 0x7F)
+			return 0;
+
+	return !*s;
+}
+
+static unsigned int lmnt_hash(char *hex)
+{
+	return (atoi16[ARCH_INDEX(hex[0])] << 12) |
+		(atoi16[ARCH_INDEX(hex[1])] << 8) |
+		(atoi16[ARCH_INDEX(hex[2])] << 4) |
+		atoi16[ARCH_INDEX(hex[3])];
+}
+
+static void lmnt_add_half(struct lmnt_user *user, int which, char *hex)
+{
+	struct lmnt_half *half;
+	unsigned int hash;
+
+	half = mem_alloc_tiny(sizeof(*half), MEM_ALIGN_WORD);
+	memcpylwr(half->hex, hex, 16);
+	half->hex[16] = 0;
+	half->user = user;
+	half->which = which;
+
+	if (!strcmp(half->hex, LM_EMPTY_HALF))
+		user->half[which] = "";
+
+	hash = lmnt_hash(half->hex);
+	half->next = lmnt_lm_hash[hash];
+	lmnt_lm_hash[hash] = half;
+}
+
+void lmnt_add_line(char *line)
+{
+	char *fields[4], *p;
+	struct lmnt_user *user;
+	int i;
+
+	p = line;
+	for (i = 0; i < 4; i++) {
+		fields[i] = p;
+		if (!(p = strchr(p, options.loader.field_sep_char))) {
+			if (i < 3)
+				return;
+			break;
+		}
+		*p++ = 0;
+	}
+
+/* PWDUMP: user:uid:LMhash:NThash:... */
+	if (!lmnt_is_hex(fields[2], 32) || !lmnt_is_hex(fields[3], 32))
+		return;
+
+	if (!lmnt_lm_hash) {
+		lmnt_lm_hash = mem_calloc(LMNT_HASH_SIZE, sizeof(*lmnt_lm_hash));
+		lmnt_nt_hash = mem_calloc(LMNT_HASH_SIZE, sizeof(*lmnt_nt_hash));
+	}
+
+	user = mem_calloc_tiny(sizeof(*user), MEM_ALIGN_WORD);
+	user->login = str_alloc_copy(fields[0]);
+
+	user->nt_hex = str_alloc_copy(fields[3]);
+
+	lmnt_add_half(user, 0, fields[2]);
+	lmnt_add_half(user, 1, fields[2] + 16);
+
+	*lmnt_users_tail = user;
+	lmnt_users_tail = &user->next;
+	lmnt_user_count++;
+}
+
+static void lmnt_report(struct lmnt_user *user, char *key)
+{
+	char utf8buf[PLAINTEXT_BUFFER_SIZE + 1];
+	char *repkey = key, *storekey = key;
+
+	if ((options.store_utf8 || options.report_utf8) &&
+	    options.target_enc != UTF_8) {
+		char *utf8key = cp_to_utf8_r(key, utf8buf,
+		                             PLAINTEXT_BUFFER_SIZE);
+
+		if (options.report_utf8)
+			repkey = utf8key;
+		if (options.store_utf8)
+			storekey = utf8key;
+	}
+
+	log_guess(user->login, "", user->nt_ciphertext, repkey, storekey,
+	          options.loader.field_sep_char, -1);
+	log_event("- LM/NT: cracked the NT hash of %s", user->login);
+
+	if (options.flags & FLG_CRKSTAT)
+		event_pending = event_status = 1;
+
+	status.guess_count++;
+	lmnt_cracked++;
+
+/* Other hooks (such as live loopback) get to see this crack as well */
+	if (crk_guess_hook)
+		crk_guess_hook(key, user->nt_ciphertext, 0);
+}
+
+/*
+ * Hashes the count keys set, returning non-zero if one of them matched.
+ */
+static int lmnt_crypt(struct lmnt_user *user, int count)
+{
+	int index;
+
+	fmt_NT.methods.crypt_all(&count, NULL);
+	lmnt_crypts += count;
+
+	if (!fmt_NT.methods.cmp_all(user->nt_binary, count))
+		return 0;
+
+	for (index = 0; index < count; index++)
+		if (fmt_NT.methods.cmp_one(user->nt_binary, index) &&
+		    fmt_NT.methods.cmp_exact(user->nt_ciphertext, index)) {
+			lmnt_report(user, fmt_NT.methods.get_key(index));
+			return 1;
+		}
+
+	return 0;
+}
+
+static void lmnt_try(struct lmnt_user *user)
+{
+	char word[PLAINTEXT_BUFFER_SIZE + 1];
+	int pos[LMNT_MAX_TOGGLES];
+	int toggles, count, max_keys;
+	unsigned int i, total;
+	char *p;
+
+	user->done = 1;
+	lmnt_tried++;
+
+	strnzcpy(word, user->half[0], sizeof(word));
+	strnzcat(word, user->half[1], sizeof(word));
+
+/* Start from all lowercase, and note the letters */
+	toggles = 0;
+	for (p = word; *p; p++) {
+		*p = enc_tolower(*p);
+		if (enc_toupper(*p) != *p && toggles < LMNT_MAX_TOGGLES)
+			pos[toggles++] = p - word;
+	}
+
+	max_keys = fmt_NT.params.max_keys_per_crypt;
+	fmt_NT.methods.clear_keys();
+	count = 0;
+
+	total = 1U << toggles;
+	for (i = 0; i < total; i++) {
+		if (i) {
+			int bit = 0;
+			char c;
+
+/* Gray code: flip the letter for the lowest set bit of i */
+			while (!(i >> bit & 1))
+				bit++;
+			c = word[pos[bit]];
+			word[pos[bit]] = (enc_tolower(c) == c) ?
+				enc_toupper(c) : enc_tolower(c);
+		}
+
+		fmt_NT.methods.set_key(word, count++);
+
+		if (count == max_keys || i == total - 1) {
+			if (lmnt_crypt(user, count))
+				return;
+			fmt_NT.methods.clear_keys();
+			count = 0;
+		}
+	}
+}
+
+static void lmnt_guess(char *key, char *ciphertext, int from_pot)
+{
+	struct lmnt_half *half;
+
+	if (lmnt_next_hook)
+		lmnt_next_hook(key, ciphertext, from_pot);
+
+/* Other nodes of this session try what they crack themselves */
+	if (from_pot && options.node_count)
+		return;
+
+	if (!ciphertext || strncmp(ciphertext, LM_TAG, LM_TAG_LEN) ||
+	    !lmnt_is_hex(ciphertext + LM_TAG_LEN, 16))
+		return;
+	ciphertext += LM_TAG_LEN;
+
+	for (half = lmnt_lm_hash[lmnt_hash(ciphertext)]; half;
+	     half = half->next) {
+		struct lmnt_user *user = half->user;
+
+		if (user->done || user->half[half->which] ||
+		    strcmp(half->hex, ciphertext))
+			continue;
+
+		user->half[half->which] = str_alloc_copy(key);
+		if (user->half[!half->which])
+			lmnt_try(user);
+	}
+}
+
+/*
+ * Picks up LM halves cracked earlier, and NT hashes cracked already, from
+ * the pot file.
+ */
+static void lmnt_read_pot(void)
+{
+	char line[LINE_BUFFER_SIZE];
+	char buf[PLAINTEXT_BUFFER_SIZE + 1];
+	char *nt_tag = fmt_NT.params.signature[0];
+	int nt_tag_len = strlen(nt_tag);
+	FILE *pot_file;
+
+	if (!(pot_file = fopen(path_expand(options.activepot), "rb")))
+		return;
+
+	while (fgetl(line, sizeof(line), pot_file)) {
+		char *key;
+
+		if (!(key = strchr(line, options.loader.field_sep_char)))
+			continue;
+		*key++ = 0;
+
+		if (options.store_utf8 && options.target_enc != UTF_8)
+			key = utf8_to_cp_r(key, buf, PLAINTEXT_BUFFER_SIZE);
+
+		if (!strncmp(line, LM_TAG, LM_TAG_LEN) &&
+		    lmnt_is_hex(line + LM_TAG_LEN, 16)) {
+			struct lmnt_half *half;
+
+			strlwr(line + LM_TAG_LEN);
+			for (half = lmnt_lm_hash[lmnt_hash(line + LM_TAG_LEN)];
+			     half; half = half->next)
+				if (!half->user->half[half->which] &&
+				    !strcmp(half->hex, line + LM_TAG_LEN))
+					half->user->half[half->which] =
+						str_alloc_copy(key);
+		} else
+		if (!strncmp(line, nt_tag, nt_tag_len) &&
+		    lmnt_is_hex(line + nt_tag_len, 32)) {
+			struct lmnt_user *user;
+
+			strlwr(line + nt_tag_len);
+			for (user = lmnt_nt_hash[lmnt_hash(line + nt_tag_len)];
+			     user; user = user->next_nt)
+				if (user->nt_ciphertext &&
+				    !strcmp(user->nt_ciphertext, line))
+					user->done = 1;
+		}
+	}
+
+	if (fclose(pot_file))
+		pexit("fclose");
+}
+
+void lmnt_init(struct db_main *db)
+{
+	struct lmnt_user *user;
+
+	if (db->format != &fmt_LM) {
+		if (john_main_process)
+			fprintf(stderr, "Warning: --lm-nt only applies to LM "
+			        "hashes, ignored\n");
+		return;
+	}
+
+	if (!lmnt_users) {
+		log_event("- LM/NT: no PWDUMP lines with both LM and NT hashes");
+		return;
+	}
+
+	fmt_init(&fmt_NT);
+
+	for (user = lmnt_users; user; user = user->next) {
+		char nt[LINE_BUFFER_SIZE];
+		unsigned int hash;
+
+		strnzcpy(nt, fmt_NT.params.signature[0], sizeof(nt));
+		strnzcat(nt, user->nt_hex, sizeof(nt));
+		if (!fmt_NT.methods.valid(nt, &fmt_NT)) {
+			user->done = 1;
+			continue;
+		}
+		user->nt_ciphertext =
+			str_alloc_copy(fmt_NT.methods.split(nt, 0, &fmt_NT));
+		user->nt_binary = mem_alloc_copy(
+			fmt_NT.methods.binary(user->nt_ciphertext),
+			fmt_NT.params.binary_size, fmt_NT.params.binary_align);
+
+		hash = lmnt_hash(user->nt_ciphertext +
+		                 strlen(fmt_NT.params.signature[0]));
+		user->next_nt = lmnt_nt_hash[hash];
+		lmnt_nt_hash[hash] = user;
+	}
+
+	lmnt_read_pot();
+
+	lmnt_next_hook = crk_guess_hook;
+	crk_guess_hook = lmnt_guess;
+	lmnt_active = 1;
+
+	log_event("- LM/NT: %u users with NT hashes", lmnt_user_count);
+
+/* Users whose LM passwords are fully known already, tried by one process */
+	if (john_main_process)
+	for (user = lmnt_users; user; user = user->next)
+		if (!user->done && user->half[0] && user->half[1])
+			lmnt_try(user);
+}
+
+void lmnt_done(void)
+{
+	if (!lmnt_active)
+		return;
+
+	crk_guess_hook = lmnt_next_hook;
+	lmnt_active = 0;
+
+	fmt_done(&fmt_NT);
+
+	log_event("- LM/NT: %u passwords tried, "LLu" NT hashes computed, "
+	          "%u NT hashes cracked", lmnt_tried,
+	          (unsigned long long)lmnt_crypts, lmnt_cracked);
+}
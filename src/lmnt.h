@@ -0,0 +1,40 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * --lm-nt: while cracking LM hashes from PWDUMP files, take each user's NT
+ * hash along, and as soon as both halves of the LM password are known, try
+ * every case variant of it against that user's NT hash.
+ */
+
+#ifndef _JOHN_LMNT_H
+#define _JOHN_LMNT_H
+
+#include "loader.h"
+
+/*
+ * Called by the loader for each password file line it accepts, with a copy
+ * of the line as read (which is cut up here).  Remembers the login and the
+ * LM and NT hashes of PWDUMP lines.
+ */
+extern void lmnt_add_line(char *line);
+
+/*
+ * Starts the attack for the session's database, if its format is LM: picks
+ * up halves already in the pot file, tries the users whose passwords are
+ * thus known, and hooks into the cracker for the rest.
+ */
+extern void lmnt_init(struct db_main *db);
+
+/*
+ * Unhooks, and logs what was done.
+ */
+extern void lmnt_done(void);
+
+#endif
@@ -46,6 +46,7 @@
 #include "base64_convert.h"
 #include "md5.h"
 #include "single.h"
+#include "lmnt.h"
 #include "memdbg.h"
 
 #ifdef HAVE_CRYPT
@@ -63,6 +64,12 @@ int ldr_in_pot = 0;
  */
 static int ldr_loading_testdb = 0;
 
+/*
+ * If this is set, we are building a scaling benchmark db, so the bitmap and
+ * hash table need to be freeable
+ */
+static int ldr_loading_scaling = 0;
+
 /*
  * this is set during salt_sort, so it knows the size
  */
@@ -1028,6 +1035,7 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 	struct list_main *words;
 	size_t pw_size;
 	int i;
+	char lmnt_line[LINE_BUFFER_SIZE];
 
 #ifdef HAVE_FUZZ
 	char *line_sb;
@@ -1035,12 +1043,19 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 	line_sb = line;
 	if (options.flags & FLG_FUZZ_CHK)
 		line_sb = check_bom(line);
+#endif
+/* ldr_split_line() cuts the line up */
+	if (options.flags & FLG_LM_NT)
+		strnzcpy(lmnt_line, line, sizeof(lmnt_line));
+#ifdef HAVE_FUZZ
 	count = ldr_split_line(&login, &ciphertext, &gecos, &home, &uid,
 		NULL, &db->format, db->options, line_sb);
 #else
 	count = ldr_split_line(&login, &ciphertext, &gecos, &home, &uid,
 		NULL, &db->format, db->options, line);
 #endif
+	if ((options.flags & FLG_LM_NT) && count > 0)
+		lmnt_add_line(lmnt_line);
 	if (count <= 0) return;
 	if (count >= 2) db->options->flags |= DB_SPLIT;
 
@@ -1420,6 +1435,169 @@ void ldr_free_test_db(struct db_main *db)
 	}
 }
 
+static void ldr_init_hash(struct db_main *db);
+
+static uint64_t ldr_random(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/*
+ * Randomizes the last run of at least 16 hex digits in ciphertext, keeping
+ * its case.  Returns zero if there's no such run.
+ */
+static int ldr_random_hex(char *ciphertext, uint64_t *state)
+{
+	static const char *digits[2] = {
+		"0123456789abcdef", "0123456789ABCDEF"
+	};
+	char *p, *start = NULL, *end = NULL, *q;
+	int upper;
+
+	for (p = ciphertext; *p; p++) {
+		if (!isxdigit(ARCH_INDEX(*p)))
+			continue;
+		for (q = p; isxdigit(ARCH_INDEX(*q)); q++);
+		if (q - p >= 16) {
+			start = p;
+			end = q;
+		}
+		p = q - 1;
+	}
+
+	if (!start)
+		return 0;
+
+	upper = 0;
+	for (p = start; p < end; p++)
+		if (*p >= 'A' && *p <= 'F')
+			upper = 1;
+
+	for (p = start; p < end; p++)
+		*p = digits[upper][ldr_random(state) & 0xf];
+
+	return 1;
+}
+
+struct db_main *ldr_init_scaling_db(struct db_main *test_db, int count)
+{
+	struct fmt_main *format = test_db->format;
+	struct db_main *db;
+	struct db_salt *salt;
+	struct db_password *pw;
+	size_t binary_size, size;
+	char *ciphertext, *source, *binary, *binaries;
+	char line[LINE_BUFFER_SIZE];
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	int i, use_valid;
+
+	if (!test_db->salts || !test_db->salts->list)
+		return NULL;
+
+	db = mem_calloc(1, sizeof(struct db_main));
+	memcpy(db, test_db, sizeof(struct db_main));
+	db->salt_hash = NULL;
+	db->cracked_hash = NULL;
+	db->password_hash = NULL;
+
+	salt = mem_alloc(sizeof(struct db_salt));
+	memcpy(salt, test_db->salts, sizeof(struct db_salt));
+	salt->next = NULL;
+	salt->bitmap = NULL;
+	salt->hash = NULL;
+	salt->sequential_id = 0;
+	salt->count = count;
+	db->salts = salt;
+	db->salt_count = 1;
+	db->password_count = count;
+
+	source = test_db->salts->list->source;
+	ciphertext = format->methods.source(source, test_db->salts->list->binary);
+
+	binary_size = format->params.binary_size;
+	size = binary_size;
+	if (format->params.binary_align > 1)
+		size = (size + format->params.binary_align - 1) /
+			format->params.binary_align *
+			format->params.binary_align;
+	if (!size)
+		size = 1;
+	binaries = mem_alloc_align(size * count, MEM_ALIGN_CACHE);
+	salt->list = pw = mem_alloc(sizeof(struct db_password) * count);
+
+/*
+ * Where randomizing the hex digits of a test vector gives a valid ciphertext
+ * with a different binary, use the format's own binary() so the values match
+ * what it would load.  Otherwise, just use random binaries.
+ */
+	use_valid = 0;
+	strnzcpy(line, ciphertext, sizeof(line));
+	if (ldr_random_hex(line, &state) &&
+	    format->methods.valid(line, format) == 1) {
+		binary = format->methods.binary(
+		    format->methods.split(line, 0, format));
+		use_valid = memcmp(binary, test_db->salts->list->binary,
+		                   binary_size) != 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		char *dst = binaries + size * i;
+
+		if (use_valid) {
+			strnzcpy(line, ciphertext, sizeof(line));
+			ldr_random_hex(line, &state);
+			binary = format->methods.binary(
+			    format->methods.split(line, 0, format));
+			memcpy(dst, binary, binary_size);
+		} else {
+			size_t j;
+
+			for (j = 0; j < binary_size; j += 8) {
+				uint64_t x = ldr_random(&state);
+				memcpy(dst + j, &x, binary_size - j < 8 ?
+				       binary_size - j : 8);
+			}
+		}
+
+		pw[i].next = i + 1 < count ? &pw[i + 1] : NULL;
+		pw[i].binary = dst;
+		pw[i].source = source;
+		pw[i].login = "?";
+		pw[i].uid = "";
+		pw[i].words = NULL;
+	}
+
+	ldr_loading_scaling = 1;
+	ldr_init_hash(db);
+	ldr_loading_scaling = 0;
+
+	if (options.verbosity == VERB_MAX && john_main_process)
+		fprintf(stderr, "Generated %d %s hashes for scaling test\n",
+		        count, use_valid ? "valid" : "random binary");
+
+	return db;
+}
+
+void ldr_free_scaling_db(struct db_main *db)
+{
+	if (db) {
+		if (db->salts->list)
+			MEM_FREE(db->salts->list->binary);
+		MEM_FREE(db->salts->list);
+		MEM_FREE(db->salts->bitmap);
+		MEM_FREE(db->salts->hash);
+		MEM_FREE(db->salts);
+		MEM_FREE(db);
+	}
+}
+
 void ldr_load_pot_file(struct db_main *db, char *name)
 {
 	if (db->format && !(db->format->params.flags & FMT_NOT_EXACT)) {
@@ -1555,10 +1733,89 @@ static void ldr_gen_salt_md5(struct db_salt *s, int dynamic) {
  * would fail under many situations.
  *
  */
+/*
+ * Re-builds the linked list of salts (and the salt hash table, if we still
+ * have one) in the order of ar[], optionally computing the salts' md5.
+ */
+static void ldr_relink_salts(struct db_main *db, salt_cmp_t *ar, int gen_md5)
+{
+	int i, dynamic = (db->format->params.flags & FMT_DYNAMIC) == FMT_DYNAMIC;
+	struct db_salt *s;
+
+	/* Reset salt hash table, if we still have one */
+	if (db->salt_hash) {
+		memset(db->salt_hash, 0,
+		       SALT_HASH_SIZE * sizeof(struct db_salt *));
+	}
+
+	db->salts = ar[0].p;
+	s = db->salts;
+	if (gen_md5)
+		ldr_gen_salt_md5(s, dynamic);
+	for (i = 1; i <= db->salt_count; ++i) {
+		/* Rebuild salt hash table, if we still had one */
+		if (db->salt_hash) {
+			int hash;
+
+			hash = db->format->methods.salt_hash(s->salt);
+			if (!db->salt_hash[hash])
+				db->salt_hash[hash] = s;
+		}
+		if (i < db->salt_count) {
+			s->next = ar[i].p;
+			s = s->next;
+			if (gen_md5)
+				ldr_gen_salt_md5(s, dynamic);
+		}
+	}
+	s->next = 0;
+}
+
+double ldr_salt_priority(struct db_salt *salt)
+{
+	return (double)salt->count / (salt->cost[0] ? salt->cost[0] : 1);
+}
+
+int ldr_salt_priority_cmp(double priority1, uint32_t *md5_1,
+	double priority2, uint32_t *md5_2)
+{
+	if (priority1 != priority2)
+		return priority1 > priority2 ? -1 : 1;
+
+	return memcmp(md5_1, md5_2, 16);
+}
+
+static int ldr_salt_cmp_cost(const void *x, const void *y) {
+	salt_cmp_t *X = (salt_cmp_t *)x;
+	salt_cmp_t *Y = (salt_cmp_t *)y;
+	return ldr_salt_priority_cmp(ldr_salt_priority(X->p), X->p->salt_md5,
+	                             ldr_salt_priority(Y->p), Y->p->salt_md5);
+}
+
+void ldr_sort_salts_by_cost(struct db_main *db)
+{
+	int i;
+	struct db_salt *s;
+	salt_cmp_t *ar;
+
+	if (db->salt_count < 2)
+		return;
+
+	ar = mem_alloc(sizeof(salt_cmp_t) * db->salt_count);
+	for (i = 0, s = db->salts; i < db->salt_count; i++, s = s->next)
+		ar[i].p = s;
+
+	qsort(ar, db->salt_count, sizeof(ar[0]), ldr_salt_cmp_cost);
+	ldr_relink_salts(db, ar, 0);
+
+	MEM_FREE(ar);
+}
+
 static void ldr_sort_salts(struct db_main *db)
 {
 	int i;
 	struct db_salt *s;
+	char *order;
 #ifndef DEBUG_SALT_SORT
 	salt_cmp_t *ar;
 #else
@@ -1594,32 +1851,8 @@ static void ldr_sort_salts(struct db_main *db)
 	else /* Most used salt first */
 		qsort(ar, db->salt_count, sizeof(ar[0]), ldr_salt_cmp_num);
 
-	/* Reset salt hash table, if we still have one */
-	if (db->salt_hash) {
-		memset(db->salt_hash, 0,
-		       SALT_HASH_SIZE * sizeof(struct db_salt *));
-	}
-
 	/* finally, we re-build the linked list of salts */
-	db->salts = ar[0].p;
-	s = db->salts;
-	ldr_gen_salt_md5(s, (db->format->params.flags & FMT_DYNAMIC) == FMT_DYNAMIC);
-	for (i = 1; i <= db->salt_count; ++i) {
-		/* Rebuild salt hash table, if we still had one */
-		if (db->salt_hash) {
-			int hash;
-
-			hash = db->format->methods.salt_hash(s->salt);
-			if (!db->salt_hash[hash])
-				db->salt_hash[hash] = s;
-		}
-		if (i < db->salt_count) {
-			s->next = ar[i].p;
-			s = s->next;
-			ldr_gen_salt_md5(s, (db->format->params.flags & FMT_DYNAMIC) == FMT_DYNAMIC);
-		}
-	}
-	s->next = 0;
+	ldr_relink_salts(db, ar, 1);
 
 #ifndef DEBUG_SALT_SORT
 	MEM_FREE(ar);
@@ -1629,6 +1862,18 @@ static void ldr_sort_salts(struct db_main *db)
 	 */
 	s = db->salts;
 #endif
+
+	if (!ldr_loading_testdb && !ldr_loading_scaling &&
+	    (order = cfg_get_param(SECTION_OPTIONS, NULL, "SaltOrder")) &&
+	    !strcasecmp(order, "cost")) {
+		if (fmt_salt_compare) {
+			log_event("- SaltOrder = cost ignored, the format "
+			          "orders its salts itself");
+		} else {
+			db->options->flags |= DB_COST_ORDER;
+			ldr_sort_salts_by_cost(db);
+		}
+	}
 }
 
 /*
@@ -1810,14 +2055,21 @@ static void ldr_init_hash_for_salt(struct db_main *db, struct db_salt *salt)
 		size_t size = (bitmap_size +
 		    sizeof(*salt->bitmap) * 8 - 1) /
 		    (sizeof(*salt->bitmap) * 8) * sizeof(*salt->bitmap);
-		salt->bitmap = mem_alloc_tiny(size, sizeof(*salt->bitmap));
+		if (ldr_loading_scaling)
+			salt->bitmap = mem_alloc(size);
+		else
+			salt->bitmap = mem_alloc_tiny(size,
+			                              sizeof(*salt->bitmap));
 		memset(salt->bitmap, 0, size);
 	}
 
 	hash_size = bitmap_size >> PASSWORD_HASH_SHR;
 	if (hash_size > 1) {
 		size_t size = hash_size * sizeof(struct db_password *);
-		salt->hash = mem_alloc_tiny(size, MEM_ALIGN_WORD);
+		if (ldr_loading_scaling)
+			salt->hash = mem_alloc(size);
+		else
+			salt->hash = mem_alloc_tiny(size, MEM_ALIGN_WORD);
 		memset(salt->hash, 0, size);
 	}
 
@@ -181,6 +181,8 @@ struct db_cracked {
 #define DB_CRACKED			0x00000100
 /* Cracked plaintexts list */
 #define DB_PLAINTEXTS			0x00000200
+/* Salts ordered by expected cracks per second (SaltOrder = cost) */
+#define DB_COST_ORDER			0x00000400
 
 /*
  * Password database options.
@@ -299,6 +301,24 @@ extern void ldr_load_pot_file(struct db_main *db, char *name);
  */
 extern void ldr_fix_database(struct db_main *db);
 
+/*
+ * A salt's expected cracks per unit of work: its hashes left divided by its
+ * first tunable cost.  With SaltOrder = cost, salts are tried highest first.
+ */
+extern double ldr_salt_priority(struct db_salt *salt);
+
+/*
+ * Compares two salts' positions in that order, given their priorities and
+ * md5 (which breaks ties, to keep the order deterministic for --restore).
+ */
+extern int ldr_salt_priority_cmp(double priority1, uint32_t *md5_1,
+	double priority2, uint32_t *md5_2);
+
+/*
+ * Re-orders the salts by priority, for DB_COST_ORDER.
+ */
+extern void ldr_sort_salts_by_cost(struct db_main *db);
+
 /*
  * Create a fake database from a format's test vectors and return a pointer
  * to it.
@@ -311,6 +331,17 @@ extern struct db_main *ldr_init_test_db(struct fmt_main *format,
  */
 extern void ldr_free_test_db(struct db_main *db);
 
+/*
+ * Create a database with a single salt taken from a test database and count
+ * generated hashes for it, for benchmarking lookups at scale.
+ */
+extern struct db_main *ldr_init_scaling_db(struct db_main *test_db, int count);
+
+/*
+ * Destroy a database made by ldr_init_scaling_db().
+ */
+extern void ldr_free_scaling_db(struct db_main *db);
+
 /*
  * Loads cracked passwords into the database.
  */
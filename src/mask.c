@@ -14,6 +14,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "arch.h"
 #include "misc.h" /* for error() */
@@ -65,6 +68,19 @@ static unsigned long long cand, rec_cand;
 unsigned long long mask_tot_cand;
 unsigned long long mask_parent_keys;
 
+#ifdef _OPENMP
+/*
+ * Formats with FMT_SETKEY_MT get their keys set from all OpenMP threads, each
+ * thread taking a run of consecutive keys of at least this many (so that the
+ * threads rarely share a SIMD key buffer cache line).
+ */
+#define MASK_MT_KEYS			64
+
+/* Set while generate_keys_mt() owns the position, and that position */
+static int mt_gen_active;
+static unsigned long long mt_gen_pos;
+#endif
+
 #define BUILT_IN_CHARSET "ludsaLUDSAbhBH123456789"
 
 #define store_op(k, i) \
@@ -1499,6 +1515,150 @@ static MAYBE_INLINE char* mask_cp_to_utf8(char *in)
 	return in;
 }
 
+/*
+ * Sets iter of all active placeholders from a linear position, the first
+ * placeholder being the fastest changing one.
+ */
+static void set_position(mask_cpu_context *cpu_mask_ctx,
+                         unsigned long long position)
+{
+	unsigned long long ctr = 1;
+	int ps = cpu_mask_ctx->ps1;
+
+	while (ps != MAX_NUM_MASK_PLHDR) {
+		cpu_mask_ctx->ranges[ps].iter = (position / ctr) %
+			cpu_mask_ctx->ranges[ps].count;
+		ctr *= cpu_mask_ctx->ranges[ps].count;
+		ps = cpu_mask_ctx->ranges[ps].next;
+	}
+}
+
+#ifdef _OPENMP
+/*
+ * Sets keys [start, start + num) of the current length at format indices
+ * [index, index + num).  Uses its own copy of the template and its own
+ * counters, so any number of these can run at once.
+ */
+static void set_keys_mt(mask_cpu_context *cpu_mask_ctx, int index,
+                        unsigned long long start, int num)
+{
+	char key[PLAINTEXT_BUFFER_SIZE + 8];
+	unsigned char iter[MAX_NUM_MASK_PLHDR];
+	int pos[MAX_NUM_MASK_PLHDR], ps[MAX_NUM_MASK_PLHDR];
+	unsigned long long ctr = 1;
+	int i, n = 0;
+
+	memset(key, 0, sizeof(key));
+	strnzcpy(key, template_key, PLAINTEXT_BUFFER_SIZE);
+
+	i = cpu_mask_ctx->ps1;
+	while (i != MAX_NUM_MASK_PLHDR) {
+		ps[n] = i;
+		pos[n] = cpu_mask_ctx->ranges[i].pos +
+			cpu_mask_ctx->ranges[i].offset;
+		iter[n] = (start / ctr) % cpu_mask_ctx->ranges[i].count;
+		key[pos[n]] = cpu_mask_ctx->ranges[i].chars[iter[n]];
+		ctr *= cpu_mask_ctx->ranges[i].count;
+		i = cpu_mask_ctx->ranges[i].next;
+		n++;
+	}
+
+	while (num--) {
+		mask_fmt->methods.set_key(key, index++);
+
+		for (i = 0; i < n; i++) {
+			mask_range *range = &cpu_mask_ctx->ranges[ps[i]];
+
+			if (++iter[i] == range->count)
+				iter[i] = 0;
+			key[pos[i]] = range->chars[iter[i]];
+			if (iter[i])
+				break;
+		}
+	}
+}
+
+/*
+ * Counterpart of generate_keys() for stand-alone mask mode with formats whose
+ * set_key() is thread safe.  The cracker's key buffer is filled from all
+ * OpenMP threads, each setting a consecutive run of keys, so keys are still
+ * tried in the same order as by generate_keys() and the saved position is
+ * that of the last key in the buffer, as it would be there.
+ * Returns -1 (having done nothing) if this can't be used, for example if the
+ * keyspace is too large to address linearly.
+ */
+static int generate_keys_mt(mask_cpu_context *cpu_mask_ctx,
+                            unsigned long long *my_candidates)
+{
+	int threads = omp_get_max_threads();
+	unsigned long long ctr = 1, pos = 0, end;
+	int ps, room;
+
+	if (threads < 2 || !(mask_fmt->params.flags & FMT_SETKEY_MT) ||
+	    mask_fmt->params.max_keys_per_crypt < threads * MASK_MT_KEYS ||
+	    (options.flags & (FLG_MASK_STACKED | FLG_TEST_CHK)) || f_filter ||
+	    (mask_has_8bit &&
+	     options.internal_cp != UTF_8 && options.target_enc == UTF_8) ||
+	    crk_key_block(&room) < 0)
+		return -1;
+
+	ps = cpu_mask_ctx->ps1;
+	while (ps != MAX_NUM_MASK_PLHDR) {
+		unsigned int count = cpu_mask_ctx->ranges[ps].count;
+
+		if (ctr > ~0ULL / count)
+			return -1;
+		pos += cpu_mask_ctx->ranges[ps].iter * ctr;
+		ctr *= count;
+		ps = cpu_mask_ctx->ranges[ps].next;
+	}
+
+	end = ctr;
+	if (options.node_count && *my_candidates < end - pos)
+		end = pos + *my_candidates;
+
+	while (pos < end) {
+		int index = crk_key_block(&room);
+		int num = room, per_thread, t;
+
+		if (num > end - pos)
+			num = end - pos;
+		per_thread = (num + threads - 1) / threads;
+		per_thread = (per_thread + MASK_MT_KEYS - 1) / MASK_MT_KEYS *
+			MASK_MT_KEYS;
+
+#pragma omp parallel for
+		for (t = 0; t < threads; t++) {
+			int first = t * per_thread;
+			int last = first + per_thread;
+
+			if (last > num)
+				last = num;
+			if (first < last)
+				set_keys_mt(cpu_mask_ctx, index + first,
+				            pos + first, last - first);
+		}
+
+		if (options.node_count)
+			*my_candidates -= num;
+		mt_gen_pos = pos + num - 1;
+		pos += num;
+
+		mt_gen_active = 1;
+		if (crk_process_keys(num)) {
+			mt_gen_active = 0;
+			set_position(cpu_mask_ctx, mt_gen_pos);
+			return 1;
+		}
+		mt_gen_active = 0;
+	}
+
+	set_position(cpu_mask_ctx, end == ctr ? 0 : end);
+
+	return 0;
+}
+#endif
+
 #define ranges(i) cpu_mask_ctx->ranges[i]
 
 /*
@@ -1553,6 +1713,15 @@ static int generate_keys(mask_cpu_context *cpu_mask_ctx,
 				return 1; \
 	} while(0)
 
+#ifdef _OPENMP
+	{
+		int ret = generate_keys_mt(cpu_mask_ctx, my_candidates);
+
+		if (ret >= 0)
+			return ret;
+	}
+#endif
+
 	ps1 = cpu_mask_ctx->ps1;
 	ps2 = cpu_mask_ctx->ranges[ps1].next;
 	ps3 = cpu_mask_ctx->ranges[ps2].next;
@@ -1746,7 +1915,7 @@ static void skip_position(mask_cpu_context *cpu_mask_ctx, int *arr)
 
 static unsigned long long divide_work(mask_cpu_context *cpu_mask_ctx)
 {
-	unsigned long long offset, my_candidates, total_candidates, ctr;
+	unsigned long long offset, my_candidates, total_candidates;
 	int ps;
 	double fract;
 
@@ -1777,14 +1946,7 @@ static unsigned long long divide_work(mask_cpu_context *cpu_mask_ctx)
 		error();
 	}
 
-	ctr = 1;
-	ps = cpu_mask_ctx->ps1;
-	while(ps != MAX_NUM_MASK_PLHDR) {
-		cpu_mask_ctx->ranges[ps].iter = (offset / ctr) %
-			cpu_mask_ctx->ranges[ps].count;
-		ctr *= cpu_mask_ctx->ranges[ps].count;
-		ps = cpu_mask_ctx->ranges[ps].next;
-	}
+	set_position(cpu_mask_ctx, offset);
 
 	return my_candidates;
 }
@@ -1883,6 +2045,10 @@ void mask_fix_state(void)
 		crk_fix_state();
 		parent_fix_state_pending = 0;
 	}
+#ifdef _OPENMP
+	if (mt_gen_active)
+		set_position(&cpu_mask_ctx, mt_gen_pos);
+#endif
 	rec_cand = cand;
 	rec_ctx.count = cpu_mask_ctx.count;
 	rec_ctx.offset = cpu_mask_ctx.offset;
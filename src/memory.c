@@ -19,6 +19,9 @@
 #endif
 
 #include "arch.h"
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 #include "misc.h"
 #include "memory.h"
 #include "common.h"
@@ -734,6 +737,15 @@ alloc_region_t(region_t * region, size_t size)
 	if (flags & MAP_HUGETLB) {
 		flags &= ~MAP_HUGETLB;
 		base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+#ifdef MADV_HUGEPAGE
+/*
+ * No huge pages reserved (the usual case), so ask for transparent ones.  Each
+ * thread first touching its own region also keeps it on that thread's NUMA
+ * node.
+ */
+		if (base != MAP_FAILED)
+			madvise(base, size, MADV_HUGEPAGE);
+#endif
 	}
 
 #else
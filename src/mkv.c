@@ -689,13 +689,19 @@ void do_markov_crack(struct db_main *db, char *mkv_param)
 	gmin_level = mkv_minlevel;
 	gmin_len = mkv_minlen;
 
-	nbparts =
-	    mem_alloc(256 * (mkv_level + 1) * sizeof(long long) * (mkv_maxlen +
-	              1));
-	memset(nbparts, 0,
-	       256 * (mkv_level + 1) * (mkv_maxlen + 1) * sizeof(long long));
-
-	nb_parts(0, 0, 0, mkv_level, mkv_maxlen);
+	if (!load_nbparts(nbparts_filename(path_expand(statfile), mkv_level,
+	                                   mkv_maxlen), mkv_level, mkv_maxlen)) {
+		log_event("- Loaded precomputed Markov tables");
+	} else {
+		nbparts =
+		    mem_alloc(256 * (mkv_level + 1) * sizeof(long long) *
+		              (mkv_maxlen + 1));
+		memset(nbparts, 0,
+		       256 * (mkv_level + 1) * (mkv_maxlen + 1) *
+		       sizeof(long long));
+
+		nb_parts(0, 0, 0, mkv_level, mkv_maxlen);
+	}
 
 	get_markov_start_end(start_token, end_token, nbparts[0], &mkv_start,
 	                     &mkv_end);
@@ -3,8 +3,15 @@
  * Redistribution and use in source and binary forms, with or without modification, are permitted.
  */
 
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
 #include <stdio.h>
 #include <string.h>
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
 
 #include "arch.h"
 #include "misc.h"
@@ -153,6 +160,84 @@ static void stupidsort(unsigned char *result, unsigned char *source,
 	memcpy(result + l + p, more, m);
 }
 
+/*
+ * Precomputed nbparts files start with this, then the level and length
+ * they're for, then the proba1 and proba2 tables they were computed from.
+ */
+#define NBPARTS_MAGIC "MKVNBP01"
+
+char *nbparts_filename(char *statfile, unsigned int max_lvl,
+                       unsigned int max_len)
+{
+	static char name[PATH_BUFFER_SIZE];
+
+	snprintf(name, sizeof(name), "%s.%u-%u.nbp", statfile, max_lvl, max_len);
+
+	return name;
+}
+
+int save_nbparts(char *filename, unsigned int max_lvl, unsigned int max_len)
+{
+	size_t count = 256 * (max_lvl + 1) * (max_len + 1);
+	unsigned int params[2];
+	FILE *file;
+	int failed;
+
+	if (!(file = fopen(filename, "wb")))
+		return -1;
+
+	params[0] = max_lvl;
+	params[1] = max_len;
+	failed =
+	    fwrite(NBPARTS_MAGIC, sizeof(NBPARTS_MAGIC) - 1, 1, file) != 1 ||
+	    fwrite(params, sizeof(params), 1, file) != 1 ||
+	    fwrite(proba1, 256, 1, file) != 1 ||
+	    fwrite(proba2, 256 * 256, 1, file) != 1 ||
+	    fwrite(nbparts, sizeof(*nbparts), count, file) != count;
+	if (fclose(file) || failed) {
+		unlink(filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+int load_nbparts(char *filename, unsigned int max_lvl, unsigned int max_len)
+{
+	size_t count = 256 * (max_lvl + 1) * (max_len + 1);
+	char magic[sizeof(NBPARTS_MAGIC) - 1];
+	unsigned int params[2];
+	unsigned char *tables;
+	FILE *file;
+	int ok;
+
+	if (!(file = fopen(filename, "rb")))
+		return -1;
+
+	tables = mem_alloc(256 + 256 * 256);
+	ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+	    !memcmp(magic, NBPARTS_MAGIC, sizeof(magic)) &&
+	    fread(params, sizeof(params), 1, file) == 1 &&
+	    params[0] == max_lvl && params[1] == max_len &&
+	    fread(tables, 256 + 256 * 256, 1, file) == 1 &&
+	    !memcmp(tables, proba1, 256) &&
+	    !memcmp(tables + 256, proba2, 256 * 256);
+	MEM_FREE(tables);
+
+	if (ok) {
+		nbparts = mem_alloc(count * sizeof(*nbparts));
+		if (fread(nbparts, sizeof(*nbparts), count, file) != count ||
+		    getc(file) != EOF) {
+			MEM_FREE(nbparts);
+			ok = 0;
+		}
+	}
+
+	fclose(file);
+
+	return ok ? 0 : -1;
+}
+
 void init_probatables(char *filename)
 {
 	FILE *fichier;
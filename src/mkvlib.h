@@ -34,4 +34,18 @@ void print_pwd(unsigned long long index, struct s_pwd *pwd,
 unsigned long long nb_parts(unsigned char lettre, unsigned int len,
                             unsigned int level, unsigned int max_lvl, unsigned int max_len);
 void init_probatables(char *filename);
+
+/*
+ * Name of the precomputed nbparts file for a stats file, level and length.
+ */
+char *nbparts_filename(char *statfile, unsigned int max_lvl,
+                       unsigned int max_len);
+
+/*
+ * Saves nbparts, as filled by nb_parts(0, 0, 0, max_lvl, max_len), or loads
+ * it provided the file matches the level, length and probability tables.
+ * Both return zero on success.
+ */
+int save_nbparts(char *filename, unsigned int max_lvl, unsigned int max_len);
+int load_nbparts(char *filename, unsigned int max_lvl, unsigned int max_len);
 #endif
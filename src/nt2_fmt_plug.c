@@ -42,6 +42,7 @@ john_register_one(&fmt_NT2);
 #include "memory.h"
 #include "johnswap.h"
 #include "simd-intrinsics.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"NT"
@@ -176,10 +177,7 @@ static void init(struct fmt_main *self)
 	int i;
 #endif
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	if (options.target_enc == UTF_8) {
 		/* This avoids an if clause for every set_key */
@@ -718,6 +716,9 @@ struct fmt_main fmt_NT2 = {
 		MAX_KEYS_PER_CRYPT,
 #ifdef _OPENMP
 		FMT_OMP | FMT_OMP_BAD |
+#endif
+#ifdef SIMD_COEF_32
+		FMT_SETKEY_MT |
 #endif
 		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE | FMT_UNICODE | FMT_UTF8,
 		{ NULL },
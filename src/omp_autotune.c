@@ -0,0 +1,309 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "timer.h"
+#include "memory.h"
+#include "signals.h"
+#include "formats.h"
+#include "loader.h"
+#include "config.h"
+#include "logger.h"
+#include "john.h"
+#include "omp_autotune.h"
+#include "memdbg.h"
+
+char *omp_autotune_mode;
+
+/*
+ * Formats whose init() called omp_autotune(), each with its keys per crypt
+ * from before the first call (for one thread and a scale of 1), and the scale
+ * being tried or found by omp_autotune_run() (or 0).  Formats may be
+ * initialized in any order and more than once, such as with --test.
+ */
+struct tune_state {
+	struct tune_state *next;
+	struct fmt_main *format;
+	int min_keys, max_keys;
+	int scale;
+};
+
+static struct tune_state *tune_list;
+
+static struct tune_state *tune_find(struct fmt_main *format)
+{
+	struct tune_state *state;
+
+	for (state = tune_list; state; state = state->next)
+		if (state->format == format)
+			return state;
+
+	return NULL;
+}
+
+static int omp_autotune_threads(void)
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+int omp_autotune(struct fmt_main *format, int preset)
+{
+	struct tune_state *state;
+	int threads = omp_autotune_threads();
+	int scale = preset;
+
+	if (!(state = tune_find(format))) {
+		state = mem_calloc_tiny(sizeof(*state), MEM_ALIGN_WORD);
+		state->format = format;
+		state->min_keys = format->params.min_keys_per_crypt;
+		state->max_keys = format->params.max_keys_per_crypt;
+		state->next = tune_list;
+		tune_list = state;
+	}
+
+	if (state->scale)
+		scale = state->scale;
+	else if (omp_autotune_mode && atoi(omp_autotune_mode) > 0)
+		scale = atoi(omp_autotune_mode);
+
+	format->params.min_keys_per_crypt = state->min_keys * threads;
+	format->params.max_keys_per_crypt = state->max_keys * threads * scale;
+
+	return scale;
+}
+
+/*
+ * The cache key, tab separated: host, format, algorithm and thread count.
+ */
+static void omp_autotune_key(char *key, size_t size, struct fmt_main *format,
+	int threads)
+{
+	char host[128] = "localhost";
+
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER && !__MINGW32__
+	if (gethostname(host, sizeof(host)))
+		strcpy(host, "localhost");
+	host[sizeof(host) - 1] = 0;
+#endif
+
+	snprintf(key, size, "%s\t%s\t%s\t%d\t", host, format->params.label,
+	         format->params.algorithm_name, threads);
+}
+
+static int omp_autotune_load(char *key)
+{
+	char line[LINE_BUFFER_SIZE];
+	FILE *file;
+	int scale = 0;
+
+	if (!(file = fopen(path_expand(OMP_AUTOTUNE_NAME), "r")))
+		return 0;
+
+	while (fgets(line, sizeof(line), file))
+		if (!strncmp(line, key, strlen(key)))
+			scale = atoi(line + strlen(key));
+
+	fclose(file);
+
+	return scale > 0 ? scale : 0;
+}
+
+/*
+ * Rewrites the cache with the line for key replaced (or added), via a
+ * temporary file so that concurrent runs never see a partial one.
+ */
+static void omp_autotune_save(char *key, int scale)
+{
+	char line[LINE_BUFFER_SIZE];
+	char *name = path_expand(OMP_AUTOTUNE_NAME);
+	char *tmp_name;
+	FILE *in, *out;
+
+	tmp_name = mem_alloc(strlen(name) + 16);
+	sprintf(tmp_name, "%s.%u", name, (unsigned int)getpid());
+
+	if (!(out = fopen(tmp_name, "w"))) {
+		log_event("! Can't write %s", tmp_name);
+		MEM_FREE(tmp_name);
+		return;
+	}
+
+	if ((in = fopen(name, "r"))) {
+		while (fgets(line, sizeof(line), in))
+			if (strncmp(line, key, strlen(key)))
+				fputs(line, out);
+		fclose(in);
+	}
+	fprintf(out, "%s%d\n", key, scale);
+
+	if (fclose(out) || rename(tmp_name, name)) {
+		log_event("! Can't write %s", name);
+		unlink(tmp_name);
+	}
+
+	MEM_FREE(tmp_name);
+}
+
+/*
+ * Re-initializes the format with scale, and unless measure is 0, measures its
+ * speed for at least OMP_AUTOTUNE_TIME ms.  Returns c/s, and the time per
+ * crypt_all() call in *call_time.
+ */
+static double omp_autotune_set(struct db_main *db, struct tune_state *state,
+	int scale, int measure, double *call_time)
+{
+	struct fmt_main *format = db->format;
+	char key[PLAINTEXT_BUFFER_SIZE];
+	hr_timer start, end;
+	double ticks, elapsed, crypts = 0;
+	int index, calls = 0, count;
+	int tested = format->private.initialized == 2;
+
+	fmt_done(format);
+	state->scale = scale;
+	fmt_init(format);
+	format->methods.reset(db);
+
+/* Only the number of keys changed, so it's not worth testing it again */
+	if (tested)
+		format->private.initialized = 2;
+
+	if (!measure)
+		return 0;
+
+	format->methods.clear_keys();
+	memset(key, 0, sizeof(key));
+	for (index = 0; index < format->params.max_keys_per_crypt; index++) {
+		snprintf(key, sizeof(key), "%u", index * 2654435761U);
+		if (format->params.plaintext_length < sizeof(key))
+			key[format->params.plaintext_length] = 0;
+		format->methods.set_key(key, index);
+	}
+	if (db->salts)
+		format->methods.set_salt(db->salts->salt);
+
+/* Warm up, so that first touching new buffers isn't counted */
+	count = format->params.max_keys_per_crypt;
+	format->methods.crypt_all(&count, db->salts);
+
+	HRGETTICKS_PER_SEC(ticks);
+	HRSETCURRENT(start);
+	do {
+		count = format->params.max_keys_per_crypt;
+		format->methods.crypt_all(&count, db->salts);
+		crypts += count;
+		calls++;
+		HRSETCURRENT(end);
+		elapsed = (HRGETTICKS(end) - HRGETTICKS(start)) / ticks;
+	} while (elapsed < OMP_AUTOTUNE_TIME / 1000.0 && !event_abort);
+
+	if (elapsed <= 0)
+		elapsed = 1e-9;
+	*call_time = elapsed / calls;
+
+	return crypts / elapsed;
+}
+
+void omp_autotune_run(struct db_main *db)
+{
+	struct fmt_main *format = db->format;
+	struct tune_state *state = tune_find(format);
+	char key[LINE_BUFFER_SIZE];
+	double speed, best = 0, call_time;
+	int threads, preset, scale, best_scale, worse = 0, report;
+
+	if (!state || !format->private.initialized || !state->max_keys)
+		return;
+
+	report = omp_autotune_mode && !strcasecmp(omp_autotune_mode, "report");
+
+	if (omp_autotune_mode && !report &&
+	    strcasecmp(omp_autotune_mode, "auto")) {
+		if (atoi(omp_autotune_mode) > 0)
+			return;
+		if (john_main_process)
+			fprintf(stderr, "Invalid --tune=%s (should be auto, "
+			        "report or a scale)\n", omp_autotune_mode);
+		error();
+	}
+
+	if (!omp_autotune_mode &&
+	    !cfg_get_bool(SECTION_OPTIONS, NULL, "CPUAutotune", 1))
+		return;
+
+	threads = omp_autotune_threads();
+	preset = format->params.max_keys_per_crypt / (state->max_keys * threads);
+	omp_autotune_key(key, sizeof(key), format, threads);
+
+	if (!report && (scale = omp_autotune_load(key))) {
+		if (scale != preset)
+			omp_autotune_set(db, state, scale, 0, &call_time);
+		log_event("- OpenMP scale %d (cached), %d keys per crypt",
+		          scale, format->params.max_keys_per_crypt);
+		return;
+	}
+
+	best_scale = preset;
+	for (scale = 1; scale <= preset * OMP_AUTOTUNE_RANGE &&
+	     state->max_keys * threads * scale <= OMP_AUTOTUNE_MAX_KEYS &&
+	     !event_abort; scale <<= 1) {
+		speed = omp_autotune_set(db, state, scale, 1, &call_time);
+
+		if (report && john_main_process)
+			fprintf(stderr, "OpenMP scale %d, %d keys per crypt: "
+			        "%.0f c/s\n", scale,
+			        format->params.max_keys_per_crypt, speed);
+
+/* Prefer the smaller scale unless the larger one is clearly faster */
+		if (speed > best * (1 + OMP_AUTOTUNE_GAIN / 100.0)) {
+			best = speed;
+			best_scale = scale;
+			worse = 0;
+		} else if (++worse >= 2)
+			break;
+
+/* Larger batches would make us too unresponsive */
+		if (call_time * 2 > OMP_AUTOTUNE_MAX_CALL / 1000.0)
+			break;
+	}
+
+	omp_autotune_set(db, state, best_scale, 0, &call_time);
+
+	if (event_abort)
+		return;
+
+	log_event("- OpenMP scale autotuned to %d (preset %d), %d keys per crypt",
+	          best_scale, preset, format->params.max_keys_per_crypt);
+	if (report && john_main_process)
+		fprintf(stderr, "Autotuned OpenMP scale %d (preset %d), "
+		        "%d keys per crypt\n", best_scale, preset,
+		        format->params.max_keys_per_crypt);
+
+	if (john_main_process)
+		omp_autotune_save(key, best_scale);
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Runtime tuning of OpenMP formats' keys per crypt (the OMP_SCALE multiplier)
+ * for the CPU at hand, like OpenCL formats tune their GWS.
+ */
+
+#ifndef _JOHN_OMP_AUTOTUNE_H
+#define _JOHN_OMP_AUTOTUNE_H
+
+#include "formats.h"
+#include "loader.h"
+
+/*
+ * --tune: "auto" (the default) to tune or use the cached result, "report" to
+ * tune even if cached and show the measurements, or a number to use as the
+ * scale.  CPUAutotune = N in john.conf disables tuning unless --tune is used.
+ */
+extern char *omp_autotune_mode;
+
+/*
+ * To be called from an OpenMP format's init() in place of multiplying its
+ * keys per crypt by the thread count and a fixed OMP_SCALE.  Sets min. and
+ * max. keys per crypt for the current thread count and the scale being tried,
+ * or the tuned one once known, or preset (normally the format's OMP_SCALE).
+ * Returns the scale used.
+ */
+extern int omp_autotune(struct fmt_main *format, int preset);
+
+/*
+ * If db's format uses omp_autotune(), finds its best scale by running it with
+ * a few (re-initializing it each time), unless cached for this host, format
+ * and thread count.  Leaves the format initialized with the best scale, and
+ * caches that in OMP_AUTOTUNE_NAME.
+ */
+extern void omp_autotune_run(struct db_main *db);
+
+#endif
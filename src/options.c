@@ -54,6 +54,7 @@
 #include "version.h"
 #include "listconf.h" /* must be included after version.h */
 #include "jumbo.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 struct options_main options;
@@ -174,6 +175,16 @@ static struct opt_entry opt_list[] = {
 	{"test-full", FLG_TEST_SET, FLG_TEST_CHK,
 		0, ~FLG_TEST_SET & ~FLG_FORMAT & ~FLG_SAVEMEM & ~FLG_DYNFMT &
 		OPT_REQ_PARAM & ~FLG_NOLOG, "%d", &benchmark_level},
+	{"bench-repeat", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		"%d", &benchmark_repeat},
+	{"bench-output", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &benchmark_output},
+	{"bench-compare", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &benchmark_compare},
+	{"bench-hashes", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &benchmark_hashes},
+	{"bench-threads", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &benchmark_threads},
 #ifdef HAVE_FUZZ
 	{"fuzz", FLG_FUZZ_SET, FLG_FUZZ_CHK,
 		0, ~FLG_FUZZ_DUMP_SET & ~FLG_FUZZ_SET & ~FLG_FORMAT &
@@ -217,6 +228,9 @@ static struct opt_entry opt_list[] = {
 		Zu, &options.max_wordfile_memory},
 	{"dupe-suppression", FLG_DUPESUPP, FLG_DUPESUPP, 0,
 		FLG_STDIN_CHK | FLG_PIPE_CHK},
+	{"live-loopback", FLG_LIVE_LOOPBACK, FLG_LIVE_LOOPBACK,
+		FLG_WORDLIST_CHK},
+	{"lm-nt", FLG_LM_NT, FLG_LM_NT, FLG_CRACKING_CHK},
 	{"fix-state-delay", FLG_ZERO, 0, FLG_CRACKING_CHK, OPT_REQ_PARAM,
 		"%u", &options.max_fix_state_delay},
 	{"field-separator-char", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
@@ -238,6 +252,8 @@ static struct opt_entry opt_list[] = {
 		"%d", &options.max_run_time},
 	{"progress-every", FLG_ZERO, 0, FLG_CRACKING_CHK, OPT_REQ_PARAM,
 		"%u", &options.status_interval},
+	{"metrics-every", FLG_ZERO, 0, FLG_CRACKING_CHK, OPT_REQ_PARAM,
+		"%u", &options.metrics_interval},
 	{"regen-lost-salts", FLG_ZERO, 0, FLG_CRACKING_CHK, OPT_REQ_PARAM,
 		OPT_FMT_STR_ALLOC, &regen_salts_options},
 	{"bare-always-valid", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
@@ -255,10 +271,15 @@ static struct opt_entry opt_list[] = {
 		OPT_FMT_ADD_LIST_MULTI, &options.acc_devices},
 #endif
 	{"skip-self-tests", FLG_NOTESTS, FLG_NOTESTS},
+#ifdef _OPENMP
+	{"tune", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &omp_autotune_mode},
+#endif
 	{"costs", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
                 OPT_FMT_STR_ALLOC, &costs_str},
 
 	{"keep-guessing", FLG_KEEP_GUESSING, FLG_KEEP_GUESSING},
+	{"profile", FLG_PROFILE, FLG_PROFILE, FLG_CRACKING_CHK},
 	{"stress-test", FLG_LOOPTEST | FLG_TEST_SET, FLG_TEST_CHK,
 		0, ~FLG_TEST_SET & ~FLG_FORMAT & ~FLG_SAVEMEM & ~FLG_DYNFMT &
 		~OPT_REQ_PARAM & ~FLG_NOLOG, "%d", &benchmark_time},
@@ -308,6 +329,9 @@ static struct opt_entry opt_list[] = {
 "                  --pipe   like --stdin, but bulk reads, and allows rules\n" \
 "--loopback[=FILE]          like --wordlist, but extract words from a .pot file\n" \
 "--dupe-suppression         suppress all dupes in wordlist (and force preload)\n" \
+"--live-loopback            also try words cracked during the session, right away\n" \
+"--lm-nt                    with LM hashes in PWDUMP files, crack the NT hashes\n" \
+"                           from the cracked LM passwords, right away\n" \
 PRINCE_USAGE \
 "--encoding=NAME            input encoding (eg. UTF-8, ISO-8859-1). See also\n" \
 "                           doc/ENCODING and --list=hidden-options.\n" \
@@ -395,6 +419,8 @@ void opt_print_hidden_usage(void)
 	puts("--bare-always-valid=C      if C is 'Y' or 'y', then the dynamic format will");
 	puts("                           always treat bare hashes as valid");
 	puts("--progress-every=N         emit a status line every N seconds");
+	puts("--metrics-every=N          update a JSON metrics file every N seconds");
+	puts("--profile                  show time spent generating, hashing, comparing");
 	puts("--crack-status             emit a status line whenever a password is cracked");
 	puts("--keep-guessing            try more candidates for cracked hashes (ie. search");
 	puts("                           for plaintext collisions)");
@@ -413,8 +439,16 @@ void opt_print_hidden_usage(void)
 	puts("--show=invalid             show any lines from input that are not valid for");
 	puts("                           selected format(s)");
 	puts("--skip-self-tests          skip self tests");
+#ifdef _OPENMP
+	puts("--tune=HOW                 tune OpenMP keys per crypt: auto, report or N");
+#endif
 	puts("--test-full[=LEVEL]        run more thorough self-tests");
 	puts("--stress-test[=TIME]       loop self tests forever");
+	puts("--bench-repeat=N           benchmark N times, report median and stddev");
+	puts("--bench-output=FILE        write benchmark results to FILE as JSON lines");
+	puts("--bench-compare=OLD [NEW]  compare --test (or NEW) results with OLD ones");
+	puts("--bench-hashes=N[,N..]     benchmark lookups in N generated hashes");
+	puts("--bench-threads=N[,N..]    ...and/or with N threads (OpenMP formats)");
 #ifdef HAVE_FUZZ
 	puts("--fuzz[=DICTFILE]          fuzz formats' prepare(), valid() and split()");
 	puts("--fuzz-dump[=FROM,TO]      dump the fuzzed hashes between FROM and TO to file pwfile.format");
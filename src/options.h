@@ -185,6 +185,12 @@
 #define FLG_PRINCE_MMAP			0x0100000000000000ULL
 #define FLG_RULES_ALLOW			0x0200000000000000ULL
 #define FLG_REGEX_STACKED		0x0400000000000000ULL
+/* Account time to the phases of cracking and print a profile */
+#define FLG_PROFILE			0x0800000000000000ULL
+/* Try words cracked during a wordlist session with its rules right away */
+#define FLG_LIVE_LOOPBACK		0x1000000000000000ULL
+/* Try case variants of cracked LM passwords against PWDUMP NT hashes */
+#define FLG_LM_NT			0x2000000000000000ULL
 
 /*
  * Structure with option flags and all the parameters.
@@ -349,6 +355,9 @@ struct options_main {
 /* Emit a status line every N seconds */
 	int status_interval;
 
+/* Update the session's metrics file every N seconds */
+	int metrics_interval;
+
 /* Resync pot file when saving */
 	int reload_at_save;
 
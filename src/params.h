@@ -146,6 +146,32 @@
  */
 #define BENCHMARK_MANY			0x100
 
+/*
+ * Default for BenchRegressionThreshold: how much slower, in percent, a
+ * benchmark may get before --bench-compare reports it as a regression.
+ */
+#define BENCHMARK_REGRESSION		5
+
+/*
+ * Loaded hash counts to benchmark with --bench-threads alone, and how many
+ * hash or thread counts --bench-hashes and --bench-threads may list.
+ */
+#define BENCHMARK_HASHES		"1,100,10K,1M"
+#define BENCHMARK_SCALING_MAX		16
+
+/*
+ * CPU autotuning of OpenMP formats' keys per crypt: the cache file, how long
+ * to measure each scale (ms), how much faster (%) a larger scale needs to be
+ * to be preferred, up to how many times the preset scale to try, and limits
+ * on the keys and the time (ms) per crypt_all() call.
+ */
+#define OMP_AUTOTUNE_NAME		"$JOHN/john.autotune"
+#define OMP_AUTOTUNE_TIME		50
+#define OMP_AUTOTUNE_GAIN		1
+#define OMP_AUTOTUNE_RANGE		4
+#define OMP_AUTOTUNE_MAX_KEYS		0x100000
+#define OMP_AUTOTUNE_MAX_CALL		250
+
 /*
  * File names.
  */
@@ -172,8 +198,15 @@
 #endif
 #define LOG_SUFFIX			".log"
 #define RECOVERY_SUFFIX			".rec"
+#define METRICS_JSON_SUFFIX		".json"
+#define METRICS_PROM_SUFFIX		".prom"
 #define WORDLIST_NAME			"$JOHN/password.lst"
 
+/*
+ * Max. number of salts whose remaining hash counts go to the metrics file.
+ */
+#define METRICS_MAX_SALTS		1000
+
 /*
  * Configuration file section names.
  */
@@ -297,6 +330,12 @@ extern unsigned int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #endif
 #define UNIQUE_HASH_SIZE		(1 << UNIQUE_HASH_LOG)
 
+/*
+ * Default memory (in MB) for suppressing duplicate candidates produced by
+ * wordlist rules, with --dupe-suppression.
+ */
+#define DUPE_SUPPRESSION_MEMORY		256
+
 /*
  * Maximum number of GECOS words per password to load.
  */
@@ -319,11 +358,23 @@ extern unsigned int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #define CRK_PREFETCH			0
 #endif
 
+/*
+ * With --profile (or --metrics-every), time one set_key() call out of this
+ * many.  Timing each call would cost about as much as the call itself.
+ */
+#define CRK_SET_KEY_SAMPLE		64
+
 /*
  * Maximum number of GECOS words to try in pairs.
  */
 #define SINGLE_WORDS_PAIR_MAX		6
 
+/*
+ * Maximum total size of "single crack" mode key buffers, in GB.  If buffers
+ * for all salts don't fit, salts are processed in windows.
+ */
+#define SINGLE_MAX_WORD_BUFFER		4
+
 /*
  * Charset parameters.
  *
@@ -31,6 +31,7 @@ john_register_one(&fmt_pbkdf2_hmac_md4);
 #define OMP_SCALE               256
 #endif
 #endif
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL            "PBKDF2-HMAC-MD4"
@@ -62,10 +63,7 @@ static uint32_t (*crypt_out)[PBKDF2_MDx_BINARY_SIZE / sizeof(uint32_t)];
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_key = mem_calloc(self->params.max_keys_per_crypt, sizeof(*saved_key));
 	crypt_out = mem_calloc(self->params.max_keys_per_crypt, sizeof(*crypt_out));
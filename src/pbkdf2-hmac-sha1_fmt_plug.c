@@ -22,7 +22,8 @@ john_register_one(&fmt_pbkdf2_hmac_sha1);
 #include "formats.h"
 #include "johnswap.h"
 #include "base64_convert.h"
-#include "pbkdf2_hmac_sha1.h"
+#include "simd-intrinsics.h"
+#include "pbkdf2_hmac_engine.h"
 #include "pbkdf2_hmac_common.h"
 
 #ifdef _OPENMP
@@ -31,6 +32,7 @@ john_register_one(&fmt_pbkdf2_hmac_sha1);
 #define OMP_SCALE               64
 #endif
 #endif
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL            "PBKDF2-HMAC-SHA1"
@@ -66,23 +68,23 @@ static struct custom_salt {
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static uint32_t (*crypt_out)[PBKDF2_SHA1_BINARY_SIZE / sizeof(uint32_t)];
+static pbkdf2_job *jobs;
 
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_key = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*saved_key));
 	crypt_out = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*crypt_out));
+	jobs = mem_calloc(self->params.max_keys_per_crypt, sizeof(*jobs));
 }
 
 static void done(void)
 {
+	MEM_FREE(jobs);
 	MEM_FREE(crypt_out);
 	MEM_FREE(saved_key);
 }
@@ -128,39 +130,20 @@ static int get_hash_6(int index) { return crypt_out[index][0] & PH_MASK_6; }
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
-	int index = 0;
+	int index;
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-#if defined(_OPENMP) || MAX_KEYS_PER_CRYPT > 1
-#endif
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
-	{
-#ifdef SSE_GROUP_SZ_SHA1
-		int lens[SSE_GROUP_SZ_SHA1], i;
-		unsigned char *pin[SSE_GROUP_SZ_SHA1];
-		union {
-			uint32_t *pout[SSE_GROUP_SZ_SHA1];
-			unsigned char *poutc;
-		} x;
-		for (i = 0; i < SSE_GROUP_SZ_SHA1; ++i) {
-			lens[i] = strlen(saved_key[index+i]);
-			pin[i] = (unsigned char*)saved_key[index+i];
-			x.pout[i] = crypt_out[index+i];
-		}
-		pbkdf2_sha1_sse((const unsigned char **)pin, lens,
-		                cur_salt->salt, cur_salt->length,
-		                cur_salt->rounds, &(x.poutc),
-		                PBKDF2_SHA1_BINARY_SIZE, 0);
-#else
-		pbkdf2_sha1((const unsigned char*)(saved_key[index]),
-		            strlen(saved_key[index]),
-		            cur_salt->salt, cur_salt->length,
-		            cur_salt->rounds, (unsigned char*)crypt_out[index],
-		            PBKDF2_SHA1_BINARY_SIZE, 0);
-#endif
+	for (index = 0; index < count; index++) {
+		jobs[index].key = (unsigned char*)saved_key[index];
+		jobs[index].keylen = strlen(saved_key[index]);
+		jobs[index].salt = cur_salt->salt;
+		jobs[index].saltlen = cur_salt->length;
+		jobs[index].iterations = cur_salt->rounds;
+		jobs[index].out = (unsigned char*)crypt_out[index];
+		jobs[index].outlen = PBKDF2_SHA1_BINARY_SIZE;
+		jobs[index].skip_bytes = 0;
 	}
+	pbkdf2_sha1_jobs(jobs, count);
+
 	return count;
 }
 
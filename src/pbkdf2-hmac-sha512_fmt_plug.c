@@ -32,7 +32,8 @@ john_register_one(&fmt_pbkdf2_hmac_sha512);
 #include "sha2.h"
 #include "johnswap.h"
 #include "pbkdf2_hmac_common.h"
-#include "pbkdf2_hmac_sha512.h"
+#include "simd-intrinsics.h"
+#include "pbkdf2_hmac_engine.h"
 
 #define FORMAT_LABEL            "PBKDF2-HMAC-SHA512"
 #undef FORMAT_NAME
@@ -77,6 +78,7 @@ static struct custom_salt {
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static uint32_t (*crypt_out)[PBKDF2_SHA512_BINARY_SIZE / sizeof(uint32_t)];
+static pbkdf2_job *jobs;
 
 static void init(struct fmt_main *self)
 {
@@ -88,10 +90,12 @@ static void init(struct fmt_main *self)
 #endif
 	saved_key = mem_calloc(sizeof(*saved_key), self->params.max_keys_per_crypt);
 	crypt_out = mem_calloc(sizeof(*crypt_out), self->params.max_keys_per_crypt);
+	jobs = mem_calloc(sizeof(*jobs), self->params.max_keys_per_crypt);
 }
 
 static void done(void)
 {
+	MEM_FREE(jobs);
 	MEM_FREE(crypt_out);
 	MEM_FREE(saved_key);
 }
@@ -137,32 +141,20 @@ static int get_hash_6(int index) { return crypt_out[index][0] & PH_MASK_6; }
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
-	int index = 0;
+	int index;
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
-	{
-#ifdef SSE_GROUP_SZ_SHA512
-		int lens[SSE_GROUP_SZ_SHA512], i;
-		unsigned char *pin[SSE_GROUP_SZ_SHA512];
-		union {
-			uint32_t *pout[SSE_GROUP_SZ_SHA512];
-			unsigned char *poutc;
-		} x;
-		for (i = 0; i < SSE_GROUP_SZ_SHA512; ++i) {
-			lens[i] = strlen(saved_key[index+i]);
-			pin[i] = (unsigned char*)saved_key[index+i];
-			x.pout[i] = crypt_out[index+i];
-		}
-		pbkdf2_sha512_sse((const unsigned char **)pin, lens, cur_salt->salt, cur_salt->length, cur_salt->rounds, &(x.poutc), PBKDF2_SHA512_BINARY_SIZE, 0);
-#else
-		pbkdf2_sha512((const unsigned char*)(saved_key[index]), strlen(saved_key[index]),
-			cur_salt->salt, cur_salt->length,
-			cur_salt->rounds, (unsigned char*)crypt_out[index], PBKDF2_SHA512_BINARY_SIZE, 0);
-#endif
+	for (index = 0; index < count; index++) {
+		jobs[index].key = (unsigned char*)saved_key[index];
+		jobs[index].keylen = strlen(saved_key[index]);
+		jobs[index].salt = cur_salt->salt;
+		jobs[index].saltlen = cur_salt->length;
+		jobs[index].iterations = cur_salt->rounds;
+		jobs[index].out = (unsigned char*)crypt_out[index];
+		jobs[index].outlen = PBKDF2_SHA512_BINARY_SIZE;
+		jobs[index].skip_bytes = 0;
 	}
+	pbkdf2_sha512_jobs(jobs, count);
+
 	return count;
 }
 
@@ -0,0 +1,53 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Multi-buffer PBKDF2-HMAC, shared by the PBKDF2 based formats.
+ *
+ * A format fills in one job per derivation and submits them all at once.
+ * Each job is split into its output blocks (one per digest of derived key),
+ * and those are packed into the SIMD lanes across jobs, grouped by iteration
+ * count, so vectors stay full even when outlen spans several digests or jobs
+ * have different salts.  The vectors are spread over the OpenMP threads, so
+ * the caller should not itself be running in parallel.
+ *
+ * Without SIMD, the jobs are simply run one after another (still threaded).
+ */
+
+#ifndef _JOHN_PBKDF2_HMAC_ENGINE_H
+#define _JOHN_PBKDF2_HMAC_ENGINE_H
+
+#include "arch.h"
+
+/* Lanes per vector, a natural multiple for keys per crypt */
+#ifdef SIMD_COEF_32
+#define SSE_GROUP_SZ_SHA1		(SIMD_COEF_32*SIMD_PARA_SHA1)
+#define SSE_GROUP_SZ_SHA256		(SIMD_COEF_32*SIMD_PARA_SHA256)
+#endif
+#ifdef SIMD_COEF_64
+#define SSE_GROUP_SZ_SHA512		(SIMD_COEF_64*SIMD_PARA_SHA512)
+#endif
+
+typedef struct {
+	const unsigned char *key;
+	int keylen;
+	const unsigned char *salt;
+	int saltlen;
+	int iterations;
+	unsigned char *out;
+	int outlen;
+/* Bytes of derived key to skip before out[0], as for pbkdf2_sha1() etc. */
+	int skip_bytes;
+} pbkdf2_job;
+
+extern void pbkdf2_sha1_jobs(pbkdf2_job *jobs, int count);
+extern void pbkdf2_sha256_jobs(pbkdf2_job *jobs, int count);
+extern void pbkdf2_sha512_jobs(pbkdf2_job *jobs, int count);
+
+#endif
@@ -0,0 +1,469 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ *
+ * Multi-buffer PBKDF2-HMAC-SHA1/SHA256/SHA512, see pbkdf2_hmac_engine.h.
+ * The SIMD inner loop is the one of pbkdf2_sha*_sse(), but with each lane
+ * having its own key, salt and output block, and with the running xor kept
+ * in vectors.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "memory.h"
+#include "sha.h"
+#include "sha2.h"
+#include "simd-intrinsics.h"
+/* Only the scalar functions of these, we do the SIMD part ourselves */
+#define PBKDF2_HMAC_SCALAR_ONLY
+#define PBKDF2_HMAC_SHA1_ALSO_INCLUDE_CTX 1
+#include "pbkdf2_hmac_sha1.h"
+#define PBKDF2_HMAC_SHA256_ALSO_INCLUDE_CTX 1
+#include "pbkdf2_hmac_sha256.h"
+#define PBKDF2_HMAC_SHA512_ALSO_INCLUDE_CTX 1
+#include "pbkdf2_hmac_sha512.h"
+#undef PBKDF2_HMAC_SCALAR_ONLY
+#include "pbkdf2_hmac_engine.h"
+#include "memdbg.h"
+
+#if defined(SIMD_COEF_32) || defined(SIMD_COEF_64)
+
+/*
+ * One output block (1-based) of one job, as run in a SIMD lane.
+ */
+typedef struct {
+	pbkdf2_job *job;
+	int block;
+} pbkdf2_lane;
+
+/*
+ * Up to a vector of lanes, all with the same iteration count.
+ */
+typedef struct {
+	int start, count;
+} pbkdf2_group;
+
+static int pbkdf2_lane_cmp(const void *a, const void *b)
+{
+	const pbkdf2_lane *x = a, *y = b;
+
+	if (x->job->iterations != y->job->iterations)
+		return x->job->iterations < y->job->iterations ? -1 : 1;
+	if (x->job != y->job)
+		return x->job < y->job ? -1 : 1;
+	return x->block - y->block;
+}
+
+/*
+ * Splits the jobs into lanes, one per output block of digest_len bytes,
+ * ordered by iteration count, and those into groups of up to group_size.
+ * Returns the number of groups.
+ */
+static int pbkdf2_plan(pbkdf2_job *jobs, int count, int digest_len,
+	int group_size, pbkdf2_lane **lanes, pbkdf2_group **groups)
+{
+	int i, j, n = 0, ngroups = 0, sorted = 1;
+
+	*lanes = NULL;
+	*groups = NULL;
+
+	for (i = 0; i < count; i++)
+		n += (jobs[i].skip_bytes + jobs[i].outlen + digest_len - 1) /
+			digest_len - jobs[i].skip_bytes / digest_len;
+	if (n <= 0)
+		return 0;
+
+	*lanes = mem_alloc(n * sizeof(**lanes));
+	*groups = mem_alloc(n * sizeof(**groups));
+
+	n = 0;
+	for (i = 0; i < count; i++) {
+		int last = (jobs[i].skip_bytes + jobs[i].outlen + digest_len - 1) /
+			digest_len;
+
+		if (i && jobs[i].iterations < jobs[i - 1].iterations)
+			sorted = 0;
+		for (j = jobs[i].skip_bytes / digest_len + 1; j <= last; j++) {
+			(*lanes)[n].job = &jobs[i];
+			(*lanes)[n++].block = j;
+		}
+	}
+	if (!sorted)
+		qsort(*lanes, n, sizeof(**lanes), pbkdf2_lane_cmp);
+
+	for (i = 0; i < n; i += j) {
+		for (j = 1; j < group_size && i + j < n &&
+		     (*lanes)[i + j].job->iterations ==
+		     (*lanes)[i].job->iterations; j++);
+		(*groups)[ngroups].start = i;
+		(*groups)[ngroups++].count = j;
+	}
+
+	return ngroups;
+}
+
+/*
+ * Stores the part of a lane's output block (BE bytes) that its job wants.
+ */
+static void pbkdf2_put(pbkdf2_lane *lane, const unsigned char *dk,
+	int digest_len)
+{
+	pbkdf2_job *job = lane->job;
+	int i, pos = (lane->block - 1) * digest_len;
+
+	for (i = 0; i < digest_len; i++, pos++)
+		if (pos >= job->skip_bytes && pos < job->skip_bytes + job->outlen)
+			job->out[pos - job->skip_bytes] = dk[i];
+}
+
+/*
+ * The block number, BE, as appended to the salt for the first HMAC.
+ */
+static void pbkdf2_block_be(unsigned char *be, int block)
+{
+	be[0] = block >> 24;
+	be[1] = block >> 16;
+	be[2] = block >> 8;
+	be[3] = block;
+}
+
+#endif /* SIMD_COEF_32 || SIMD_COEF_64 */
+
+#ifdef SIMD_COEF_32
+#define LANE_32(buf, words, j) \
+	(&(buf)[(j) / SIMD_COEF_32 * SIMD_COEF_32 * (words) + ((j) & (SIMD_COEF_32 - 1))])
+
+static void pbkdf2_sha1_group(pbkdf2_lane *lanes, int count)
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t o1[SHA_BUF_SIZ * SSE_GROUP_SZ_SHA1];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t i1[5 * SSE_GROUP_SZ_SHA1];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t i2[5 * SSE_GROUP_SZ_SHA1];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t dgst[5 * SSE_GROUP_SZ_SHA1];
+	vtype *o = (vtype*)o1, *d = (vtype*)dgst;
+	unsigned char hash[SHA_DIGEST_LENGTH], be[4];
+	SHA_CTX ipad, opad, ctx;
+	int i, j, k, R = lanes[0].job->iterations;
+
+	/* A whole vector for one lane is slower than the scalar code */
+	if (count == 1) {
+		pbkdf2_sha1(lanes->job->key, lanes->job->keylen,
+		            lanes->job->salt, lanes->job->saltlen, R, hash,
+		            SHA_DIGEST_LENGTH, (lanes->block - 1) * SHA_DIGEST_LENGTH);
+		pbkdf2_put(lanes, hash, SHA_DIGEST_LENGTH);
+		return;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_SHA1; j++) {
+		/* Lanes past count just repeat the first one */
+		pbkdf2_lane *lane = &lanes[j < count ? j : 0];
+		pbkdf2_job *job = lane->job;
+		uint32_t *p = LANE_32(o1, SHA_BUF_SIZ, j);
+		uint32_t *pd = LANE_32(dgst, 5, j);
+		uint32_t *pi = LANE_32(i1, 5, j), *po = LANE_32(i2, 5, j);
+
+		_pbkdf2_sha1_load_hmac(job->key, job->keylen, &ipad, &opad);
+		pi[0] = ipad.h0; po[0] = opad.h0;
+		pi[SIMD_COEF_32] = ipad.h1; po[SIMD_COEF_32] = opad.h1;
+		pi[SIMD_COEF_32*2] = ipad.h2; po[SIMD_COEF_32*2] = opad.h2;
+		pi[SIMD_COEF_32*3] = ipad.h3; po[SIMD_COEF_32*3] = opad.h3;
+		pi[SIMD_COEF_32*4] = ipad.h4; po[SIMD_COEF_32*4] = opad.h4;
+
+		pbkdf2_block_be(be, lane->block);
+		memcpy(&ctx, &ipad, sizeof(ctx));
+		SHA1_Update(&ctx, job->salt, job->saltlen);
+		SHA1_Update(&ctx, be, 4);
+		SHA1_Final(hash, &ctx);
+		memcpy(&ctx, &opad, sizeof(ctx));
+		SHA1_Update(&ctx, hash, SHA_DIGEST_LENGTH);
+		SHA1_Final(hash, &ctx);
+
+		/* U1 in BE words, then padding for a 64+20 byte message */
+		for (i = 0; i < 5; i++)
+			p[i * SIMD_COEF_32] = pd[i * SIMD_COEF_32] =
+				(uint32_t)hash[4*i] << 24 | hash[4*i+1] << 16 |
+				hash[4*i+2] << 8 | hash[4*i+3];
+		p[5 * SIMD_COEF_32] = 0x80000000;
+		for (i = 6; i < 15; i++)
+			p[i * SIMD_COEF_32] = 0;
+		p[15 * SIMD_COEF_32] = (64 + SHA_DIGEST_LENGTH) << 3;
+	}
+
+	for (i = 1; i < R; i++) {
+		SIMDSHA1body(o1, o1, i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		SIMDSHA1body(o1, o1, i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		for (k = 0; k < SIMD_PARA_SHA1; k++)
+			for (j = 0; j < 5; j++)
+				vstore(&d[k * 5 + j], vxor(vload(&d[k * 5 + j]),
+				       vload(&o[k * SHA_BUF_SIZ + j])));
+	}
+
+	for (j = 0; j < count; j++) {
+		uint32_t *pd = LANE_32(dgst, 5, j);
+
+		for (i = 0; i < SHA_DIGEST_LENGTH; i++)
+			hash[i] = pd[(i >> 2) * SIMD_COEF_32] >> (24 - 8 * (i & 3));
+		pbkdf2_put(&lanes[j], hash, SHA_DIGEST_LENGTH);
+	}
+}
+
+static void pbkdf2_sha256_group(pbkdf2_lane *lanes, int count)
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t o1[SHA_BUF_SIZ * SSE_GROUP_SZ_SHA256];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t i1[8 * SSE_GROUP_SZ_SHA256];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t i2[8 * SSE_GROUP_SZ_SHA256];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint32_t dgst[8 * SSE_GROUP_SZ_SHA256];
+	vtype *o = (vtype*)o1, *d = (vtype*)dgst;
+	unsigned char hash[SHA256_DIGEST_LENGTH], be[4];
+	SHA256_CTX ipad, opad, ctx;
+	int i, j, k, R = lanes[0].job->iterations;
+
+	/* A whole vector for one lane is slower than the scalar code */
+	if (count == 1) {
+		pbkdf2_sha256(lanes->job->key, lanes->job->keylen,
+		              (unsigned char*)lanes->job->salt, lanes->job->saltlen, R, hash,
+		              SHA256_DIGEST_LENGTH, (lanes->block - 1) * SHA256_DIGEST_LENGTH);
+		pbkdf2_put(lanes, hash, SHA256_DIGEST_LENGTH);
+		return;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_SHA256; j++) {
+		/* Lanes past count just repeat the first one */
+		pbkdf2_lane *lane = &lanes[j < count ? j : 0];
+		pbkdf2_job *job = lane->job;
+		uint32_t *p = LANE_32(o1, SHA_BUF_SIZ, j);
+		uint32_t *pd = LANE_32(dgst, 8, j);
+		uint32_t *pi = LANE_32(i1, 8, j), *po = LANE_32(i2, 8, j);
+
+		_pbkdf2_sha256_load_hmac(job->key, job->keylen, &ipad, &opad);
+		for (i = 0; i < 8; i++) {
+#if COMMON_DIGEST_FOR_OPENSSL
+			pi[i * SIMD_COEF_32] = ipad.hash[i];
+			po[i * SIMD_COEF_32] = opad.hash[i];
+#else
+			pi[i * SIMD_COEF_32] = ipad.h[i];
+			po[i * SIMD_COEF_32] = opad.h[i];
+#endif
+		}
+
+		pbkdf2_block_be(be, lane->block);
+		memcpy(&ctx, &ipad, sizeof(ctx));
+		SHA256_Update(&ctx, job->salt, job->saltlen);
+		SHA256_Update(&ctx, be, 4);
+		SHA256_Final(hash, &ctx);
+		memcpy(&ctx, &opad, sizeof(ctx));
+		SHA256_Update(&ctx, hash, SHA256_DIGEST_LENGTH);
+		SHA256_Final(hash, &ctx);
+
+		/* U1 in BE words, then padding for a 64+32 byte message */
+		for (i = 0; i < 8; i++)
+			p[i * SIMD_COEF_32] = pd[i * SIMD_COEF_32] =
+				(uint32_t)hash[4*i] << 24 | hash[4*i+1] << 16 |
+				hash[4*i+2] << 8 | hash[4*i+3];
+		p[8 * SIMD_COEF_32] = 0x80000000;
+		for (i = 9; i < 15; i++)
+			p[i * SIMD_COEF_32] = 0;
+		p[15 * SIMD_COEF_32] = (64 + SHA256_DIGEST_LENGTH) << 3;
+	}
+
+	for (i = 1; i < R; i++) {
+		SIMDSHA256body(o1, o1, i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		SIMDSHA256body(o1, o1, i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		for (k = 0; k < SIMD_PARA_SHA256; k++)
+			for (j = 0; j < 8; j++)
+				vstore(&d[k * 8 + j], vxor(vload(&d[k * 8 + j]),
+				       vload(&o[k * SHA_BUF_SIZ + j])));
+	}
+
+	for (j = 0; j < count; j++) {
+		uint32_t *pd = LANE_32(dgst, 8, j);
+
+		for (i = 0; i < SHA256_DIGEST_LENGTH; i++)
+			hash[i] = pd[(i >> 2) * SIMD_COEF_32] >> (24 - 8 * (i & 3));
+		pbkdf2_put(&lanes[j], hash, SHA256_DIGEST_LENGTH);
+	}
+}
+#undef LANE_32
+#endif /* SIMD_COEF_32 */
+
+#ifdef SIMD_COEF_64
+#define LANE_64(buf, words, j) \
+	(&(buf)[(j) / SIMD_COEF_64 * SIMD_COEF_64 * (words) + ((j) & (SIMD_COEF_64 - 1))])
+
+static void pbkdf2_sha512_group(pbkdf2_lane *lanes, int count)
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint64_t o1[SHA_BUF_SIZ * SSE_GROUP_SZ_SHA512];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint64_t i1[8 * SSE_GROUP_SZ_SHA512];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint64_t i2[8 * SSE_GROUP_SZ_SHA512];
+	JTR_ALIGN(MEM_ALIGN_SIMD) uint64_t dgst[8 * SSE_GROUP_SZ_SHA512];
+	vtype *o = (vtype*)o1, *d = (vtype*)dgst;
+	unsigned char hash[SHA512_DIGEST_LENGTH], be[4];
+	SHA512_CTX ipad, opad, ctx;
+	int i, j, k, R = lanes[0].job->iterations;
+
+	/* A whole vector for one lane is slower than the scalar code */
+	if (count == 1) {
+		pbkdf2_sha512(lanes->job->key, lanes->job->keylen,
+		              (unsigned char*)lanes->job->salt, lanes->job->saltlen, R, hash,
+		              SHA512_DIGEST_LENGTH, (lanes->block - 1) * SHA512_DIGEST_LENGTH);
+		pbkdf2_put(lanes, hash, SHA512_DIGEST_LENGTH);
+		return;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_SHA512; j++) {
+		/* Lanes past count just repeat the first one */
+		pbkdf2_lane *lane = &lanes[j < count ? j : 0];
+		pbkdf2_job *job = lane->job;
+		uint64_t *p = LANE_64(o1, SHA_BUF_SIZ, j);
+		uint64_t *pd = LANE_64(dgst, 8, j);
+		uint64_t *pi = LANE_64(i1, 8, j), *po = LANE_64(i2, 8, j);
+
+		_pbkdf2_sha512_load_hmac(job->key, job->keylen, &ipad, &opad);
+		for (i = 0; i < 8; i++) {
+#if COMMON_DIGEST_FOR_OPENSSL
+			pi[i * SIMD_COEF_64] = ipad.hash[i];
+			po[i * SIMD_COEF_64] = opad.hash[i];
+#else
+			pi[i * SIMD_COEF_64] = ipad.h[i];
+			po[i * SIMD_COEF_64] = opad.h[i];
+#endif
+		}
+
+		pbkdf2_block_be(be, lane->block);
+		memcpy(&ctx, &ipad, sizeof(ctx));
+		SHA512_Update(&ctx, job->salt, job->saltlen);
+		SHA512_Update(&ctx, be, 4);
+		SHA512_Final(hash, &ctx);
+		memcpy(&ctx, &opad, sizeof(ctx));
+		SHA512_Update(&ctx, hash, SHA512_DIGEST_LENGTH);
+		SHA512_Final(hash, &ctx);
+
+		/* U1 in BE words, then padding for a 128+64 byte message */
+		for (i = 0; i < 8; i++) {
+			uint64_t w = 0;
+
+			for (k = 0; k < 8; k++)
+				w = w << 8 | hash[8*i + k];
+			p[i * SIMD_COEF_64] = pd[i * SIMD_COEF_64] = w;
+		}
+		p[8 * SIMD_COEF_64] = 0x8000000000000000ULL;
+		for (i = 9; i < 15; i++)
+			p[i * SIMD_COEF_64] = 0;
+		p[15 * SIMD_COEF_64] = (128 + SHA512_DIGEST_LENGTH) << 3;
+	}
+
+	for (i = 1; i < R; i++) {
+		SIMDSHA512body(o1, o1, i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		SIMDSHA512body(o1, o1, i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+		for (k = 0; k < SIMD_PARA_SHA512; k++)
+			for (j = 0; j < 8; j++)
+				vstore(&d[k * 8 + j], vxor(vload(&d[k * 8 + j]),
+				       vload(&o[k * SHA_BUF_SIZ + j])));
+	}
+
+	for (j = 0; j < count; j++) {
+		uint64_t *pd = LANE_64(dgst, 8, j);
+
+		for (i = 0; i < SHA512_DIGEST_LENGTH; i++)
+			hash[i] = pd[(i >> 3) * SIMD_COEF_64] >> (56 - 8 * (i & 7));
+		pbkdf2_put(&lanes[j], hash, SHA512_DIGEST_LENGTH);
+	}
+}
+#undef LANE_64
+#endif /* SIMD_COEF_64 */
+
+void pbkdf2_sha1_jobs(pbkdf2_job *jobs, int count)
+{
+	int i;
+#ifdef SIMD_COEF_32
+	pbkdf2_lane *lanes;
+	pbkdf2_group *groups;
+	int ngroups = pbkdf2_plan(jobs, count, SHA_DIGEST_LENGTH,
+	                          SSE_GROUP_SZ_SHA1, &lanes, &groups);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < ngroups; i++)
+		pbkdf2_sha1_group(&lanes[groups[i].start], groups[i].count);
+
+	MEM_FREE(groups);
+	MEM_FREE(lanes);
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < count; i++)
+		pbkdf2_sha1(jobs[i].key, jobs[i].keylen,
+		            jobs[i].salt, jobs[i].saltlen, jobs[i].iterations,
+		            jobs[i].out, jobs[i].outlen, jobs[i].skip_bytes);
+#endif
+}
+
+void pbkdf2_sha256_jobs(pbkdf2_job *jobs, int count)
+{
+	int i;
+#ifdef SIMD_COEF_32
+	pbkdf2_lane *lanes;
+	pbkdf2_group *groups;
+	int ngroups = pbkdf2_plan(jobs, count, SHA256_DIGEST_LENGTH,
+	                          SSE_GROUP_SZ_SHA256, &lanes, &groups);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < ngroups; i++)
+		pbkdf2_sha256_group(&lanes[groups[i].start], groups[i].count);
+
+	MEM_FREE(groups);
+	MEM_FREE(lanes);
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < count; i++)
+		pbkdf2_sha256(jobs[i].key, jobs[i].keylen,
+		              (unsigned char*)jobs[i].salt, jobs[i].saltlen,
+		              jobs[i].iterations,
+		              jobs[i].out, jobs[i].outlen, jobs[i].skip_bytes);
+#endif
+}
+
+void pbkdf2_sha512_jobs(pbkdf2_job *jobs, int count)
+{
+	int i;
+#ifdef SIMD_COEF_64
+	pbkdf2_lane *lanes;
+	pbkdf2_group *groups;
+	int ngroups = pbkdf2_plan(jobs, count, SHA512_DIGEST_LENGTH,
+	                          SSE_GROUP_SZ_SHA512, &lanes, &groups);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < ngroups; i++)
+		pbkdf2_sha512_group(&lanes[groups[i].start], groups[i].count);
+
+	MEM_FREE(groups);
+	MEM_FREE(lanes);
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < count; i++)
+		pbkdf2_sha512(jobs[i].key, jobs[i].keylen,
+		              (unsigned char*)jobs[i].salt, jobs[i].saltlen,
+		              jobs[i].iterations,
+		              jobs[i].out, jobs[i].outlen, jobs[i].skip_bytes);
+#endif
+}
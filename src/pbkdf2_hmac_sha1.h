@@ -35,7 +35,7 @@
 #define pbkdf2_sha1_sse pbkdf1_sha1_sse
 #endif
 
-#if !defined(SIMD_COEF_32) || defined(PBKDF2_HMAC_SHA1_ALSO_INCLUDE_CTX) || defined(OPENCL_FORMAT)
+#if !defined(SIMD_COEF_32) || defined(PBKDF2_HMAC_SHA1_ALSO_INCLUDE_CTX) || defined(OPENCL_FORMAT) || defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 static void _pbkdf2_sha1_load_hmac(const unsigned char *K, int KL, SHA_CTX *pIpad, SHA_CTX *pOpad) {
 	unsigned char ipad[SHA_CBLOCK], opad[SHA_CBLOCK], k0[SHA_DIGEST_LENGTH];
@@ -136,7 +136,8 @@ static void pbkdf2_sha1(const unsigned char *K, int KL, const unsigned char *S,
 
 #endif
 
-#if defined(SIMD_COEF_32) && !defined(OPENCL_FORMAT)
+/* Define PBKDF2_HMAC_SCALAR_ONLY to get just the scalar functions */
+#if defined(SIMD_COEF_32) && !defined(OPENCL_FORMAT) && !defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 #define SSE_GROUP_SZ_SHA1 (SIMD_COEF_32*SIMD_PARA_SHA1)
 
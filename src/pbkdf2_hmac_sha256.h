@@ -32,7 +32,7 @@
 #define SHA256_DIGEST_LENGTH 32
 #endif
 
-#if !defined(SIMD_COEF_32) || defined (PBKDF2_HMAC_SHA256_ALSO_INCLUDE_CTX)
+#if !defined(SIMD_COEF_32) || defined (PBKDF2_HMAC_SHA256_ALSO_INCLUDE_CTX) || defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 static void _pbkdf2_sha256_load_hmac(const unsigned char *K, int KL, SHA256_CTX *pIpad, SHA256_CTX *pOpad) {
 	unsigned char ipad[SHA256_CBLOCK], opad[SHA256_CBLOCK], k0[SHA256_DIGEST_LENGTH];
@@ -140,7 +140,8 @@ static void pbkdf2_sha256(const unsigned char *K, int KL, unsigned char *S, int
 
 #endif
 
-#if defined (SIMD_COEF_32) && !defined(OPENCL_FORMAT)
+/* Define PBKDF2_HMAC_SCALAR_ONLY to get just the scalar functions */
+#if defined (SIMD_COEF_32) && !defined(OPENCL_FORMAT) && !defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 #ifndef __JTR_SHA2___H_
 // we MUST call our sha2.c functions, to know the layout.  Since it is possible that apple's CommonCrypto lib could
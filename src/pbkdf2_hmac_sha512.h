@@ -29,7 +29,7 @@
 #define SHA512_DIGEST_LENGTH 64
 #endif
 
-#if !defined(SIMD_COEF_64) || defined (PBKDF2_HMAC_SHA512_ALSO_INCLUDE_CTX)
+#if !defined(SIMD_COEF_64) || defined (PBKDF2_HMAC_SHA512_ALSO_INCLUDE_CTX) || defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 static void _pbkdf2_sha512_load_hmac(const unsigned char *K, int KL, SHA512_CTX *pIpad, SHA512_CTX *pOpad) {
 	unsigned char ipad[SHA512_CBLOCK], opad[SHA512_CBLOCK], k0[SHA512_DIGEST_LENGTH];
@@ -142,7 +142,8 @@ static void pbkdf2_sha512(const unsigned char *K, int KL, unsigned char *S, int
 
 #endif
 
-#if defined (SIMD_COEF_64) && !defined(OPENCL_FORMAT)
+/* Define PBKDF2_HMAC_SCALAR_ONLY to get just the scalar functions */
+#if defined (SIMD_COEF_64) && !defined(OPENCL_FORMAT) && !defined(PBKDF2_HMAC_SCALAR_ONLY)
 
 #ifndef __JTR_SHA2___H_
 // we MUST call our sha2.c functions, to know the layout.  Since it is possible that apple's CommonCrypto lib could
@@ -54,6 +54,7 @@ john_register_one(&fmt_phpassmd5);
 #endif
 
 #include "simd-intrinsics.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"phpass"
@@ -105,10 +106,7 @@ static unsigned loopCnt;
 
 static void init(struct fmt_main *self) {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 #ifdef SIMD_COEF_32
 	crypt_key = mem_calloc_align(self->params.max_keys_per_crypt/NBKEYS,
@@ -51,6 +51,7 @@ john_register_one(&fmt_rawMD5);
 #include <omp.h>
 #endif
 #include "simd-intrinsics.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"Raw-MD5"
@@ -130,10 +131,7 @@ static uint32_t (*crypt_key)[4];
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #else
 	self->params.max_keys_per_crypt *= 10;
 #endif
@@ -506,7 +504,7 @@ struct fmt_main fmt_rawMD5 = {
 #ifdef _OPENMP
 		FMT_OMP | FMT_OMP_BAD |
 #endif
-		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE,
+		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE | FMT_SETKEY_MT,
 		{ NULL },
 		{ FORMAT_TAG, FORMAT_TAG2 },
 		tests
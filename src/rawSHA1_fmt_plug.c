@@ -52,6 +52,7 @@ john_register_one(&fmt_rawSHA1_axcrypt);
 #include <omp.h>
 #endif
 #include "simd-intrinsics.h"
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define AX_FORMAT			1
@@ -103,12 +104,7 @@ static unsigned SSEi_flags;
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t;
-
-	omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 #ifdef SIMD_COEF_32
 	saved_key = mem_calloc_align(self->params.max_keys_per_crypt/NBKEYS,
@@ -440,7 +436,7 @@ struct fmt_main fmt_rawSHA1 = {
 #ifdef _OPENMP
 		FMT_OMP | FMT_OMP_BAD |
 #endif
-		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE,
+		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE | FMT_SETKEY_MT,
 		{ NULL },
 		{ FORMAT_TAG, FORMAT_TAG_OLD },
 		rawsha1_common_tests
@@ -504,7 +500,7 @@ struct fmt_main fmt_rawSHA1_axcrypt = {
 #ifdef _OPENMP
 		FMT_OMP | FMT_OMP_BAD |
 #endif
-		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE,
+		FMT_CASE | FMT_8_BIT | FMT_SPLIT_UNIFIES_CASE | FMT_SETKEY_MT,
 		{ NULL },
 		{ NULL },
 		axcrypt_common_tests
@@ -51,6 +51,7 @@ john_register_one(&fmt_rawSHA224);
 #endif
 #include <omp.h>
 #endif
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL            "Raw-SHA224"
@@ -116,10 +117,7 @@ static uint32_t (*crypt_out)
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 #ifndef SIMD_COEF_32
 	saved_len = mem_calloc(self->params.max_keys_per_crypt,
@@ -424,7 +422,7 @@ struct fmt_main fmt_rawSHA224 = {
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
 		FMT_CASE | FMT_8_BIT | FMT_OMP | FMT_OMP_BAD |
-		FMT_SPLIT_UNIFIES_CASE,
+		FMT_SPLIT_UNIFIES_CASE | FMT_SETKEY_MT,
 		{ NULL },
 		{ FORMAT_TAG },
 		tests
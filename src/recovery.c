@@ -277,12 +277,16 @@ static void save_salt_state()
 		++h;
 	}
 	*p = 0;
-	fprintf(rec_file, "slt-v2\n%s\n", md5_buf);
+	// v3 adds the salt's priority, for SaltOrder = cost (see cracker.c)
+	fprintf(rec_file, "slt-v%d\n%s\n",
+	        status.resume_salt_priority >= 0 ? 3 : 2, md5_buf);
 	// bug found in original salt-restore.  if the cracks per loop value is NOT the same,
 	// then we end up skipping processing some data. So we save this value, and then
 	// when we resume IF this value is not the same, we ignore the salt resume, and just
 	// start from salt zero.
 	fprintf(rec_file, "%d\n", cracker_max_keys_per_crypt());
+	if (status.resume_salt_priority >= 0)
+		fprintf(rec_file, "%.17g\n", status.resume_salt_priority);
 }
 
 void rec_save(void)
@@ -622,12 +626,21 @@ static void restore_salt_state(int type)
 	int i;
 
 	fgetl(buf, sizeof(buf), rec_file);
-	if (type == 2) {
+	if (type >= 2) {
 		fgetl(buf2, sizeof(buf2), rec_file);
 	}
 	if (strlen(buf) != 32 || !ishex(buf))
 		rec_format_error("multi-salt");
-	if (type == 2) {
+	status.resume_salt_priority = -1;
+	if (type == 3) {
+		char buf3[48];
+
+		fgetl(buf3, sizeof(buf3), rec_file);
+		status.resume_salt_priority = strtod(buf3, NULL);
+		if (status.resume_salt_priority < 0)
+			rec_format_error("multi-salt");
+	}
+	if (type >= 2) {
 		// the first crack, we seek to the above salt, BUT only if we
 		// still have exactly same count of max_crypts_per  If the max
 		// changes, then we simply start over at salt#1 to avoid any
@@ -679,6 +692,9 @@ void rec_restore_mode(int (*restore_mode)(FILE *file))
 		if (!strcmp(buf, "slt-v2")) {
 			restore_salt_state(2);
 		}
+		if (!strcmp(buf, "slt-v3")) {
+			restore_salt_state(3);
+		}
 		fgetl(buf, sizeof(buf), rec_file);
 	}
 
@@ -44,6 +44,13 @@ char *stpcpy(char *dst, const char *src) {
 }
 #endif
 
+/*
+ * Candidates are handed to the cracker in blocks.  Unless a filter or a
+ * stacked mask needs to see each one, they go straight from rexgen into the
+ * format's key buffer, and a block is what's left of one crypt_all() batch.
+ */
+#define REGEX_BLOCK_KEYS		0x2000
+
 char *rexgen_alphabets[256];
 static c_iterator_ptr iter = NULL;
 static c_regex_ptr regex_ptr = NULL;
@@ -52,9 +59,21 @@ static const char *cur_regex, *save_regex;
 static char *restore_str, *restore_regex;
 static int save_str_len;
 
-static void fix_state(void)
-{
-}
+/*
+ * The iterator state is only captured at the start of each block, along with
+ * the sequence number of the block's first candidate.  Together with the
+ * sequence number of the last candidate we actually used, that's enough to
+ * get back to any position within the block on restore.  Sequence numbers
+ * count every candidate, including other nodes' ones.
+ */
+static char *block_state;
+static int block_state_len, iter_done;
+static int64_t seq, block_seq, cur_seq;
+static int64_t save_block_seq, save_seq;
+static int64_t restore_block_seq, restore_seq;
+
+/* Whether to split the candidates across nodes (not in hybrid mode) */
+static int regex_dist;
 
 static double get_progress(void)
 {
@@ -67,7 +86,7 @@ static void save_state(FILE *file)
 
 int rexgen_restore_state_hybrid(const char *sig, FILE *file)
 {
-	if (!strncmp(sig, "rex-v1", 6))
+	if (!strncmp(sig, "rex-v1", 6) || !strncmp(sig, "rex-v2", 6))
 	{
 		int len, ret;
 		ret = fscanf(file, "%d\n", &len);
@@ -78,6 +97,15 @@ int rexgen_restore_state_hybrid(const char *sig, FILE *file)
 		if (ret != 1) return 1;
 		restore_str = mem_alloc_tiny(len+2, 8);
 		fgetl(restore_str, len+1, file);
+		restore_block_seq = restore_seq = 0;
+		if (sig[5] == '2') {
+			long long bseq, rseq;
+
+			ret = fscanf(file, LLd"\n"LLd"\n", &bseq, &rseq);
+			if (ret != 2 || bseq < 0 || rseq < bseq) return 1;
+			restore_block_seq = bseq;
+			restore_seq = rseq;
+		}
 		log_event("resuming a regex expr or %s and state of %s\n", restore_regex, restore_str);
 		return 0;
 	}
@@ -87,28 +115,158 @@ int rexgen_restore_state_hybrid(const char *sig, FILE *file)
 static void save_state_hybrid(FILE *file)
 {
 	if (save_str && strlen(save_str)) {
-		fprintf(file, "rex-v1\n");
+		fprintf(file, "rex-v2\n");
 		fprintf(file, "%d\n", (int)strlen(save_regex));
 		fprintf(file, "%s\n", save_regex);
 		fprintf(file, "%d\n", (int)strlen(save_str));
 		fprintf(file, "%s\n", save_str);
+		fprintf(file, LLd"\n"LLd"\n",
+		        (long long)save_block_seq, (long long)save_seq);
 	}
 }
 
 static void rex_hybrid_fix_state()
 {
-	char *dstptr=0;
-	if (iter)
-		c_iterator_get_state(iter, &dstptr);
-	if (dstptr) {
-		if (strlen(dstptr) > save_str_len) {
-			save_str_len = strlen(dstptr)+256;
+	if (!block_state)
+		return;
+
+	if (!save_str || save_block_seq != block_seq ||
+	    strcmp(save_str, block_state)) {
+		int len = strlen(block_state);
+
+		if (len > save_str_len) {
+			save_str_len = len + 256;
 			MEM_FREE(save_str);
-			save_str = mem_alloc(save_str_len+1);
+			save_str = mem_alloc(save_str_len + 1);
+		}
+		strcpy(save_str, block_state);
+		save_block_seq = block_seq;
+	}
+	save_seq = cur_seq;
+	save_regex = cur_regex;
+}
+
+static void fix_state(void)
+{
+	rex_hybrid_fix_state();
+}
+
+/*
+ * Sets the iterator to a restored state, then skips the candidates in that
+ * block that we had already used.
+ */
+static void regex_restore_iterator(void)
+{
+	c_iterator_set_state(iter, restore_str);
+	seq = restore_block_seq;
+	while (seq < restore_seq && c_iterator_next(iter))
+		seq++;
+	restore_str = NULL;
+}
+
+/*
+ * Captures the iterator state at the start of a block.
+ */
+static void regex_start_block(void)
+{
+	char *state = NULL;
+	int len;
+
+	c_iterator_get_state(iter, &state);
+	if (state) {
+		if ((len = strlen(state)) >= block_state_len) {
+			block_state_len = len + 256;
+			MEM_FREE(block_state);
+			block_state = mem_alloc(block_state_len);
+		}
+		strcpy(block_state, state);
+	}
+	block_seq = seq;
+}
+
+/*
+ * Moves the iterator to our next candidate and puts it in buffer.  Other
+ * nodes' candidates are stepped over without being generated.  Returns zero,
+ * setting iter_done, when the iterator is exhausted.  We must not call
+ * c_iterator_next() again after that, or it would start over (with an empty
+ * hybrid base word).
+ */
+static int regex_next(c_simplestring_ptr buffer)
+{
+	for (;;) {
+		if ((iter_done = !c_iterator_next(iter)))
+			return 0;
+		if (regex_dist) {
+			int for_node = seq % options.node_count + 1;
+
+			if (for_node < options.node_min ||
+			    for_node > options.node_max) {
+				seq++;
+				continue;
+			}
+		}
+		break;
+	}
+
+	c_simplestring_clear(buffer);
+	c_iterator_value(iter, buffer);
+	cur_seq = ++seq;
+
+	return 1;
+}
+
+/*
+ * Hands a block of candidates to the cracker (or to a stacked mask).
+ * Returns non-zero if we're done cracking.
+ */
+static int regex_process_block(struct db_main *db, c_simplestring_ptr buffer,
+                               int max_len)
+{
+	char key[LINE_BUFFER_SIZE];
+	char *word;
+	int index, room, count;
+
+	regex_start_block();
+
+	/*
+	 * rexgen already creates the correct encoding, so the words can be
+	 * set as they come.
+	 */
+	if (!options.mask && !f_filter && (index = crk_key_block(&room)) >= 0) {
+		for (count = 0; count < room && regex_next(buffer); count++) {
+			c_simplestring_truncate_bytes(buffer, max_len);
+			db->format->methods.set_key(
+				(char *)c_simplestring_to_string(buffer),
+				index + count);
+		}
+		return count && crk_process_keys(count);
+	}
+
+	for (count = 0; count < REGEX_BLOCK_KEYS && regex_next(buffer);
+	     count++) {
+		word = (char *)c_simplestring_to_string(buffer);
+
+		if (options.mask) {
+			if (do_mask_crack(word))
+				return 1;
+			continue;
 		}
-		strcpy(save_str, dstptr);
-		save_regex = cur_regex;
+
+		if (f_filter) {
+			/* The filter may write more than the word */
+			word = strnzcpy(key, word, sizeof(key));
+			if (!ext_filter(word))
+				continue;
+			if (strlen(word) > max_len)
+				word[max_len] = 0;
+		} else
+			c_simplestring_truncate_bytes(buffer, max_len);
+
+		if (crk_process_key(word))
+			return 1;
 	}
+
+	return 0;
 }
 
 static int restore_state(FILE *file)
@@ -190,7 +348,6 @@ int do_regex_hybrid_crack(struct db_main *db, const char *regex,
                           const char *regex_alpha)
 {
 	c_simplestring_ptr buffer = c_simplestring_new();
-	const char* word;
 	static int bFirst = 1;
 	static int bALPHA = 0;
 	int max_len = db->format->params.plaintext_length;
@@ -230,7 +387,7 @@ int do_regex_hybrid_crack(struct db_main *db, const char *regex,
 		iter = c_regex_iterator(regex_ptr);
 
 		if (restore_str)
-			c_iterator_set_state(iter, restore_str);
+			regex_restore_iterator();
 	}
 
 	if (bALPHA) {
@@ -286,27 +443,11 @@ int do_regex_hybrid_crack(struct db_main *db, const char *regex,
 		goto out;
 	}
 
-	while (c_iterator_next(iter)) {
-		c_simplestring_clear(buffer);
-		c_iterator_value(iter, buffer);
-		word = c_simplestring_to_string(buffer);
-		/**
-		  * rexgen already creates the correct encoding
-		  */
-		//if (options.internal_cp != UTF_8)
-		//	utf8_to_cp_r(word, word, sizeof(word));
-		if (options.mask) {
-			if (do_mask_crack(word)) {
-				retval = 1;
-				goto out;
-			}
-		} else
-		if (ext_filter((char *)word)) {
-			c_simplestring_truncate_bytes(buffer, max_len);
-			if (crk_process_key((char *)word)) {
-				retval = 1;
-				goto out;
-			}
+	iter_done = 0;
+	while (!iter_done) {
+		if (regex_process_block(db, buffer, max_len)) {
+			retval = 1;
+			goto out;
 		}
 	}
 	retval = 0;
@@ -320,7 +461,6 @@ out:
 void do_regex_crack(struct db_main *db, const char *regex)
 {
 	c_simplestring_ptr buffer = c_simplestring_new();
-	const char* word;
 	int max_len = db->format->params.plaintext_length;
 
 	if (options.req_maxlength)
@@ -344,29 +484,23 @@ void do_regex_crack(struct db_main *db, const char *regex)
 	if (rec_restored && john_main_process)
 		fprintf(stderr, "Proceeding with regex:%s\n", regex);
 
+	if ((regex_dist = options.node_count))
+		log_event("- Will distribute candidates across nodes");
+
 	iter = c_regex_iterator(regex_ptr);
-	if (restore_str) {
-		c_iterator_set_state(iter, restore_str);
-		restore_str = 0;
-	}
-	while (c_iterator_next(iter)) {
-		c_simplestring_clear(buffer);
-		c_iterator_value(iter, buffer);
-		word = c_simplestring_to_string(buffer);
-		if (options.mask) {
-			if (do_mask_crack(word))
-				break;
-		} else
-		if (ext_filter((char *)word)) {
-			c_simplestring_truncate_bytes(buffer, max_len);
-			if (crk_process_key((char *)word))
-				break;
-		}
+	if (restore_str)
+		regex_restore_iterator();
+
+	iter_done = 0;
+	while (!iter_done) {
+		if (regex_process_block(db, buffer, max_len))
+			break;
 	}
 	c_simplestring_delete(buffer);
 	c_iterator_delete(iter);
 	crk_done();
 	rec_done(event_abort);
+	MEM_FREE(block_state);
 }
 
 
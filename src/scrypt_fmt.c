@@ -21,6 +21,8 @@
 #include "misc.h"
 #include "common.h"
 #include "formats.h"
+#include "config.h"
+#include "memory.h"
 #include "base64_convert.h"
 #include "memdbg.h"
 
@@ -52,14 +54,27 @@
 #define SALT_SIZE			BINARY_SIZE
 #define SALT_ALIGN			1
 
-#define MIN_KEYS_PER_CRYPT		1
-#define MAX_KEYS_PER_CRYPT		1
+/*
+ * Each thread hashes its keys two at a time, interleaving their SMix to hide
+ * memory latency.  That needs twice the memory, so it is only done while the
+ * V arrays of all threads together stay within ScryptPairMaxMemory (MB, in
+ * john.conf), and never with --save-memory.
+ */
+#define MIN_KEYS_PER_CRYPT		2
+#define MAX_KEYS_PER_CRYPT		2
+#define PAIR_MAX_MEMORY			1024
 
 static struct fmt_tests tests[] = {
 	{"$7$C6..../....SodiumChloride$kBGj9fHznVYFQMEn/qDCfrDevf9YDtcDdKvEqHJLV8D", "pleaseletmein"},
 	{"$7$C6..../....\x01\x09\x0a\x0d\x20\x7f\x80\xff$b7cKqzsQk7txdc9As1WZBHjUPNWQWJW8A.UUUTA5eD1", "\x01\x09\x0a\x0d\x20\x7f\x80\xff"},
 	{"$7$2/..../....$rNxJWVHNv/mCNcgE/f6/L4zO6Fos5c2uTzhyzoisI62", ""},
 	{"$7$86....E....NaCl$xffjQo7Bm/.SKRS4B2EuynbOLjAmXU5AbDbRXhoBl64", "password"},
+	// r=8, p=1 at N=2^10, 2^12, 2^16 and 2^17, so that "--test --cost=N"
+	// can measure each V array size (1, 4, 64 and 128 MiB per key)
+	{"$7$86..../....tQ1TF2h0k4zN$LxmEVrJG0XlEJUaEK059xfKAXo8j8BDd.fMTvO2luc/", "Kitchen sink"},
+	{"$7$A6..../....zg6dNJGUKbcd$jygtx.ZsYTalUyjykjERZsdEHB4xfqbGNDygMlyosH8", "abc123"},
+	{"$7$E6..../....VOQwZ3nybyb7$6LIjA99cWu/HDHEJDsxKvI/CT3sqLvSJgi8sAdnloiB", "john the ripper"},
+	{"$7$F6..../....Q0Hg8y6Hbb3o$w0nFOqjXyVsVB3yb.YNCSqPbEkELVX8eJRtwiUvtUu/", "magnum"},
 	// cisco type 9 hashes.  .  They are $7$C/..../.... type  (N=16384, r=1, p=1) different base-64 (same as WPA).  salt used RAW
 	{"$9$nhEmQVczB7dqsO$X.HsgL6x1il0RxkOSSvyQYwucySCt7qFm4v7pqCxkKM", "cisco"},
 	{"$9$cvWdfQlRRDKq/U$VFTPha5VHTCbSgSUAo.nPoh50ZiXOw1zmljEjXkaq1g", "123456"},
@@ -89,6 +104,8 @@ static int max_threads;
 static escrypt_local_t *local;
 
 static char saved_salt[SALT_SIZE];
+static int keys_per_thread, saved_pair;
+static uint64_t pair_max_size;
 static struct {
 	char key[PLAINTEXT_LENGTH + 1];
 	char out[BINARY_SIZE];
@@ -96,7 +113,17 @@ static struct {
 
 static void init(struct fmt_main *self)
 {
-	int i;
+	int i, mb;
+
+	if ((mb = cfg_get_int(SECTION_OPTIONS, NULL,
+	    "ScryptPairMaxMemory")) < 0)
+		mb = PAIR_MAX_MEMORY;
+	if (mem_saving_level)
+		mb = 0;
+	pair_max_size = (uint64_t)mb << 20;
+	keys_per_thread = mb ? 2 : 1;
+	self->params.min_keys_per_crypt = keys_per_thread;
+	self->params.max_keys_per_crypt = keys_per_thread;
 
 #ifdef _OPENMP
 	max_threads = omp_get_max_threads();
@@ -363,9 +390,15 @@ static int salt_hash(void *salt)
 	return h & (SALT_HASH_SIZE - 1);
 }
 
+static unsigned int tunable_cost_N(void *salt);
+static unsigned int tunable_cost_r(void *salt);
+
 static void set_salt(void *salt)
 {
 	strcpy(saved_salt, salt);
+	saved_pair = keys_per_thread == 2 &&
+		(uint64_t)tunable_cost_N(salt) * tunable_cost_r(salt) *
+		128 * 2 * max_threads <= pair_max_size;
 }
 
 static void set_key(char *key, int index)
@@ -385,19 +418,41 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 	int failed = 0;
 
 #ifdef _OPENMP
-#pragma omp parallel for default(none) private(index) shared(count, failed, local, saved_salt, buffer)
+#pragma omp parallel for default(none) private(index) shared(count, failed, local, saved_salt, keys_per_thread, saved_pair, buffer)
 #endif
-	for (index = 0; index < count; index++) {
-		uint8_t *hash;
-		hash = escrypt_r(&(local[index]),
-		    (const uint8_t *)(buffer[index].key),
-		    strlen(buffer[index].key),
-		    (const uint8_t *)saved_salt,
-		    (uint8_t *)&(buffer[index].out),
-		    sizeof(buffer[index].out));
-		if (!hash) {
-			failed = 1;
-			buffer[index].out[0] = 0;
+	for (index = 0; index < count; index += keys_per_thread) {
+		escrypt_local_t *l = &local[index / keys_per_thread];
+		int i;
+
+		if (saved_pair && index + 1 < count) {
+			if (escrypt_r_2(l,
+			    (const uint8_t *)(buffer[index].key),
+			    strlen(buffer[index].key),
+			    (const uint8_t *)(buffer[index + 1].key),
+			    strlen(buffer[index + 1].key),
+			    (const uint8_t *)saved_salt,
+			    (uint8_t *)&(buffer[index].out),
+			    (uint8_t *)&(buffer[index + 1].out),
+			    sizeof(buffer[index].out))) {
+				failed = 1;
+				buffer[index].out[0] = 0;
+				buffer[index + 1].out[0] = 0;
+			}
+			continue;
+		}
+
+		for (i = index; i < index + keys_per_thread && i < count; i++) {
+			uint8_t *hash;
+			hash = escrypt_r(l,
+			    (const uint8_t *)(buffer[i].key),
+			    strlen(buffer[i].key),
+			    (const uint8_t *)saved_salt,
+			    (uint8_t *)&(buffer[i].out),
+			    sizeof(buffer[i].out));
+			if (!hash) {
+				failed = 1;
+				buffer[i].out[0] = 0;
+			}
 		}
 	}
 
@@ -496,9 +496,72 @@ static MAYBE_INLINE void mmxput2(void *buf, unsigned int bid, void *src)
 #define BITALIGN(hi, lo, s) (((hi) << (32 - (s))) | ((lo) >> (s)))
 #endif
 
+/* Max. different password lengths in a vector for putting digests in place
+ * with vector operations, one pass per length */
+#define MD5_LEN_CLASSES	4
+
+/*
+ * The password lengths in each vector.  count is 0 if there are more than
+ * MD5_LEN_CLASSES of them, and then the digests are put one lane at a time.
+ */
+typedef struct {
+	vtype mask[SIMD_PARA_MD5][MD5_LEN_CLASSES];	/* lanes of each length */
+	unsigned int length[SIMD_PARA_MD5][MD5_LEN_CLASSES];
+	unsigned int count[SIMD_PARA_MD5];
+} md5_len_classes;
+
+/*
+ * Puts a vector of digests at byte offset n of its lanes' blocks: all lanes,
+ * or those in mask.
+ */
+#define MMXPUT3_STORE(i, x) \
+	if (mask) \
+		vstore(&d[i], vcmov((x), vload(&d[i]), vload(mask))); \
+	else \
+		vstore(&d[i], (x))
+
+#define MMXPUT3_SHIFT(r) \
+	MMXPUT3_STORE(0, vor(vand(vload(&d[0]), vset1_epi32((1U << (r)) - 1)), \
+	                     vslli_epi32(vload(&v[0]), (r)))); \
+	MMXPUT3_STORE(1, vor(vslli_epi32(vload(&v[1]), (r)), \
+	                     vsrli_epi32(vload(&v[0]), 32 - (r)))); \
+	MMXPUT3_STORE(2, vor(vslli_epi32(vload(&v[2]), (r)), \
+	                     vsrli_epi32(vload(&v[1]), 32 - (r)))); \
+	MMXPUT3_STORE(3, vor(vslli_epi32(vload(&v[3]), (r)), \
+	                     vsrli_epi32(vload(&v[2]), 32 - (r)))); \
+	MMXPUT3_STORE(4, vor(vand(vload(&d[4]), vset1_epi32(0xffffffffU << (r))), \
+	                     vsrli_epi32(vload(&v[3]), 32 - (r))))
+
+static MAYBE_INLINE void mmxput3_vec(unsigned char *nbuf, unsigned int n,
+                                     unsigned int *s, vtype *mask)
+{
+	vtype *d = (vtype *)(nbuf + (n & ~3U) * VS32);
+	vtype *v = (vtype *)s;
+
+	switch (n & 3) {
+	case 0:
+		MMXPUT3_STORE(0, vload(&v[0]));
+		MMXPUT3_STORE(1, vload(&v[1]));
+		MMXPUT3_STORE(2, vload(&v[2]));
+		MMXPUT3_STORE(3, vload(&v[3]));
+		break;
+	case 1:
+		MMXPUT3_SHIFT(8);
+		break;
+	case 2:
+		MMXPUT3_SHIFT(16);
+		break;
+	case 3:
+		MMXPUT3_SHIFT(24);
+	}
+}
+#undef MMXPUT3_SHIFT
+#undef MMXPUT3_STORE
+
 static MAYBE_INLINE void mmxput3(void *buf, unsigned int bid,
                                  unsigned int *offset, unsigned int mult,
-                                 unsigned int saltlen, void *src)
+                                 unsigned int saltlen,
+                                 md5_len_classes *classes, void *src)
 {
 	unsigned int j;
 
@@ -507,6 +570,18 @@ static MAYBE_INLINE void mmxput3(void *buf, unsigned int bid,
 		unsigned int jm = j * VS32 * 4;
 		unsigned char *nbuf = ((unsigned char *)buf) + bid * (64 * MD5_SSE_NUM_KEYS) + jm * 16;
 		unsigned int *s = (unsigned int *)src + jm;
+		if (classes->count[j] == 1) {
+			mmxput3_vec(nbuf, classes->length[j][0] * mult + saltlen,
+			            s, NULL);
+			continue;
+		}
+		if (classes->count[j]) {
+			for (i = 0; i < classes->count[j]; i++)
+				mmxput3_vec(nbuf,
+				            classes->length[j][i] * mult + saltlen,
+				            s, &classes->mask[j][i]);
+			continue;
+		}
 		for (i = 0; i < VS32; i++, s++) {
 			unsigned int n = offset[i + jm / 4] * mult + saltlen;
 			unsigned int *d = (unsigned int *)(nbuf + (n & ~3U) * VS32) + i;
@@ -556,89 +631,40 @@ static MAYBE_INLINE void mmxput3(void *buf, unsigned int bid,
 	}
 }
 
+/*
+ * The block used by each of md5crypt's rounds repeats every 42 rounds.  Blocks
+ * 0, 3, 5 and 6 start with the previous digest; the rest have it after mult
+ * copies of the password, and the salt if salted.
+ */
+static const unsigned char md5_schedule[42] = {
+	0, 7, 6, 2, 6, 7, 3, 4, 6, 2, 6, 7, 3, 7, 5, 2, 6, 7, 3, 7, 6,
+	1, 6, 7, 3, 7, 6, 2, 5, 7, 3, 7, 6, 2, 6, 4, 3, 7, 6, 2, 6, 7
+};
+static const unsigned char md5_mult[8] = { 0, 1, 2, 0, 1, 0, 0, 2 };
+static const unsigned char md5_salted[8] = { 0, 0, 0, 0, 1, 0, 0, 1 };
+
 static MAYBE_INLINE void dispatch(unsigned char buffers[8][64*MD5_SSE_NUM_KEYS],
                                   unsigned int f[4*MD5_SSE_NUM_KEYS],
                                   unsigned int length[MD5_SSE_NUM_KEYS],
-                                  unsigned int saltlen)
+                                  unsigned int saltlen,
+                                  md5_len_classes *classes)
 {
 	unsigned int i, j;
 	unsigned int bufferid;
 
-	i = 1000 / 42; j = 0;
-	do {
-		switch(j)
-		{
-			case 0:
-				bufferid = 0;
-				mmxput2(buffers, bufferid, f);
-				break;
-			case 21:
-				bufferid = 1;
-				mmxput3(buffers, bufferid, length, 1, 0, f);
-				break;
-			case 3:
-			case 9:
-			case 15:
-			case 27:
-			case 33:
-			case 39:
-				bufferid = 2;
-				mmxput3(buffers, bufferid, length, 2, 0, f);
-				break;
-			case 6:
-			case 12:
-			case 18:
-			case 24:
-			case 30:
-			case 36:
-				bufferid = 3;
-				mmxput2(buffers, bufferid, f);
-				break;
-			case 7:
-			case 35:
-				bufferid = 4;
-				mmxput3(buffers, bufferid, length, 1, saltlen, f);
-				break;
-			case 14:
-			case 28:
-				bufferid = 5;
-				mmxput2(buffers, bufferid, f);
-				break;
-			case 2:
-			case 4:
-			case 8:
-			case 10:
-			case 16:
-			case 20:
-			case 22:
-			case 26:
-			case 32:
-			case 34:
-			case 38:
-			case 40:
-				bufferid = 6;
-				mmxput2(buffers, bufferid, f);
-				break;
-			default:
-				bufferid = 7;
-				mmxput3(buffers, bufferid, length, 2, saltlen, f);
-				break;
-		}
+	for (i = 0, j = 0; i < 1000; i++) {
+		bufferid = md5_schedule[j];
+		if (md5_mult[bufferid])
+			mmxput3(buffers, bufferid, length, md5_mult[bufferid],
+			        md5_salted[bufferid] ? saltlen : 0, classes, f);
+		else
+			mmxput2(buffers, bufferid, f);
 		SIMDmd5body((vtype*)&buffers[bufferid], f, NULL, SSEi_MIXED_IN);
-		if (j++ < 1000 % 42 - 1)
-			continue;
-		if (j == 1000 % 42) {
-			if (!i)
-				break;
-			i--;
-			continue;
-		}
-		if (j >= 42)
+		if (++j == 42)
 			j = 0;
-	} while (1);
+	}
 }
 
-
 void md5cryptsse(unsigned char pwd[MD5_SSE_NUM_KEYS][16], unsigned char *salt,
                  char *out, unsigned int md5_type)
 {
@@ -650,6 +676,7 @@ void md5cryptsse(unsigned char pwd[MD5_SSE_NUM_KEYS][16], unsigned char *salt,
 	JTR_ALIGN(MEM_ALIGN_SIMD)
 		unsigned char buffers[8][64*MD5_SSE_NUM_KEYS] = { { 0 } };
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned int F[4*MD5_SSE_NUM_KEYS];
+	md5_len_classes classes;
 
 	saltlen = strlen((char*)salt);
 	for (i=0;i<MD5_SSE_NUM_KEYS;i++)
@@ -742,7 +769,24 @@ void md5cryptsse(unsigned char pwd[MD5_SSE_NUM_KEYS][16], unsigned char *salt,
 		F[i/VS32*4*VS32 + (i&(VS32-1)) + 3*VS32] = JOHNSWAP(tf[3]);
 #endif
 	}
-	dispatch(buffers, F, length, saltlen);
+
+	/* Group each vector's lanes by password length */
+	memset(classes.mask, 0, sizeof(classes.mask));
+	MD5_PARA_DO(i) {
+		unsigned int k, n = 0;
+
+		for (j = 0; j < VS32 && n <= MD5_LEN_CLASSES; j++) {
+			for (k = 0; k < n; k++)
+				if (classes.length[i][k] == length[i * VS32 + j])
+					break;
+			if (k == n && ++n <= MD5_LEN_CLASSES)
+				classes.length[i][k] = length[i * VS32 + j];
+			if (k < MD5_LEN_CLASSES)
+				((unsigned int *)&classes.mask[i][k])[j] = ~0U;
+		}
+		classes.count[i] = n <= MD5_LEN_CLASSES ? n : 0;
+	}
+	dispatch(buffers, F, length, saltlen, &classes);
 	memcpy(out, F, MD5_SSE_NUM_KEYS*16);
 }
 #endif /* SIMD_PARA_MD5 */
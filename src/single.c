@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "misc.h"
@@ -26,6 +27,7 @@
 #include "john.h"
 #include "unicode.h"
 #include "config.h"
+#include "bloom.h"
 #include "memdbg.h"
 
 struct list_main *single_seed;
@@ -42,12 +44,64 @@ static struct rpp_context *rule_ctx;
 static int words_pair_max;
 static int retest_guessed;
 
+/*
+ * Salt windows.  The per-salt key buffers come from one shared pool sized to
+ * SingleMaxBufferSize, and we run all rules against one window of salts at a
+ * time.  A window is a range of salt md5 values, with the ranges chosen to
+ * split the salts evenly.  The ranges are saved in the session file, so that
+ * a restore with fewer salts (some were cracked) keeps the same windows.
+ */
+static char *keys_pool;
+static size_t keys_size, keys_hash_size;
+static struct db_salt **window_salts;
+static int window_size, window_count;
+static int rec_window, window_total;
+static uint32_t *window_bounds;
+
+/*
+ * Passwords guessed while some salts had no buffer (they were in other
+ * windows), to be retested against those.  window_done[] is the number of
+ * them already retested against each window.
+ */
+static struct list_main *window_guesses;
+static unsigned int *window_done;
+
+/*
+ * Filter of (salt, candidate) pairs already buffered for cracking, across
+ * all rules and retests of guessed plaintexts.  Hits aren't confirmed, so a
+ * false positive skips a candidate never tried; hence off unless configured.
+ */
+static struct bloom_filter dupe_filter;
+static int dupe_filter_full;
+
 extern int rpp_real_run; /* set to 1 when we really get into single mode */
 
 
 static void save_state(FILE *file)
 {
-	fprintf(file, "%d\n", rec_rule);
+	struct list_entry *word;
+	unsigned char *p;
+	int index;
+
+	fprintf(file, "%d %d %d\n", rec_rule, rec_window, window_total);
+
+	if (window_total < 2)
+		return;
+
+	for (index = 0; index < window_total; index++)
+		fprintf(file, "%x %u\n",
+		        window_bounds[index], window_done[index]);
+
+/* Guessed passwords are saved hex encoded, with their length */
+	fprintf(file, "%d\n", window_guesses->count);
+	for (word = window_guesses->head; word; word = word->next) {
+		fprintf(file, "%u ", (unsigned int)strlen(word->data));
+		for (p = (unsigned char *)word->data; *p; p++) {
+			fputc(itoa16[*p >> 4], file);
+			fputc(itoa16[*p & 0xf], file);
+		}
+		fputc('\n', file);
+	}
 }
 
 static int restore_rule_number(void)
@@ -59,9 +113,60 @@ static int restore_rule_number(void)
 	return 0;
 }
 
+static int restore_windows(FILE *file)
+{
+	char word[PLAINTEXT_BUFFER_SIZE + 1];
+	unsigned int bound, len, pos;
+	int index, count, hi, lo;
+
+	window_bounds = mem_alloc(window_total * sizeof(*window_bounds));
+	window_done = mem_alloc(window_total * sizeof(*window_done));
+	for (index = 0; index < window_total; index++) {
+		if (fscanf(file, "%x %u\n", &bound, &window_done[index]) != 2)
+			return 1;
+		window_bounds[index] = bound;
+	}
+
+	list_init(&window_guesses);
+	if (fscanf(file, "%d\n", &count) != 1 || count < 0)
+		return 1;
+	while (count--) {
+		if (fscanf(file, "%u", &len) != 1 ||
+		    len > PLAINTEXT_BUFFER_SIZE || getc(file) != ' ')
+			return 1;
+		for (pos = 0; pos < len; pos++) {
+			if ((hi = getc(file)) == EOF || (lo = getc(file)) == EOF ||
+			    atoi16[hi] == 0x7F || atoi16[lo] == 0x7F)
+				return 1;
+			word[pos] = atoi16[hi] << 4 | atoi16[lo];
+		}
+		word[len] = 0;
+		if (getc(file) != '\n')
+			return 1;
+		list_add(window_guesses, word);
+	}
+
+	return 0;
+}
+
 static int restore_state(FILE *file)
 {
-	if (fscanf(file, "%d\n", &rec_rule) != 1) return 1;
+	int c;
+
+	if (fscanf(file, "%d", &rec_rule) != 1) return 1;
+
+/* Older session files have no salt windows */
+	rec_window = window_total = 0;
+	if ((c = getc(file)) == ' ') {
+		if (fscanf(file, "%d %d", &rec_window, &window_total) != 2 ||
+		    window_total < 1 ||
+		    rec_window < 0 || rec_window > window_total)
+			return 1;
+		c = getc(file);
+	}
+	if (c != '\n') return 1;
+
+	if (window_total > 1 && restore_windows(file)) return 1;
 
 	return restore_rule_number();
 }
@@ -70,8 +175,11 @@ static double get_progress(void)
 {
 	emms();
 
-	return progress ? progress :
-		(double)rule_number / (rule_count + 1) * 100.0;
+	if (progress)
+		return progress;
+
+	return (rec_window + (double)rule_number / (rule_count + 1)) *
+		100.0 / window_total;
 }
 
 static void single_alloc_keys(struct db_keys **keys)
@@ -94,10 +202,204 @@ static void single_alloc_keys(struct db_keys **keys)
 	memset((*keys)->hash, -1, hash_size);
 }
 
-static void single_init(void)
+/*
+ * Returns the window of a salt: the last one whose md5 lower bound isn't
+ * above the salt's md5.
+ */
+static int single_salt_window(struct db_salt *salt)
+{
+	int lo = 0, hi = window_total - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) >> 1;
+		if (window_bounds[mid] <= salt->salt_md5[0])
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+static int single_md5_cmp(const void *x, const void *y)
+{
+	uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+
+	return a < b ? -1 : a > b;
+}
+
+/*
+ * Splits the range of salt md5 values into window_total windows holding
+ * about the same number of salts.
+ */
+static void single_split_windows(void)
+{
+	struct db_salt *salt;
+	uint32_t *md5;
+	int index;
+
+	window_bounds = mem_calloc(window_total, sizeof(*window_bounds));
+	window_done = mem_calloc(window_total, sizeof(*window_done));
+	if (window_total < 2)
+		return;
+
+	md5 = mem_alloc(single_db->salt_count * sizeof(*md5));
+	index = 0;
+	salt = single_db->salts;
+	do {
+		md5[index++] = salt->salt_md5[0];
+	} while ((salt = salt->next));
+	qsort(md5, index, sizeof(*md5), single_md5_cmp);
+
+	for (index = 1; index < window_total; index++)
+		window_bounds[index] =
+			md5[(uint64_t)index * single_db->salt_count /
+			    window_total];
+	MEM_FREE(md5);
+}
+
+/*
+ * Sizes the shared key buffer pool to SingleMaxBufferSize.  If buffers for
+ * all salts don't fit, we process the salts in windows.  Each salt's buffer
+ * still holds key_count (at least min_keys_per_crypt) candidates, so we
+ * don't trade SIMD or OpenMP efficiency for memory.
+ */
+static void single_init_window(void)
 {
 	struct db_salt *salt;
+	uint64_t max_buffer, total;
+	int max_buffer_GB, *counts, index;
+
+	if ((max_buffer_GB = cfg_get_int(SECTION_OPTIONS, NULL,
+	                                 "SingleMaxBufferSize")) < 0)
+		max_buffer_GB = SINGLE_MAX_WORD_BUFFER;
+	max_buffer = (uint64_t)max_buffer_GB << 30;
+
+	keys_size = sizeof(struct db_keys) - 1 + length * key_count;
+	keys_size = (keys_size + (MEM_ALIGN_WORD - 1)) & ~(MEM_ALIGN_WORD - 1);
+	keys_hash_size = sizeof(struct db_keys_hash) +
+		sizeof(struct db_keys_hash_entry) * (key_count - 1);
+	keys_hash_size = (keys_hash_size + (MEM_ALIGN_WORD - 1)) &
+		~(MEM_ALIGN_WORD - 1);
+
+	total = (uint64_t)single_db->salt_count * (keys_size + keys_hash_size);
+
+/* A restored session keeps its windows, even if the budget has changed */
+	if (!window_bounds) {
+		if (max_buffer && total > max_buffer)
+			window_total = (total + max_buffer - 1) / max_buffer;
+		else
+			window_total = 1;
+		if (window_total > single_db->salt_count)
+			window_total = single_db->salt_count;
+		single_split_windows();
+	}
+	if (!window_guesses)
+		list_init(&window_guesses);
+
+	counts = mem_calloc(window_total, sizeof(int));
+	salt = single_db->salts;
+	do {
+		counts[single_salt_window(salt)]++;
+	} while ((salt = salt->next));
+	window_size = 1;
+	for (index = 0; index < window_total; index++)
+		if (counts[index] > window_size)
+			window_size = counts[index];
+	MEM_FREE(counts);
+
+	if (max_buffer_GB)
+		log_event("- SingleMaxBufferSize = %dGB, %uMB needed for all salts",
+		          max_buffer_GB, (unsigned int)(total >> 20));
+	else
+		log_event("- SingleMaxBufferSize = unlimited, %uMB needed",
+		          (unsigned int)(total >> 20));
+	if (window_total > 1) {
+		log_event("- Processing salts in %d windows of up to %d "
+		          "(%uMB each)", window_total, window_size,
+		          (unsigned int)((uint64_t)window_size *
+		                         (keys_size + keys_hash_size) >> 20));
+		if (john_main_process)
+			fprintf(stderr, "Note: Single mode key buffers for %d "
+			        "salts would need %uMB, processing them in %d "
+			        "windows (see SingleMaxBufferSize)\n",
+			        single_db->salt_count,
+			        (unsigned int)(total >> 20), window_total);
+	}
+
+	keys_pool = mem_alloc((size_t)window_size *
+	                      (keys_size + keys_hash_size));
+	window_salts = mem_alloc(window_size * sizeof(struct db_salt *));
+	window_count = 0;
+}
 
+/*
+ * Hands out pool buffers to the salts of a window.  Returns the number of
+ * salts in the window.
+ */
+static int single_alloc_window(int window)
+{
+	struct db_salt *salt;
+	char *ptr = keys_pool;
+
+	window_count = 0;
+	if ((salt = single_db->salts))
+	do {
+		if (single_salt_window(salt) != window)
+			continue;
+		salt->keys = (struct db_keys *)ptr;
+		salt->keys->hash = (struct db_keys_hash *)(ptr + keys_size);
+		single_alloc_keys(&salt->keys);
+		ptr += keys_size + keys_hash_size;
+		window_salts[window_count++] = salt;
+	} while ((salt = salt->next));
+
+	return window_count;
+}
+
+/*
+ * Takes the pool buffers back from the current window's salts.
+ */
+static void single_free_window(void)
+{
+	int index;
+
+	for (index = 0; index < window_count; index++)
+		window_salts[index]->keys = NULL;
+	window_count = 0;
+}
+
+static void single_init_filter(void)
+{
+	int size_MB;
+
+	if ((size_MB = cfg_get_int(SECTION_OPTIONS, NULL,
+	                           "SingleDupeFilterSize")) <= 0 ||
+	    bloom_init(&dupe_filter, (size_t)size_MB << 20)) {
+		log_event("- No candidate dupe filter");
+		return;
+	}
+
+	dupe_filter_full = 0;
+	log_event("- Candidate dupe filter (lossy) of %dMB, for up to "
+	          LLu " candidates", size_MB,
+	          (unsigned long long)dupe_filter.max_items);
+}
+
+static void single_done_filter(void)
+{
+	if (!dupe_filter.bits)
+		return;
+
+	log_event("- Candidate dupe filter skipped " LLu " of " LLu
+	          " candidates", (unsigned long long)dupe_filter.hits,
+	          (unsigned long long)(dupe_filter.hits + dupe_filter.items));
+
+	bloom_done(&dupe_filter);
+}
+
+static void single_init(void)
+{
 	log_event("Proceeding with \"single crack\" mode");
 
 	if (rec_restored && john_main_process)
@@ -153,24 +455,28 @@ static void single_init(void)
 
 	status_init(get_progress, 0);
 
+	rec_window = window_total = 0;
+	window_bounds = NULL;
+	window_done = NULL;
+	window_guesses = NULL;
+
 	rec_restore_mode(restore_state);
 	rec_init(single_db, save_state);
 
-	salt = single_db->salts;
-	do {
-		single_alloc_keys(&salt->keys);
-	} while ((salt = salt->next));
+	single_init_window();
 
 	if (key_count > 1)
 	log_event("- Allocated %d buffer%s of %d candidate passwords%s",
-		single_db->salt_count,
-		single_db->salt_count != 1 ? "s" : "",
+		window_size,
+		window_size != 1 ? "s" : "",
 		key_count,
-		single_db->salt_count != 1 ? " each" : "");
+		window_size != 1 ? " each" : "");
 
 	guessed_keys = NULL;
 	single_alloc_keys(&guessed_keys);
 
+	single_init_filter();
+
 	crk_init(single_db, NULL, guessed_keys);
 }
 
@@ -231,6 +537,17 @@ static int single_add_key(struct db_salt *salt, char *key, int is_from_guesses)
 			return 0;
 	} while ((index = entry->next) >= 0);
 
+/* Check if we've buffered this key for this salt before (probably) */
+	if (dupe_filter.bits) {
+		if (bloom_check_add(&dupe_filter,
+		    bloom_hash(key, length, salt->sequential_id)))
+			return 0;
+		if (bloom_full(&dupe_filter) && !dupe_filter_full) {
+			log_event("- Candidate dupe filter is full");
+			dupe_filter_full = 1;
+		}
+	}
+
 /* Update the hash table removing the list entry we're about to reuse */
 	index = keys->hash->hash[reuse_hash = single_key_hash(keys->ptr)];
 	if (index == keys->count)
@@ -299,14 +616,28 @@ static int single_process_buffer(struct db_salt *salt)
 
 		keys->ptr = keys->buffer;
 		do {
+			int carry = 0;
+
 			current = single_db->salts;
 			do {
 				if (current == salt || !current->list)
 					continue;
 
+				if (!current->keys) {
+					carry = 1;
+					continue;
+				}
+
 				if (single_add_key(current, keys->ptr, 1))
 					return 1;
 			} while ((current = current->next));
+
+			if (carry) {
+				char word[PLAINTEXT_BUFFER_SIZE + 1];
+
+				strnzcpy(word, keys->ptr, length + 1);
+				list_add_unique(window_guesses, word);
+			}
 			keys->ptr += length;
 		} while (--keys->count);
 
@@ -449,11 +780,11 @@ no_own_words:
 	return 0;
 }
 
-static void single_run(void)
+static int single_run_rules(void)
 {
 	char *prerule, *rule;
 	struct db_salt *salt;
-	int min, saved_min;
+	int index, min, saved_min;
 	int have_words;
 
 	saved_min = rec_rule;
@@ -493,19 +824,20 @@ static void single_run(void)
 		min = rule_number;
 
 		/* pot reload might have removed the salt */
-		if (!(salt = single_db->salts))
-			return;
-		do {
+		if (!single_db->salts)
+			return 1;
+		for (index = 0; index < window_count; index++) {
+			salt = window_salts[index];
 			if (!salt->list)
 				continue;
 			if (single_process_salt(salt, rule))
-				return;
+				return 1;
 			if (!salt->keys->have_words)
 				continue;
 			have_words = 1;
 			if (salt->keys->rule < min)
 				min = salt->keys->rule;
-		} while ((salt = salt->next));
+		}
 
 		if (event_reload && single_db->salts)
 			crk_reload_pot();
@@ -518,32 +850,158 @@ static void single_run(void)
 
 		log_event("- No information to base%s candidate passwords on",
 			rule_number > 1 ? " further" : "");
-		return;
+		return 0;
 	}
+
+	return 0;
 }
 
-static void single_done(void)
+/*
+ * Processes what's left in the current window's buffers.  Retests of passwords
+ * guessed meanwhile may refill buffers already processed, so we go over them
+ * until they're all empty.
+ */
+static int single_flush_window(void)
 {
 	struct db_salt *salt;
+	int index, again;
+
+	do {
+		again = 0;
+		for (index = 0; index < window_count; index++) {
+			salt = window_salts[index];
+			if (!salt->list || !salt->keys->count)
+				continue;
+			again = 1;
+			if (single_process_buffer(salt))
+				return 1;
+		}
+	} while (again);
+
+	return 0;
+}
+
+/*
+ * Retests the guessed passwords not yet tried against the salts of a window,
+ * which must be the one currently holding the buffers.
+ */
+static int single_retest_window(int window)
+{
+	struct list_entry *word;
+	int index, count;
+
+	if (!(count = window_guesses->count - window_done[window]))
+		return 0;
+
+	log_event("- Retesting %d guessed passwords against salt window %d",
+	          count, window + 1);
 
+	word = window_guesses->head;
+	for (index = 0; index < window_done[window]; index++)
+		word = word->next;
+
+	for (; count--; word = word->next)
+	for (index = 0; index < window_count; index++) {
+		struct db_salt *salt = window_salts[index];
+
+		if (!salt->list)
+			continue;
+		if (single_add_key(salt, word->data, 1))
+			return 1;
+	}
+
+/* Anything guessed meanwhile has been buffered for this window's salts */
+	window_done[window] = window_guesses->count;
+
+	return 0;
+}
+
+/*
+ * Goes back to the windows already done, retesting the passwords guessed
+ * since against their salts, until that doesn't guess any more.
+ */
+static int single_revisit_windows(void)
+{
+	int window, again;
+
+	do {
+		again = 0;
+		for (window = 0; window < rec_window; window++) {
+			if (window_done[window] == window_guesses->count)
+				continue;
+			if (!single_db->salts)
+				return 1;
+			if (single_alloc_window(window)) {
+				again = 1;
+				if (single_retest_window(window) ||
+				    single_flush_window())
+					return 1;
+				single_free_window();
+			}
+			window_done[window] = window_guesses->count;
+		}
+	} while (again);
+
+	return 0;
+}
+
+static void single_run(void)
+{
+	for (;;) {
+		if (single_revisit_windows())
+			return;
+		if (rec_window >= window_total || !single_db->salts)
+			return;
+		if (!single_alloc_window(rec_window))
+			goto next;
+
+		if (window_total > 1)
+			log_event("- Salt window %d of %d, %d salts",
+			          rec_window + 1, window_total, window_count);
+
+		if (single_retest_window(rec_window))
+			return;
+
+		if (single_run_rules())
+			return;
+
+		log_event("- Processing the remaining buffered "
+			"candidate passwords%s, if any",
+			window_total > 1 ? " for this window" : "");
+		if (single_flush_window())
+			return;
+		window_done[rec_window] = window_guesses->count;
+
+		single_free_window();
+next:
+		rec_rule = rule_number = 0;
+		if (++rec_window < window_total &&
+		    rpp_init(rule_ctx, options.activesinglerules))
+			return;
+	}
+}
+
+static void single_done(void)
+{
 	if (!event_abort) {
-		if ((salt = single_db->salts)) {
+		if (single_db->salts && window_count) {
 			log_event("- Processing the remaining buffered "
 				"candidate passwords, if any");
 
-			do {
-				if (!salt->list)
-					continue;
-				if (salt->keys->count)
-					if (single_process_buffer(salt))
-						break;
-			} while ((salt = salt->next));
+			single_flush_window();
 		}
 
 		progress = 100;
 	}
 
 	rec_done(event_abort || (status.pass && single_db->salts));
+
+	single_done_filter();
+	MEM_FREE(window_done);
+	MEM_FREE(window_bounds);
+	MEM_FREE(window_salts);
+	MEM_FREE(keys_pool);
+
 	c_cleanup();
 }
 
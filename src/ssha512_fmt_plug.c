@@ -37,6 +37,7 @@ john_register_one(&fmt_saltedsha2);
 #include <omp.h>
 #endif
 
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL                    "SSHA512"
@@ -96,10 +97,7 @@ static void init(struct fmt_main *self)
 	unsigned int i, j;
 #endif
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	saved_len = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*saved_len));
@@ -16,6 +16,9 @@
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+
+#define NEED_OS_FORK
 #include "os.h"
 #if HAVE_SYS_TIMES_H
 #include <sys/times.h>
@@ -23,6 +26,10 @@
 
 #include "times.h"
 
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
+
 #if defined(__GNUC__) && defined(__i386__)
 #include "arch.h" /* for CPU_REQ */
 #endif
@@ -30,6 +37,9 @@
 #include "misc.h"
 #include "math.h"
 #include "params.h"
+#include "memory.h"
+#include "path.h"
+#include "logger.h"
 #include "cracker.h"
 #include "options.h"
 #include "status.h"
@@ -38,6 +48,8 @@
 #include "unicode.h"
 #include "signals.h"
 #include "mask.h"
+#include "recovery.h"
+#include "john.h"
 #ifdef HAVE_MPI
 #include "john-mpi.h"
 #endif
@@ -49,6 +61,7 @@ unsigned int status_restored_time = 0;
 static char* timeFmt = NULL;
 static char* timeFmt24 = NULL;
 static int showcand;
+static int metrics_prom;
 double (*status_get_progress)(void) = NULL;
 
 static clock_t get_time(void)
@@ -81,6 +94,13 @@ void status_init(double (*get_progress)(void), int start)
 
 	showcand = cfg_get_bool(SECTION_OPTIONS, NULL, "StatusShowCandidates", 0);
 
+	{
+		char *format = cfg_get_param(SECTION_OPTIONS, NULL,
+		                             "MetricsFormat");
+
+		metrics_prom = format && !strcasecmp(format, "Prometheus");
+	}
+
 	clk_tck_init();
 }
 
@@ -491,4 +511,247 @@ void status_print(void)
 #else
 		status_print_cracking(percent_value);
 #endif
+
+	if (options.flags & FLG_PROFILE)
+		crk_print_profile(0);
+}
+
+/*
+ * Counters as of the previous metrics update, for the rates over the last
+ * interval.
+ */
+static double metrics_last_time, metrics_last[4];
+
+static double status_get_seconds(void)
+{
+	return status_restored_time +
+		(double)(get_time() - status.start_time) / clk_tck;
+}
+
+static double status_int64(int64 *c, unsigned int c_ehi)
+{
+	return ((double)c_ehi * 4294967296.0 + c->hi) * 4294967296.0 + c->lo;
+}
+
+static void status_put_quoted(FILE *file, char *s)
+{
+	putc('"', file);
+	while (*s) {
+		if (*s == '"' || *s == '\\')
+			putc('\\', file);
+		if ((unsigned char)*s >= 0x20)
+			putc(*s, file);
+		s++;
+	}
+	putc('"', file);
+}
+
+/*
+ * The session name as used for the crash recovery file, including the node
+ * number for other nodes.
+ */
+static char *status_session_name(void)
+{
+	static char *name;
+
+	if (!name) {
+		size_t len = strlen(rec_name);
+		size_t rec_len = strlen(RECOVERY_SUFFIX);
+
+		if (rec_name_completed && len > rec_len &&
+		    !strcmp(rec_name + len - rec_len, RECOVERY_SUFFIX)) {
+			name = mem_alloc_tiny(len - rec_len + 1, MEM_ALIGN_NONE);
+			memcpy(name, rec_name, len - rec_len);
+			name[len - rec_len] = 0;
+		} else
+			name = rec_name;
+	}
+
+	return name;
+}
+
+static void status_write_json(FILE *file, struct db_main *db, int final,
+	double *values, double *rates, double *recent, double elapsed,
+	double progress)
+{
+	static const char *names[] = {
+		"guesses", "candidates", "crypts", "combinations"
+	};
+	int i;
+
+	fprintf(file, "{\n\t\"session\": ");
+	status_put_quoted(file, status_session_name());
+	fprintf(file, ",\n\t\"pid\": %d,\n\t\"node\": %u,\n\t\"nodes\": %u,\n"
+	        "\t\"fork\": %u,\n\t\"time\": %lu,\n\t\"final\": %s,\n"
+	        "\t\"aborted\": %s,\n\t\"elapsed\": %.3f,\n",
+	        (int)getpid(), options.node_min, options.node_count,
+	        options.fork, (unsigned long)time(NULL),
+	        final ? "true" : "false", event_abort ? "true" : "false",
+	        elapsed);
+	if (progress >= 0)
+		fprintf(file, "\t\"progress\": %.4f,\n", progress);
+	else
+		fprintf(file, "\t\"progress\": null,\n");
+
+	for (i = 0; i < 4; i++)
+		fprintf(file, "\t\"%s\": %.0f,\n", names[i], values[i]);
+	for (i = 0; i < 4; i++)
+		fprintf(file, "\t\"%s_per_sec\": %.3f,\n", names[i], rates[i]);
+	for (i = 0; i < 4; i++)
+		fprintf(file, "\t\"%s_per_sec_recent\": %.3f,\n",
+		        names[i], recent[i]);
+
+	if (db && db->loaded) {
+		struct db_salt *salt;
+
+		fprintf(file, "\t\"format\": ");
+		status_put_quoted(file, db->format->params.label);
+		fprintf(file, ",\n\t\"hashes_remaining\": %d,\n"
+		        "\t\"salts_remaining\": %d,\n\t\"salt_position\": %d,\n"
+		        "\t\"salt_hashes_remaining\": [",
+		        db->password_count, db->salt_count, crk_salt_pos);
+		for (i = 0, salt = db->salts; salt && i < METRICS_MAX_SALTS;
+		     salt = salt->next, i++)
+			fprintf(file, "%s%d", i ? ", " : "", salt->count);
+		fprintf(file, "],\n");
+	}
+
+	if (crk_timing) {
+		double times[CRK_PHASES];
+
+		crk_get_phase_times(times);
+		fprintf(file, "\t\"phase_seconds\": {");
+		for (i = 0; i < CRK_PHASES; i++)
+			fprintf(file, "%s \"%s\": %.6f", i ? "," : "",
+			        crk_phase_names[i], times[i]);
+		fprintf(file, " },\n");
+	}
+
+	fprintf(file, "\t\"children\": [");
+#if OS_FORK
+	if (john_main_process)
+	for (i = 0; i < john_child_count; i++)
+		fprintf(file, "%s{ \"node\": %u, \"pid\": %d }", i ? ", " : "",
+		        options.node_min + i + 1, john_child_pids[i]);
+#endif
+	fprintf(file, "]\n}\n");
+}
+
+static void status_write_prom(FILE *file, struct db_main *db, int final,
+	double *values, double *rates, double *recent, double elapsed,
+	double progress)
+{
+	static const char *names[] = {
+		"guesses", "candidates", "crypts", "combinations"
+	};
+	char labels[64];
+	int i;
+
+	sprintf(labels, "node=\"%u\"", options.node_min);
+
+	fprintf(file, "john_info{%s,pid=\"%d\",session=", labels,
+	        (int)getpid());
+	status_put_quoted(file, status_session_name());
+	if (db && db->loaded) {
+		fprintf(file, ",format=");
+		status_put_quoted(file, db->format->params.label);
+	}
+	fprintf(file, "} 1\n");
+	fprintf(file, "john_final{%s} %d\n", labels, final);
+	fprintf(file, "john_elapsed_seconds{%s} %.3f\n", labels, elapsed);
+	if (progress >= 0)
+		fprintf(file, "john_progress_percent{%s} %.4f\n", labels,
+		        progress);
+
+	for (i = 0; i < 4; i++) {
+		fprintf(file, "john_%s_total{%s} %.0f\n", names[i], labels,
+		        values[i]);
+		fprintf(file, "john_%s_per_second{%s} %.3f\n", names[i], labels,
+		        rates[i]);
+		fprintf(file, "john_%s_per_second_recent{%s} %.3f\n", names[i],
+		        labels, recent[i]);
+	}
+
+	if (db && db->loaded) {
+		struct db_salt *salt;
+
+		fprintf(file, "john_hashes_remaining{%s} %d\n", labels,
+		        db->password_count);
+		fprintf(file, "john_salts_remaining{%s} %d\n", labels,
+		        db->salt_count);
+		fprintf(file, "john_salt_position{%s} %d\n", labels,
+		        crk_salt_pos);
+		for (i = 0, salt = db->salts; salt && i < METRICS_MAX_SALTS;
+		     salt = salt->next, i++)
+			fprintf(file, "john_salt_hashes_remaining{%s,salt=\"%d\"} "
+			        "%d\n", labels, i, salt->count);
+	}
+
+	if (crk_timing) {
+		double times[CRK_PHASES];
+
+		crk_get_phase_times(times);
+		for (i = 0; i < CRK_PHASES; i++)
+			fprintf(file, "john_phase_seconds_total{%s,phase=\"%s\"} "
+			        "%.6f\n", labels, crk_phase_names[i], times[i]);
+	}
+
+#if OS_FORK
+	if (john_main_process)
+	for (i = 0; i < john_child_count; i++)
+		fprintf(file, "john_child_pid{%s,child_node=\"%u\"} %d\n",
+		        labels, options.node_min + i + 1, john_child_pids[i]);
+#endif
+}
+
+void status_write_metrics(struct db_main *db, int final)
+{
+	char name[PATH_BUFFER_SIZE + 1], tmp_name[PATH_BUFFER_SIZE + 5];
+	double values[4], rates[4], recent[4];
+	double elapsed, interval, progress;
+	FILE *file;
+	int i;
+
+	elapsed = status_get_seconds();
+
+	values[0] = status.guess_count;
+	values[1] = status_int64(&status.cands, 0);
+	values[2] = status_int64(&status.crypts, 0);
+	values[3] = status_int64(&status.combs, status.combs_ehi);
+
+	interval = elapsed - metrics_last_time;
+	for (i = 0; i < 4; i++) {
+		rates[i] = elapsed > 0 ? values[i] / elapsed : 0;
+		recent[i] = interval > 0 ?
+			(values[i] - metrics_last[i]) / interval : 0;
+		metrics_last[i] = values[i];
+	}
+	metrics_last_time = elapsed;
+
+	progress = -1;
+	if (status_get_progress)
+		progress = status_get_progress();
+
+	snprintf(name, sizeof(name), "%s%s",
+	         path_expand(status_session_name()),
+	         metrics_prom ? METRICS_PROM_SUFFIX : METRICS_JSON_SUFFIX);
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+	if (!(file = fopen(tmp_name, "w"))) {
+		log_event("! Can't write metrics file %s: %s", tmp_name,
+		          strerror(errno));
+		return;
+	}
+
+	if (metrics_prom)
+		status_write_prom(file, db, final, values, rates, recent,
+		                  elapsed, progress);
+	else
+		status_write_json(file, db, final, values, rates, recent,
+		                  elapsed, progress);
+
+	if (fclose(file) || rename(tmp_name, name)) {
+		log_event("! Can't write metrics file %s: %s", name,
+		          strerror(errno));
+		unlink(tmp_name);
+	}
 }
@@ -43,6 +43,7 @@ struct status_main {
 	int progress;
 	int resume_salt;
 	uint32_t *resume_salt_md5;
+	double resume_salt_priority;
 	int resume_salt_crypts_per;
 };
 
@@ -94,4 +95,13 @@ extern unsigned int status_get_time(void);
  */
 extern void status_print(void);
 
+/*
+ * Replaces the session's metrics file (SESSION.json or, with MetricsFormat
+ * set to Prometheus, SESSION.prom; SESSION.N.* for other nodes) with a
+ * snapshot of the current status and of the database, which may be NULL.
+ * Set final when the cracking mode is ending.
+ */
+struct db_main;
+extern void status_write_metrics(struct db_main *db, int final);
+
 #endif
@@ -34,6 +34,7 @@ john_register_one(&fmt_stribog_512);
 #define OMP_SCALE               512 // XXX
 #endif
 #endif
+#include "omp_autotune.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"stribog"
@@ -101,10 +102,7 @@ static uint32_t (*crypt_out)[BINARY_SIZE_512 / sizeof(uint32_t)];
 static void init(struct fmt_main *self)
 {
 #ifdef _OPENMP
-	int omp_t = omp_get_max_threads();
-	self->params.min_keys_per_crypt *= omp_t;
-	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt *= omp_t;
+	omp_autotune(self, OMP_SCALE);
 #endif
 	if (!saved_key) {
 		saved_key = mem_calloc_align(self->params.max_keys_per_crypt, sizeof(*saved_key), MEM_ALIGN_SIMD);
@@ -36,6 +36,13 @@ typedef LARGE_INTEGER hr_timer;
 								   else																		\
 								      (X) = 0.0;															\
 								}
+#elif defined(CLOCK_MONOTONIC)
+typedef struct timespec hr_timer;
+
+#define HRZERO(X)				(X).tv_sec = (X).tv_nsec = 0
+#define HRSETCURRENT(X)			clock_gettime(CLOCK_MONOTONIC, &(X))
+#define HRGETTICKS(X)			((double)(X).tv_sec*1000000000.0+(double)(X).tv_nsec)
+#define HRGETTICKS_PER_SEC(X)	(X) = 1000000000.0
 #else
 #include <sys/time.h>
 typedef struct timeval hr_timer;
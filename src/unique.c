@@ -23,6 +23,13 @@
  *           params.h.  The default is 24 or 25.  valid range from 13 to 25.
  *           25 will use a 2GB memory buffer, and 33 entry million hash table
  *           Each number doubles size.
+ * -unordered  Write unique lines in whatever order they come out of the
+ *           hash buckets, instead of in order of first occurrence.  Saves
+ *           the final merge pass and 8 bytes per line of temporary disk.
+ *
+ * Temporary bucket files are created next to OUTPUT-FILE, so that file
+ * system needs free space for about the size of the input.  Buckets are
+ * deduped using all OpenMP threads, sharing the -mem= memory.
  */
 
 #if AC_BUILT
@@ -38,6 +45,18 @@
 #include <fcntl.h>
 #endif
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
+#if !_MSC_VER && !__MINGW32__
+#include <sys/resource.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #ifdef _MSC_VER
 #include <io.h>
 #pragma warning ( disable : 4996 )
@@ -49,132 +68,224 @@
 #include "params.h"
 #include "memory.h"
 #include "jumbo.h"
+#include "bloom.h"
 #include "memdbg.h"
 
-#define ENTRY_END_HASH			0xFFFFFFFF /* also hard-coded */
-#define ENTRY_END_LIST			0xFFFFFFFE
-#define ENTRY_DUPE			0xFFFFFFFD
+/*
+ * Input lines are hash partitioned into bucket files next to the output file,
+ * then each bucket is deduped in memory on its own.  A bucket that doesn't
+ * fit is split again (with a different hash) rather than processed in passes,
+ * so the total work is linear in the input size.
+ *
+ * Bucket records are a 16-bit length (with REC_EXCLUDE set for lines from an
+ * -ex_file), then unless -unordered the line's 64-bit sequence number, then
+ * the line itself.  Each bucket's surviving lines are still in input order, so
+ * first occurrence order is restored by merging the buckets on that number.
+ */
+#define REC_EXCLUDE			0x8000
+
+/* Most buckets we split into at once, and how many for input from a pipe */
+#define UNIQUE_MAX_BUCKETS		0x100
+#define UNIQUE_PIPE_BUCKETS		0x10
+
+/*
+ * Open files we leave for stdio, the input, output and -ex_file files, out
+ * of the limit on open files.  Each thread splitting a bucket has the bucket
+ * plus split_buckets files open at once, or split_buckets plus the output
+ * when merging them.
+ */
+#define UNIQUE_RESERVED_FILES		16
+#define UNIQUE_FILES_PER_SPLIT		2
 
-static struct {
+/* Entry ends a hash chain */
+#define ENTRY_END_HASH			0xFFFFFFFF
+
+/* Entry size, not counting the line */
+#define ENTRY_HEADER_SIZE \
+	(sizeof(unsigned int) + sizeof(unsigned long long) + 1)
+
+/* Per thread in-memory dedupe state */
+struct unique_arena {
 	unsigned int *hash;
 	char *data;
-} buffer;
+	unsigned int hash_mask, size;
+};
+
+static struct unique_arena *arenas;
+static int num_arenas, num_buckets, split_buckets, keep_order = 1;
 
 static FILE *fpInput;
 static FILE *output;
 static FILE *use_to_unique_but_not_add;
 static int do_not_unique_against_self=0;
+static char *output_name;
+
+/* Temporary files we've created, to remove when exiting early */
+struct unique_temp {
+	struct unique_temp *next;
+	char name[1];
+};
+static struct unique_temp *temp_files;
 
 long long totLines=0,written_lines=0;
 int verbose=0, cut_len=0, LM=0;
 unsigned int vUNIQUE_HASH_LOG=UNIQUE_HASH_LOG, vUNIQUE_HASH_SIZE=UNIQUE_HASH_SIZE, vUNIQUE_BUFFER_SIZE=UNIQUE_BUFFER_SIZE;
-unsigned int vUNIQUE_HASH_MASK = UNIQUE_HASH_SIZE - 1;
-unsigned int vUNIQUE_HASH_LOG_HALF = UNIQUE_HASH_LOG / 2;
-
-#if ARCH_ALLOWS_UNALIGNED && !ARCH_INT_GT_32
 
-#define get_int(ptr) \
-	(*(ptr))
+static void upcase(char *cp) {
+	while (*cp) {
+		if (*cp >= 'a' && *cp <= 'z')
+			*cp -= 0x20;
+		++cp;
+	}
+}
 
-#define put_int(ptr, value) \
-	*(ptr) = (value);
+static void put_rec(FILE *file, unsigned long long seq, const char *line,
+                    unsigned int length, unsigned int flags)
+{
+	unsigned short header = length | flags;
 
-#else
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    (keep_order && fwrite(&seq, sizeof(seq), 1, file) != 1) ||
+	    (length && fwrite(line, length, 1, file) != 1))
+		pexit("fwrite");
+}
 
-static unsigned int get_int(unsigned int *ptr)
+/* Returns the line length, or -1 at end of file */
+static int get_rec(FILE *file, unsigned long long *seq, char *line,
+                   unsigned int *flags)
 {
-	unsigned char *bytes = (unsigned char *)ptr;
+	unsigned short header;
+	unsigned int length;
 
-	return
-		(unsigned int)bytes[0] |
-		((unsigned int)bytes[1] << 8) |
-		((unsigned int)bytes[2] << 16) |
-		((unsigned int)bytes[3] << 24);
+	if (fread(&header, sizeof(header), 1, file) != 1) {
+		if (ferror(file)) pexit("fread");
+		return -1;
+	}
+	length = header & ~REC_EXCLUDE;
+	*flags = header & REC_EXCLUDE;
+
+	*seq = 0;
+	if ((keep_order && fread(seq, sizeof(*seq), 1, file) != 1) ||
+	    (length && fread(line, length, 1, file) != 1))
+		pexit("fread");
+	line[length] = 0;
+
+	return length;
 }
 
-static void put_int(unsigned int *ptr, unsigned int value)
+static unsigned int bucket_of(const char *line, int length, int depth,
+                              int count)
 {
-	unsigned char *bytes = (unsigned char *)ptr;
-
-	bytes[0] = value;
-	bytes[1] = value >> 8;
-	bytes[2] = value >> 16;
-	bytes[3] = value >> 24;
+	return bloom_hash(line, length, depth) & (count - 1);
 }
 
-#endif
+/*
+ * Removes the temporary files left, when we're exiting through pexit(),
+ * error() or a signal rather than unique_done().
+ */
+static void unique_cleanup(void)
+{
+	struct unique_temp *temp;
 
-#define get_data(ptr) \
-	get_int((unsigned int *)&buffer.data[ptr])
+	for (temp = temp_files; temp; temp = temp->next)
+		unlink(temp->name);
+}
 
-#define put_data(ptr, value) \
-	put_int((unsigned int *)&buffer.data[ptr], value)
+static void unique_signal(int signum)
+{
+	unique_cleanup();
+	signal(signum, SIG_DFL);
+	raise(signum);
+}
 
-static unsigned int line_hash(char *line)
+static FILE *open_file(const char *name, const char *mode)
 {
-	unsigned int hash, extra;
-	char *p;
-
-	p = line + 2;
-	hash = (unsigned char)line[0];
-	if (!hash)
-		goto out;
-	extra = (unsigned char)line[1];
-	if (!extra)
-		goto out;
-
-	while (*p) {
-		hash <<= 3; extra <<= 2;
-		hash += (unsigned char)p[0];
-		if (!p[1]) break;
-		extra += (unsigned char)p[1];
-		p += 2;
-		if (hash & 0xe0000000) {
-			hash ^= hash >> vUNIQUE_HASH_LOG;
-			extra ^= extra >> vUNIQUE_HASH_LOG;
-			hash &= vUNIQUE_HASH_MASK;
+	FILE *file;
+
+	if (*mode == 'w') {
+		struct unique_temp *temp;
+
+		temp = mem_alloc(sizeof(*temp) + strlen(name));
+		strcpy(temp->name, name);
+#ifdef _OPENMP
+#pragma omp critical (unique_temp)
+#endif
+		{
+			temp->next = temp_files;
+			temp_files = temp;
 		}
 	}
 
-	hash -= extra;
-	hash ^= extra << vUNIQUE_HASH_LOG_HALF;
-
-	hash ^= hash >> vUNIQUE_HASH_LOG;
+	if (!(file = fopen(name, mode))) {
+		if (errno == EMFILE || errno == ENFILE) {
+			fprintf(stderr, "fopen: %s: %s\n"
+			        "Too many bucket files open at once, try a "
+			        "higher open files limit (ulimit -n) or fewer "
+			        "threads (OMP_NUM_THREADS)\n",
+			        name, strerror(errno));
+			error();
+		}
+		pexit("fopen: %s", name);
+	}
 
-	hash &= vUNIQUE_HASH_MASK;
-out:
-	return hash;
+	return file;
 }
 
-static void init_hash(void)
+static FILE *open_bucket(char *name, const char *parent, int index)
 {
-#if 0
-	int index;
+	sprintf(name, "%s.%02x", parent, index);
 
-	for (index = 0; index < vUNIQUE_HASH_SIZE; index++)
-		buffer.hash[index] = ENTRY_END_HASH;
-#else
-/* ENTRY_END_HASH is 0xFFFFFFFF */
-	memset(buffer.hash, 0xff, vUNIQUE_HASH_SIZE * sizeof(unsigned int));
-#endif
+	return open_file(name, "wb+");
 }
 
-static void upcase(char *cp) {
-	while (*cp) {
-		if (*cp >= 'a' && *cp <= 'z')
-			*cp -= 0x20;
-		++cp;
+/*
+ * Returns how many files we may have open, raising the soft limit as far as
+ * the hard limit allows.
+ */
+static int max_open_files(void)
+{
+	int max = 0x400;
+#if !_MSC_VER && !__MINGW32__
+	struct rlimit rl;
+
+	if (!getrlimit(RLIMIT_NOFILE, &rl)) {
+		if (rl.rlim_cur != rl.rlim_max) {
+			struct rlimit want = rl;
+
+			want.rlim_cur = rl.rlim_max;
+			if (!setrlimit(RLIMIT_NOFILE, &want))
+				rl = want;
+		}
+		if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > 0x10000)
+			max = 0x10000;
+		else
+			max = rl.rlim_cur;
 	}
+#endif
+	return max - UNIQUE_RESERVED_FILES;
 }
 
-static void read_buffer(void)
+/*
+ * Reads the -ex_file lines and then the input lines into the top level
+ * buckets.
+ */
+static void partition_input(FILE **buckets)
 {
 	char line[LINE_BUFFER_SIZE];
-	unsigned int ptr, current, *last;
+	unsigned long long seq = 0;
+	int length;
 
-	init_hash();
+	if (use_to_unique_but_not_add) {
+		while (fgetl(line, sizeof(line), use_to_unique_but_not_add)) {
+			if (cut_len) line[cut_len] = 0;
+			length = strlen(line);
+			put_rec(buckets[bucket_of(line, length, 0,
+			                          num_buckets)],
+			        0, line, length, REC_EXCLUDE);
+		}
+		if (ferror(use_to_unique_but_not_add)) pexit("fgets");
+	}
 
-	ptr = 0;
 	while (fgetl(line, sizeof(line), fpInput)) {
 		char LM_Buf[8];
 		if (LM) {
@@ -190,148 +301,326 @@ static void read_buffer(void)
 			upcase(line);
 		} else if (cut_len) line[cut_len] = 0;
 		++totLines;
-		last = &buffer.hash[line_hash(line)];
-#if ARCH_LITTLE_ENDIAN && !ARCH_INT_GT_32
-		current = *last;
-#else
-		current = get_int(last);
-#endif
-		while (current != ENTRY_END_HASH) {
-			if (!strcmp(line, &buffer.data[current + 4])) break;
-			last = (unsigned int *)&buffer.data[current];
-			current = get_int(last);
-		}
-		if (current != ENTRY_END_HASH) {
-			if (LM && *LM_Buf)
-				goto DoExtraLM;
-			continue;
-		}
 
-		put_int(last, ptr);
+		length = strlen(line);
+		put_rec(buckets[bucket_of(line, length, 0, num_buckets)],
+		        seq++, line, length, 0);
 
-		put_data(ptr, ENTRY_END_HASH);
-		ptr += 4;
+		if (LM && *LM_Buf) {
+			length = strlen(LM_Buf);
+			put_rec(buckets[bucket_of(LM_Buf, length, 0,
+			                          num_buckets)], seq++,
+			        LM_Buf, length, 0);
+		}
 
-		strcpy(&buffer.data[ptr], line);
-		ptr += strlen(line) + 1;
+		if (verbose && !(totLines & 0xFFFFF))
+			printf("\rTotal lines read "LLu"\r", totLines);
+	}
 
-		if (ptr > vUNIQUE_BUFFER_SIZE - sizeof(line) - 8) break;
+	if (ferror(fpInput)) pexit("fgets");
+}
 
-DoExtraLM:;
-		if (LM && *LM_Buf) {
-			last = &buffer.hash[line_hash(LM_Buf)];
-#if ARCH_LITTLE_ENDIAN && !ARCH_INT_GT_32
-			current = *last;
-#else
-			current = get_int(last);
-#endif
-			while (current != ENTRY_END_HASH) {
-				if (!strcmp(LM_Buf, &buffer.data[current + 4])) break;
-				last = (unsigned int *)&buffer.data[current];
-				current = get_int(last);
+/*
+ * Merges the (sequence ordered) survivor files of n buckets, either into
+ * another survivor file or, if to_text is set, as plain lines.
+ */
+static void merge_buckets(FILE *out, char *names, int n, int to_text)
+{
+	char (*lines)[LINE_BUFFER_SIZE];
+	unsigned long long *seqs;
+	unsigned int flags;
+	int *lengths, *heap;
+	FILE **files;
+	int i, count = 0;
+
+	files = mem_alloc(n * sizeof(*files));
+	lines = mem_alloc(n * sizeof(*lines));
+	seqs = mem_alloc(n * sizeof(*seqs));
+	lengths = mem_alloc(n * sizeof(*lengths));
+	heap = mem_alloc(n * sizeof(*heap));
+
+/* Binary min-heap of the files' current records, keyed by sequence number */
+#define heap_less(a, b) (seqs[heap[a]] < seqs[heap[b]])
+#define heap_swap(a, b) \
+	{ int tmp = heap[a]; heap[a] = heap[b]; heap[b] = tmp; }
+
+	for (i = 0; i < n; i++) {
+		char *name = &names[i * PATH_BUFFER_SIZE];
+
+		files[i] = open_file(name, "rb");
+		if ((lengths[i] = get_rec(files[i], &seqs[i], lines[i],
+		    &flags)) >= 0) {
+			int pos = count++;
+
+			heap[pos] = i;
+			while (pos && heap_less(pos, (pos - 1) / 2)) {
+				heap_swap(pos, (pos - 1) / 2);
+				pos = (pos - 1) / 2;
 			}
-			if (current != ENTRY_END_HASH) continue;
+		}
+	}
+
+	while (count) {
+		int pos = 0, top = heap[0];
 
-			put_int(last, ptr);
+		if (to_text) {
+			lines[top][lengths[top]] = '\n';
+			if (fwrite(lines[top], lengths[top] + 1, 1, out) != 1)
+				pexit("fwrite");
+			++written_lines;
+		} else
+			put_rec(out, seqs[top], lines[top], lengths[top], 0);
 
-			put_data(ptr, ENTRY_END_HASH);
-			ptr += 4;
+		if ((lengths[top] = get_rec(files[top], &seqs[top], lines[top],
+		    &flags)) < 0)
+			heap[0] = heap[--count];
 
-			strcpy(&buffer.data[ptr], LM_Buf);
-			ptr += strlen(LM_Buf) + 1;
+		while (1) {
+			int child = 2 * pos + 1;
 
-			if (ptr > vUNIQUE_BUFFER_SIZE - sizeof(line) - 8) break;
+			if (child >= count)
+				break;
+			if (child + 1 < count && heap_less(child + 1, child))
+				child++;
+			if (!heap_less(child, pos))
+				break;
+			heap_swap(child, pos);
+			pos = child;
 		}
 	}
+#undef heap_less
+#undef heap_swap
 
-	if (ferror(fpInput)) pexit("fgets");
+	for (i = 0; i < n; i++) {
+		fclose(files[i]);
+		unlink(&names[i * PATH_BUFFER_SIZE]);
+	}
 
-	put_data(ptr, ENTRY_END_LIST);
+	MEM_FREE(heap);
+	MEM_FREE(lengths);
+	MEM_FREE(seqs);
+	MEM_FREE(lines);
+	MEM_FREE(files);
 }
 
-static void write_buffer(void)
+/*
+ * Dedupes one bucket file, then deletes it.  If keeping the order, survivors
+ * go to a file named as the bucket plus ".s" for merging by our caller,
+ * otherwise they are written straight to the output.
+ */
+static void unique_bucket(struct unique_arena *arena, const char *name,
+                          int depth)
 {
-	unsigned int ptr, hash;
-
-	ptr = 0;
-	while ((hash = get_data(ptr)) != ENTRY_END_LIST) {
-		unsigned int length, size;
-		ptr += 4;
-		length = strlen(&buffer.data[ptr]);
-		size = length + 1;
-		if (hash != ENTRY_DUPE) {
-			++written_lines;
-			buffer.data[ptr + length] = '\n';
-			if (fwrite(&buffer.data[ptr], size, 1, output) != 1)
-				pexit("fwrite");
+	char line[LINE_BUFFER_SIZE];
+	unsigned long long seq;
+	unsigned int flags, ptr = 0;
+	int length, full = 0;
+	FILE *file;
+
+	file = open_file(name, "rb");
+
+/* ENTRY_END_HASH is 0xFFFFFFFF */
+	memset(arena->hash, 0xff, (arena->hash_mask + 1) * sizeof(unsigned int));
+
+	while ((length = get_rec(file, &seq, line, &flags)) >= 0) {
+		unsigned int current, *last;
+
+		last = &arena->hash[(bloom_hash(line, length, depth) >> 32) &
+		                    arena->hash_mask];
+
+		while ((current = *last) != ENTRY_END_HASH) {
+			if (!strcmp(line, &arena->data[current +
+			    ENTRY_HEADER_SIZE]))
+				break;
+			last = (unsigned int *)&arena->data[current];
 		}
-		ptr += size;
+		if (current != ENTRY_END_HASH)
+			continue;
+
+		if (ptr + ENTRY_HEADER_SIZE + length + 1 > arena->size) {
+			full = 1;
+			break;
+		}
+
+/* With -ex_file_only, input lines are only checked, not added */
+		if (flags || !do_not_unique_against_self)
+			*last = ptr;
+		current = ENTRY_END_HASH;
+		memcpy(&arena->data[ptr], &current, sizeof(current));
+		memcpy(&arena->data[ptr + sizeof(current)], &seq, sizeof(seq));
+		arena->data[ptr + ENTRY_HEADER_SIZE - 1] = flags ? 1 : 0;
+		memcpy(&arena->data[ptr + ENTRY_HEADER_SIZE], line, length + 1);
+		ptr = (ptr + ENTRY_HEADER_SIZE + length + 1 + 3) & ~3U;
 	}
-}
 
-static void clean_buffer(void)
-{
-	char line[LINE_BUFFER_SIZE];
-	unsigned int current, *last;
+	if (full) {
+		char *names = mem_alloc(split_buckets * PATH_BUFFER_SIZE);
+		FILE **buckets = mem_alloc(split_buckets * sizeof(*buckets));
+		int i;
 
-	if (use_to_unique_but_not_add) {
-		if (fseek(use_to_unique_but_not_add, 0, SEEK_SET) < 0) pexit("fseek");
-		while (fgetl(line, sizeof(line), use_to_unique_but_not_add)) {
-			if (cut_len) line[cut_len] = 0;
-			last = &buffer.hash[line_hash(line)];
-#if ARCH_LITTLE_ENDIAN && !ARCH_INT_GT_32
-			current = *last;
-#else
-			current = get_int(last);
-#endif
-			while (current != ENTRY_END_HASH) {
-				if (current != ENTRY_DUPE && !strcmp(line, &buffer.data[current + 4])) {
-					put_int(last, get_data(current));
-					put_data(current, ENTRY_DUPE);
-					break;
-				}
-				last = (unsigned int *)&buffer.data[current];
-				current = get_int(last);
-			}
+		if (verbose)
+			printf("Splitting %s\n", name);
+
+		if (fseek(file, 0, SEEK_SET) < 0) pexit("fseek");
+		for (i = 0; i < split_buckets; i++)
+			buckets[i] = open_bucket(&names[i * PATH_BUFFER_SIZE],
+			                         name, i);
+		while ((length = get_rec(file, &seq, line, &flags)) >= 0)
+			put_rec(buckets[bucket_of(line, length, depth + 1,
+			                          split_buckets)],
+			        seq, line, length, flags);
+		for (i = 0; i < split_buckets; i++)
+			if (fclose(buckets[i])) pexit("fclose");
+		fclose(file);
+		unlink(name);
+
+		for (i = 0; i < split_buckets; i++)
+			unique_bucket(arena, &names[i * PATH_BUFFER_SIZE],
+			              depth + 1);
+
+		if (keep_order) {
+			char out_name[PATH_BUFFER_SIZE];
+			FILE *out;
+
+			for (i = 0; i < split_buckets; i++)
+				strcat(&names[i * PATH_BUFFER_SIZE], ".s");
+			sprintf(out_name, "%s.s", name);
+			out = open_file(out_name, "wb");
+			merge_buckets(out, names, split_buckets, 0);
+			if (fclose(out)) pexit("fclose");
 		}
+
+		MEM_FREE(buckets);
+		MEM_FREE(names);
+		return;
 	}
 
-	if (do_not_unique_against_self)
-	  return;
+	fclose(file);
+	unlink(name);
 
-	if (fseek(output, 0, SEEK_SET) < 0) pexit("fseek");
+	if (keep_order) {
+		char out_name[PATH_BUFFER_SIZE];
+		FILE *out;
+		unsigned int pos = 0;
 
-	while (fgetl(line, sizeof(line), output)) {
-		if (cut_len) line[cut_len] = 0;
-		last = &buffer.hash[line_hash(line)];
-#if ARCH_LITTLE_ENDIAN && !ARCH_INT_GT_32
-		current = *last;
-#else
-		current = get_int(last);
+		sprintf(out_name, "%s.s", name);
+		out = open_file(out_name, "wb");
+		while (pos < ptr) {
+			char *entry = &arena->data[pos + ENTRY_HEADER_SIZE];
+
+			length = strlen(entry);
+			if (!entry[-1]) {
+				memcpy(&seq, &arena->data[pos + sizeof(int)],
+				       sizeof(seq));
+				put_rec(out, seq, entry, length, 0);
+			}
+			pos = (pos + ENTRY_HEADER_SIZE + length + 1 + 3) & ~3U;
+		}
+		if (fclose(out)) pexit("fclose");
+	} else {
+		unsigned int pos = 0, dst = 0;
+
+/* Compact the survivors into plain lines, then write them in one go */
+		while (pos < ptr) {
+			char *entry = &arena->data[pos + ENTRY_HEADER_SIZE];
+			int excluded = entry[-1];
+
+			length = strlen(entry);
+			pos = (pos + ENTRY_HEADER_SIZE + length + 1 + 3) & ~3U;
+			if (!excluded) {
+				memmove(&arena->data[dst], entry, length);
+				dst += length;
+				arena->data[dst++] = '\n';
+#ifdef _OPENMP
+#pragma omp atomic
 #endif
-		while (current != ENTRY_END_HASH && current != ENTRY_DUPE) {
-			if (!strcmp(line, &buffer.data[current + 4])) {
-				put_int(last, get_data(current));
-				put_data(current, ENTRY_DUPE);
-				break;
+				++written_lines;
 			}
-			last = (unsigned int *)&buffer.data[current];
-			current = get_int(last);
+		}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		{
+			if (dst && fwrite(arena->data, dst, 1, output) != 1)
+				pexit("fwrite");
 		}
 	}
-
-	if (ferror(output)) pexit("fgets");
-
-/* Workaround a Solaris stdio bug */
-	if (fseek(output, 0, SEEK_END) < 0) pexit("fseek");
 }
 
 static void unique_init(char *name)
 {
-	int fd;
+	struct stat st;
+	unsigned int hash_size = vUNIQUE_HASH_SIZE;
+	int fd, i, max_files = max_open_files();
 
-	buffer.hash = mem_alloc(vUNIQUE_HASH_SIZE * sizeof(unsigned int));
-	buffer.data = mem_alloc(vUNIQUE_BUFFER_SIZE);
+#ifdef _OPENMP
+	num_arenas = omp_get_max_threads();
+#else
+	num_arenas = 1;
+#endif
+/* Don't go below the smallest -mem= per thread */
+	while (num_arenas > 1 && hash_size / num_arenas < (1 << 13))
+		num_arenas--;
+/* Nor below splitting into 2 buckets per thread */
+	while (num_arenas > 1 &&
+	       num_arenas * (2 + UNIQUE_FILES_PER_SPLIT) > max_files)
+		num_arenas--;
+	hash_size = vUNIQUE_HASH_SIZE / num_arenas;
+
+	arenas = mem_alloc(num_arenas * sizeof(*arenas));
+	for (i = 0; i < num_arenas; i++) {
+		arenas[i].hash_mask = 1;
+		while (arenas[i].hash_mask <= hash_size / 2)
+			arenas[i].hash_mask <<= 1;
+		arenas[i].hash =
+			mem_alloc(arenas[i].hash_mask * sizeof(unsigned int));
+		arenas[i].hash_mask--;
+		arenas[i].size = vUNIQUE_BUFFER_SIZE / num_arenas;
+		arenas[i].data = mem_alloc(arenas[i].size);
+	}
+
+/*
+ * Aim for buckets half the size of an arena, as entries take more memory
+ * than the records they came from.  We don't know the size of piped input,
+ * so then we use a few buckets and split those that turn out too large.
+ */
+	num_buckets = UNIQUE_PIPE_BUCKETS;
+	if (!fstat(fileno(fpInput), &st) && S_ISREG(st.st_mode)) {
+		unsigned long long size = st.st_size;
+
+		num_buckets = 1;
+		while (num_buckets < UNIQUE_MAX_BUCKETS &&
+		       size / num_buckets > arenas[0].size / 2)
+			num_buckets <<= 1;
+		while (num_buckets < num_arenas &&
+		       num_buckets < UNIQUE_MAX_BUCKETS)
+			num_buckets <<= 1;
+	}
+
+/*
+ * The top level buckets are written and merged by one thread, but buckets
+ * split at the same time by all threads have to fit the limit together.
+ */
+	while (num_buckets > 2 && num_buckets > max_files)
+		num_buckets >>= 1;
+	split_buckets = UNIQUE_MAX_BUCKETS;
+	while (split_buckets > 2 && num_arenas *
+	       (split_buckets + UNIQUE_FILES_PER_SPLIT) > max_files)
+		split_buckets >>= 1;
+
+	if (verbose)
+		printf("Using %d bucket%s (split into %d), %d thread%s\n",
+		       num_buckets, num_buckets > 1 ? "s" : "", split_buckets,
+		       num_arenas, num_arenas > 1 ? "s" : "");
+
+	output_name = name;
+
+	atexit(unique_cleanup);
+	signal(SIGINT, unique_signal);
+	signal(SIGTERM, unique_signal);
+#ifdef SIGHUP
+	signal(SIGHUP, unique_signal);
+#endif
 
 #if defined (_MSC_VER) || defined(__MINGW32__)
 	fd = open(name, O_RDWR | O_CREAT | O_EXCL | O_BINARY, 0600);
@@ -345,29 +634,72 @@ static void unique_init(char *name)
 
 static void unique_run(void)
 {
-	read_buffer();
-	if (use_to_unique_but_not_add)
-	  clean_buffer();
-	write_buffer();
+	char *names = mem_alloc(num_buckets * PATH_BUFFER_SIZE);
+	FILE **buckets = mem_alloc(num_buckets * sizeof(*buckets));
+	int i, done = 0;
 
-	while (!feof(fpInput)) {
-		read_buffer();
-		clean_buffer();
-		write_buffer();
+	for (i = 0; i < num_buckets; i++)
+		buckets[i] = open_bucket(&names[i * PATH_BUFFER_SIZE],
+		                         output_name, i);
 
-		if (verbose)
-			printf("\rTotal lines read "LLu" Unique lines written "LLu"\r", totLines, written_lines);
+	partition_input(buckets);
+
+	for (i = 0; i < num_buckets; i++)
+		if (fclose(buckets[i])) pexit("fclose");
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(num_arenas)
+#endif
+	for (i = 0; i < num_buckets; i++) {
+#ifdef _OPENMP
+		struct unique_arena *arena = &arenas[omp_get_thread_num()];
+#else
+		struct unique_arena *arena = &arenas[0];
+#endif
+
+		unique_bucket(arena, &names[i * PATH_BUFFER_SIZE], 1);
+
+		if (verbose) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+			printf("\rBuckets done %d/%d\r", ++done, num_buckets);
+		}
+	}
+
+	if (keep_order) {
+		for (i = 0; i < num_buckets; i++)
+			strcat(&names[i * PATH_BUFFER_SIZE], ".s");
+		merge_buckets(output, names, num_buckets, 1);
 	}
+
+	MEM_FREE(buckets);
+	MEM_FREE(names);
 }
 
 static void unique_done(void)
 {
+	int i;
+
+	for (i = 0; i < num_arenas; i++) {
+		MEM_FREE(arenas[i].data);
+		MEM_FREE(arenas[i].hash);
+	}
+	MEM_FREE(arenas);
+
 	if (fclose(output)) pexit("fclose");
+
+	while (temp_files) {
+		struct unique_temp *temp = temp_files;
+
+		temp_files = temp->next;
+		MEM_FREE(temp);
+	}
 }
 
 int unique(int argc, char **argv)
 {
-	while (argc > 2 && (!strcmp(argv[1], "-v") || !strncmp(argv[1], "-inp=", 5) || !strncmp(argv[1], "-cut=", 5) || !strncmp(argv[1], "-mem=", 5))) {
+	while (argc > 2 && (!strcmp(argv[1], "-v") || !strncmp(argv[1], "-inp=", 5) || !strncmp(argv[1], "-cut=", 5) || !strncmp(argv[1], "-mem=", 5) || !strcmp(argv[1], "-unordered"))) {
 		int i;
 		if (!strcmp(argv[1], "-v"))
 		{
@@ -376,6 +708,13 @@ int unique(int argc, char **argv)
 			for (i = 1; i < argc; ++i)
 				argv[i] = argv[i+1];
 		}
+		else if (!strcmp(argv[1], "-unordered"))
+		{
+			keep_order = 0;
+			--argc;
+			for (i = 1; i < argc; ++i)
+				argv[i] = argv[i+1];
+		}
 		else if (!strncmp(argv[1], "-inp=", 5))
 		{
 			fpInput = fopen(&argv[1][5], "rb");
@@ -423,8 +762,6 @@ int unique(int argc, char **argv)
 			vUNIQUE_HASH_LOG = len;
 			vUNIQUE_HASH_SIZE = (1 << vUNIQUE_HASH_LOG);
 			vUNIQUE_BUFFER_SIZE = 64 * vUNIQUE_HASH_SIZE;
-			vUNIQUE_HASH_MASK = vUNIQUE_HASH_SIZE - 1;
-			vUNIQUE_HASH_LOG_HALF = vUNIQUE_HASH_LOG / 2;
 		}
 	}
 	if (argc == 3 && !strncmp(argv[2], "-ex_file=", 9)) {
@@ -446,7 +783,7 @@ int unique(int argc, char **argv)
 #if defined (__MINGW32__)
 	    puts("");
 #endif
-		printf("Usage: unique [-v] [-inp=fname] [-cut=len] [-mem=num] OUTPUT-FILE [-ex_file=FNAME2] [-ex_file_only=FNAME2]\n\n"
+		printf("Usage: unique [-v] [-inp=fname] [-cut=len] [-mem=num] [-unordered] OUTPUT-FILE [-ex_file=FNAME2] [-ex_file_only=FNAME2]\n\n"
 			 "       reads from stdin 'normally', but can be overridden by optional -inp=\n"
 			 "       If -ex_file=XX is used, then data from file XX is also used to\n"
 			 "       unique the data, but nothing is ever written to XX. Thus, any data in\n"
@@ -458,6 +795,8 @@ int unique(int argc, char **argv)
 			 "       params.h.  The default is %u.  Valid range is from 13 to 25 (memory usage\n"
 			 "       doubles each number).  If you go TOO large, unique will swap and thrash and\n"
 			 "       work VERY slow\n"
+			 "       -unordered  Don't keep the lines in order of first occurrence, which\n"
+			 "       is somewhat faster and needs less temporary disk space\n"
 			 "\n"
 			 "       -v is for 'verbose' mode, outputs line counts during the run\n",
 			UNIQUE_HASH_LOG);
@@ -0,0 +1 @@
+#define JTR_GIT_VERSION "522f6e1+"
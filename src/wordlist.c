@@ -80,6 +80,7 @@
 #include "unicode.h"
 #include "regex.h"
 #include "mask.h"
+#include "bloom.h"
 #include "pseudo_intrinsics.h"
 #include "memdbg.h"
 
@@ -579,6 +580,234 @@ static MAYBE_INLINE int wbuf_unique(char *line)
 	return 1;
 }
 
+/*
+ * Suppression of duplicate candidates produced by rules.  We keep 64-bit
+ * fingerprints of candidates (as truncated to the format's length) in an
+ * open addressing table sized to DupeSuppressionMemory.  Once it's 3/4 full,
+ * we stop adding to it but keep checking against what we have - the earlier
+ * rules (typically a no-op first) are the likeliest source of dupes anyway.
+ */
+static struct {
+	uint64_t *fp;
+	uint64_t mask, count, max_count;
+	uint64_t hits, crypts;
+} rules_dupe;
+
+static void rules_dupe_init(void)
+{
+	int size_MB;
+	uint64_t size = 1;
+
+	if ((size_MB = cfg_get_int(SECTION_OPTIONS, NULL,
+	                           "DupeSuppressionMemory")) < 0)
+		size_MB = DUPE_SUPPRESSION_MEMORY;
+	if (!size_MB)
+		return;
+
+	while ((size << 1) <= ((uint64_t)size_MB << 20) / sizeof(uint64_t))
+		size <<= 1;
+
+	rules_dupe.fp = mem_calloc(size, sizeof(uint64_t));
+	rules_dupe.mask = size - 1;
+	rules_dupe.max_count = size - (size >> 2);
+
+	log_event("- Rules dupe suppression: %dMB, for up to "LLu
+	          " candidates", size_MB,
+	          (unsigned long long)rules_dupe.max_count);
+}
+
+static MAYBE_INLINE int rules_dupe_unique(char *word, int salt_count)
+{
+	uint64_t fp = bloom_hash(word, length, 0);
+	uint64_t index = fp & rules_dupe.mask;
+
+	/* Zero marks an empty slot */
+	if (!fp)
+		fp = 1;
+
+	while (rules_dupe.fp[index]) {
+		if (rules_dupe.fp[index] == fp) {
+			rules_dupe.hits++;
+			rules_dupe.crypts += salt_count;
+			return 0;
+		}
+		index = (index + 1) & rules_dupe.mask;
+	}
+
+	if (rules_dupe.count < rules_dupe.max_count) {
+		rules_dupe.fp[index] = fp;
+		if (++rules_dupe.count == rules_dupe.max_count)
+			log_event("- Rules dupe suppression table is full");
+	}
+
+	return 1;
+}
+
+static void rules_dupe_done(void)
+{
+	if (!rules_dupe.fp)
+		return;
+
+	log_event("- Rules dupe suppression: "LLu" candidates ("LLu
+	          " crypts) skipped", (unsigned long long)rules_dupe.hits,
+	          (unsigned long long)rules_dupe.crypts);
+	if (john_main_process && rules_dupe.hits)
+		fprintf(stderr, "Rules dupe suppression: "LLu" candidates ("
+		        LLu" crypts) skipped\n",
+		        (unsigned long long)rules_dupe.hits,
+		        (unsigned long long)rules_dupe.crypts);
+
+	MEM_FREE(rules_dupe.fp);
+}
+
+/*
+ * --live-loopback: plaintexts cracked during the session (by us or, through
+ * pot sync, by other sessions) are queued, each word only once, and tried
+ * with all of the rules in between the wordlist's words.  This isn't saved
+ * for --restore, where such words would only be tried by a later --loopback.
+ */
+#define FEEDBACK_HASH_SIZE		0x1000
+
+static struct feedback_word {
+	struct feedback_word *next;	/* within a feedback_hash[] bucket */
+	struct feedback_word *queued;	/* next in queue */
+	char data[1];
+} *feedback_hash[FEEDBACK_HASH_SIZE], *feedback_queue, **feedback_tail;
+
+static char **feedback_rules;
+static int feedback_rule_count;
+static char *(*feedback_apply)(char *word, char *rule, int split, char *last);
+static struct db_main *feedback_db;
+static uint64_t feedback_words;
+static int feedback_active;
+static void (*feedback_next_hook)(char *key, char *ciphertext, int from_pot);
+
+static void feedback_add(char *key, char *ciphertext, int from_pot)
+{
+	struct feedback_word *w;
+	int hash;
+
+	if (feedback_next_hook)
+		feedback_next_hook(key, ciphertext, from_pot);
+
+/* Other nodes of this session try what they crack themselves */
+	if (from_pot && options.node_count)
+		return;
+
+	hash = bloom_hash(key, PLAINTEXT_BUFFER_SIZE, 0) &
+		(FEEDBACK_HASH_SIZE - 1);
+
+	for (w = feedback_hash[hash]; w; w = w->next)
+		if (!strcmp(w->data, key))
+			return;
+
+	w = mem_alloc_tiny(sizeof(*w) + strlen(key), MEM_ALIGN_WORD);
+	strcpy(w->data, key);
+	w->next = feedback_hash[hash];
+	feedback_hash[hash] = w;
+
+	w->queued = NULL;
+	*feedback_tail = w;
+	feedback_tail = &w->queued;
+}
+
+static void feedback_init(struct db_main *db, int rules)
+{
+	struct rpp_context ctx;
+	char *prerule, *rule;
+
+	if ((options.flags & FLG_STACKED) || f_new) {
+		log_event("- Live loopback is not supported with hybrid modes");
+		return;
+	}
+
+	feedback_db = db;
+	feedback_queue = NULL;
+	feedback_tail = &feedback_queue;
+	feedback_words = 0;
+
+	feedback_rules = mem_alloc_tiny(sizeof(char*) * rule_count,
+	                                MEM_ALIGN_WORD);
+	feedback_rule_count = 0;
+
+	if (!rules) {
+		feedback_apply = dummy_rules_apply;
+		feedback_rules[feedback_rule_count++] = "";
+	} else {
+		feedback_apply = rules_apply;
+		if (rpp_init(&ctx, options.activewordlistrules))
+			return;
+		while ((prerule = rpp_next(&ctx)))
+			if ((rule = rules_reject(prerule, -1, NULL, db)))
+				feedback_rules[feedback_rule_count++] =
+					str_alloc_copy(rule);
+	}
+
+	log_event("- Live loopback, with %d rules", feedback_rule_count);
+
+	feedback_next_hook = crk_guess_hook;
+	crk_guess_hook = feedback_add;
+	feedback_active = 1;
+}
+
+/*
+ * Tries the queued words with all of the rules.  Returns non-zero if we
+ * should stop, like crk_process_key().  Our rules_apply() calls reuse the
+ * buffers that the caller's *last may point to, so that is first moved to
+ * keep, its own buffer (unless NULL).
+ */
+static int feedback_crack(char **last_kept, char *keep)
+{
+	struct feedback_word *w;
+	char *word, *last;
+	int i;
+
+	if (keep && *last_kept != keep) {
+		strnzcpy(keep, *last_kept, LINE_BUFFER_SIZE);
+		*last_kept = keep;
+	}
+
+	while ((w = feedback_queue)) {
+		if (!(feedback_queue = w->queued))
+			feedback_tail = &feedback_queue;
+		feedback_words++;
+
+		last = NULL;
+		for (i = 0; i < feedback_rule_count; i++) {
+			if (!(word = feedback_apply(w->data, feedback_rules[i],
+			                            -1, last)))
+				continue;
+			last = word;
+			if (rules_dupe.fp &&
+			    !rules_dupe_unique(word, feedback_db->salt_count))
+				continue;
+			if (ext_filter(word))
+			if (crk_process_key(word))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void feedback_done(void)
+{
+	if (!feedback_active)
+		return;
+
+/* Words cracked by the last few candidates, and so on */
+	while (!event_abort && feedback_db->salts) {
+		if (crk_flush() || !feedback_queue || feedback_crack(NULL, NULL))
+			break;
+	}
+
+	crk_guess_hook = feedback_next_hook;
+	feedback_active = 0;
+
+	log_event("- Live loopback: "LLu" words tried",
+	          (unsigned long long)feedback_words);
+}
+
 void do_wordlist_crack(struct db_main *db, char *name, int rules)
 {
 	union {
@@ -594,7 +823,7 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 	unsigned long my_words=0, their_words=0, my_words_left=0;
 	int64_t file_len = 0;
 	int i, pipe_input = 0, max_pipe_words = 0, rules_keep = 0;
-	int init_once = 1;
+	int init_once = 1, setup_once = 1;
 #if HAVE_WINDOWS_H
 	IPC_Item *pIPC=NULL;
 #endif
@@ -1127,6 +1356,17 @@ REDO_AFTER_LMLOOP:
 		crk_init(db, fix_state, NULL);
 	}
 
+/* Not in the above, which --pipe does on its own */
+	if (setup_once) {
+		setup_once = 0;
+
+		if (rules && dupeCheck)
+			rules_dupe_init();
+
+		if (options.flags & FLG_LIVE_LOOPBACK)
+			feedback_init(db, rules);
+	}
+
 	prerule = rule = "";
 	if (rules)
 		prerule = rpp_next(&ctx);
@@ -1219,6 +1459,14 @@ REDO_AFTER_LMLOOP:
 		   at start of session */
 		if (rule && do_lmloop && (joined = db->plaintexts->head))
 		do {
+			if (feedback_queue &&
+			    feedback_crack(&last, aligned.buffer[1])) {
+				rule = NULL;
+				rules = 0;
+				pipe_input = 0;
+				do_lmloop = 0;
+				break;
+			}
 			if (options.node_count && !dist_rules) {
 				int for_node = loop_line_no %
 					options.node_count + 1;
@@ -1232,6 +1480,9 @@ REDO_AFTER_LMLOOP:
 			loop_line_no++;
 			if ((word = apply(joined->data, rule, -1, last))) {
 				last = word;
+				if (rules_dupe.fp &&
+				    !rules_dupe_unique(word, db->salt_count))
+					continue;
 #if HAVE_REXGEN
 				if (regex) {
 					if (do_regex_hybrid_crack(db, regex,
@@ -1281,6 +1532,13 @@ REDO_AFTER_LMLOOP:
 
 		else if (rule && nWordFileLines)
 		while (line_number < nWordFileLines) {
+/* Before we advance, so that fix_state() can't skip an untried line */
+			if (feedback_queue &&
+			    feedback_crack(&last, aligned.buffer[1])) {
+				rules = 0;
+				pipe_input = 0;
+				break;
+			}
 			if (options.node_count && !myWordFileLines)
 			if (!dist_rules) {
 				int for_node = line_number %
@@ -1301,6 +1559,9 @@ REDO_AFTER_LMLOOP:
 
 			if ((word = apply(line, rule, -1, last))) {
 				last = word;
+				if (rules_dupe.fp &&
+				    !rules_dupe_unique(word, db->salt_count))
+					continue;
 #if HAVE_REXGEN
 				if (regex) {
 					if (do_regex_hybrid_crack(db, regex,
@@ -1378,6 +1639,10 @@ process_word:
 						last = word;
 					else
 						strcpy(last, word);
+					if (rules_dupe.fp &&
+					    !rules_dupe_unique(word,
+					                       db->salt_count))
+						goto next_word;
 #if HAVE_REXGEN
 					if (regex) {
 						if (do_regex_hybrid_crack(
@@ -1418,6 +1683,13 @@ process_word:
 					}
 				}
 next_word:
+/* Only once this line is fully in, for the same reason */
+				if (feedback_queue &&
+				    feedback_crack(&last, aligned.buffer[1])) {
+					rules = 0;
+					pipe_input = 0;
+					break;
+				}
 				if (--my_words_left)
 					continue;
 				if (skip_lines(their_words, line))
@@ -1476,9 +1748,12 @@ next_rule:
 	if (pipe_input)
 		goto GRAB_NEXT_PIPE_LOAD;
 
+	feedback_done();
 	crk_done();
 	rec_done(event_abort || (status.pass && db->salts));
 
+	rules_dupe_done();
+
 	if (ferror(word_file)) pexit("fgets");
 
 	if (max_pipe_words)  // pipe_input was already cleared.
@@ -0,0 +1,52 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * On-disk cache of WPA PMKs, PBKDF2-HMAC-SHA1(password, ESSID, 4096, 32),
+ * enabled with WPAPMKCache = FILE in john.conf.  The file is read (memory
+ * mapped where possible) once, and PMKs computed by this run are appended
+ * to it so that later runs against the same ESSIDs can skip the PBKDF2.
+ */
+
+#ifndef _JOHN_WPAPSK_PMK_CACHE_H
+#define _JOHN_WPAPSK_PMK_CACHE_H
+
+#include <stdint.h>
+
+/*
+ * Opens the cache file named in john.conf, if any.  Returns non-zero if
+ * the cache is in use.  Safe to call more than once.
+ */
+extern int pmk_cache_init(void);
+
+/*
+ * Looks up the PMK for key under the essidlen bytes of essid (which may
+ * include NULs).  Returns non-zero and fills in pmk (the PMK bytes, as the
+ * formats keep them) if it is cached.
+ */
+extern int pmk_cache_get(const char *essid, int essidlen,
+	const unsigned char *key, int keylen, uint32_t *pmk);
+
+/*
+ * Queues a PMK to be appended to the cache file.
+ */
+extern void pmk_cache_put(const char *essid, int essidlen,
+	const unsigned char *key, int keylen, const uint32_t *pmk);
+
+/*
+ * Writes out the queued PMKs.
+ */
+extern void pmk_cache_flush(void);
+
+/*
+ * Flushes, then unmaps and closes the cache file.
+ */
+extern void pmk_cache_done(void);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ *
+ * The cache file is a 16 byte header followed by fixed size records, which
+ * are only ever appended.  An index of the records is built in memory when
+ * the file is opened; records appended by this run aren't indexed, since
+ * PMKs for a given ESSID are reused within a run anyway.
+ */
+
+#include "os.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !AC_BUILT || HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
+#if defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "memory.h"
+#include "config.h"
+#include "logger.h"
+#include "wpapsk_pmk_cache.h"
+#include "memdbg.h"
+
+#define PMK_CACHE_MAGIC		"JtR PMK cache 2\n"
+#define PMK_CACHE_MAGIC_LEN	16
+
+typedef struct {
+	char essid[32];			/* NUL padded */
+	unsigned char key[64];		/* NUL padded */
+	uint32_t essid_len;		/* ESSIDs may contain NULs */
+	uint32_t pmk[8];
+} pmk_cache_rec;
+
+/* The part of a record we look up by */
+#define PMK_CACHE_ID_LEN	(32 + 64 + 4)
+
+static int cache_fd = -1;
+static char *cache_name;
+
+/* The records read when the file was opened, and their index */
+static const pmk_cache_rec *cache_recs;
+static size_t cache_count, cache_map_size;
+static int cache_mapped;
+static uint32_t *cache_index, cache_mask;
+
+/* PMKs waiting to be appended */
+static pmk_cache_rec *cache_queue;
+static int cache_queued, cache_queue_size;
+
+static uint32_t pmk_cache_hash(const unsigned char *id)
+{
+	uint32_t h = 2166136261U;
+	int i;
+
+	for (i = 0; i < PMK_CACHE_ID_LEN; i++)
+		h = (h ^ id[i]) * 16777619U;
+
+	return h;
+}
+
+static void pmk_cache_id(pmk_cache_rec *rec, const char *essid,
+	int essidlen, const unsigned char *key, int keylen)
+{
+	if (essidlen > sizeof(rec->essid))
+		essidlen = sizeof(rec->essid);
+	if (keylen > sizeof(rec->key) - 1)
+		keylen = sizeof(rec->key) - 1;
+	memset(rec, 0, sizeof(*rec));
+	memcpy(rec->essid, essid, essidlen);
+	memcpy(rec->key, key, keylen);
+	rec->essid_len = essidlen;
+}
+
+static void pmk_cache_write(const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = write(cache_fd, p, len);
+
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			log_event("! PMK cache: can't write %s: %s", cache_name,
+			          n < 0 ? strerror(errno) : "short write");
+			close(cache_fd);
+			cache_fd = -1;
+			return;
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+/*
+ * Maps (or reads) the whole records in the file, and indexes them.
+ */
+static void pmk_cache_load(size_t size)
+{
+	size_t i;
+
+	cache_count = (size - PMK_CACHE_MAGIC_LEN) / sizeof(pmk_cache_rec);
+	if (!cache_count)
+		return;
+
+	cache_map_size = PMK_CACHE_MAGIC_LEN +
+		cache_count * sizeof(pmk_cache_rec);
+#if defined(HAVE_MMAP)
+	{
+		void *map = mmap(NULL, cache_map_size, PROT_READ, MAP_SHARED,
+		                 cache_fd, 0);
+
+		if (map != MAP_FAILED) {
+			cache_recs = (pmk_cache_rec*)((char*)map +
+			                              PMK_CACHE_MAGIC_LEN);
+			cache_mapped = 1;
+		}
+	}
+#endif
+	if (!cache_mapped) {
+		char *buf = mem_alloc(cache_map_size);
+
+		if (lseek(cache_fd, 0, SEEK_SET) ||
+		    read(cache_fd, buf, cache_map_size) != cache_map_size) {
+			log_event("! PMK cache: can't read %s", cache_name);
+			MEM_FREE(buf);
+			cache_count = 0;
+			return;
+		}
+		cache_recs = (pmk_cache_rec*)(buf + PMK_CACHE_MAGIC_LEN);
+	}
+
+	for (cache_mask = 15; cache_mask < 2 * cache_count; )
+		cache_mask = cache_mask << 1 | 1;
+	cache_index = mem_calloc(cache_mask + 1, sizeof(*cache_index));
+
+	for (i = 0; i < cache_count; i++) {
+		uint32_t h = pmk_cache_hash((unsigned char*)&cache_recs[i]);
+
+		while (cache_index[h & cache_mask])
+			h++;
+		cache_index[h & cache_mask] = i + 1;
+	}
+}
+
+int pmk_cache_init(void)
+{
+	char magic[PMK_CACHE_MAGIC_LEN];
+	struct stat st;
+	char *name;
+
+	if (cache_fd >= 0)
+		return 1;
+
+	if (!(name = cfg_get_param(SECTION_OPTIONS, NULL, "WPAPMKCache")) ||
+	    !*name)
+		return 0;
+	cache_name = str_alloc_copy(path_expand(name));
+
+	if ((cache_fd = open(cache_name, O_RDWR | O_CREAT | O_APPEND,
+	                     S_IRUSR | S_IWUSR)) < 0 ||
+	    fstat(cache_fd, &st)) {
+		log_event("! PMK cache: can't open %s: %s", cache_name,
+		          strerror(errno));
+		if (cache_fd >= 0)
+			close(cache_fd);
+		cache_fd = -1;
+		return 0;
+	}
+
+	if (!st.st_size) {
+		pmk_cache_write(PMK_CACHE_MAGIC, PMK_CACHE_MAGIC_LEN);
+		log_event("- PMK cache: created %s", cache_name);
+		return cache_fd >= 0;
+	}
+
+	if (st.st_size < PMK_CACHE_MAGIC_LEN ||
+	    read(cache_fd, magic, PMK_CACHE_MAGIC_LEN) != PMK_CACHE_MAGIC_LEN ||
+	    memcmp(magic, PMK_CACHE_MAGIC, PMK_CACHE_MAGIC_LEN)) {
+		log_event("! PMK cache: %s is not a PMK cache file", cache_name);
+		close(cache_fd);
+		cache_fd = -1;
+		return 0;
+	}
+
+/* Drop what an interrupted write may have left, so that appends line up */
+	if ((st.st_size - PMK_CACHE_MAGIC_LEN) % sizeof(pmk_cache_rec) &&
+	    ftruncate(cache_fd, st.st_size - (st.st_size - PMK_CACHE_MAGIC_LEN) %
+	              sizeof(pmk_cache_rec)))
+		log_event("! PMK cache: can't truncate %s", cache_name);
+
+	pmk_cache_load(st.st_size);
+	log_event("- PMK cache: %u PMKs in %s", (unsigned int)cache_count,
+	          cache_name);
+
+	return 1;
+}
+
+int pmk_cache_get(const char *essid, int essidlen,
+	const unsigned char *key, int keylen, uint32_t *pmk)
+{
+	pmk_cache_rec id;
+	uint32_t h, i;
+
+	if (!cache_index)
+		return 0;
+
+	pmk_cache_id(&id, essid, essidlen, key, keylen);
+	h = pmk_cache_hash((unsigned char*)&id);
+	while ((i = cache_index[h & cache_mask])) {
+		if (!memcmp(&cache_recs[i - 1], &id, PMK_CACHE_ID_LEN)) {
+			memcpy(pmk, cache_recs[i - 1].pmk, sizeof(id.pmk));
+			return 1;
+		}
+		h++;
+	}
+
+	return 0;
+}
+
+void pmk_cache_put(const char *essid, int essidlen,
+	const unsigned char *key, int keylen, const uint32_t *pmk)
+{
+	if (cache_fd < 0)
+		return;
+
+	if (cache_queued == cache_queue_size) {
+		cache_queue_size = cache_queue_size ? 2 * cache_queue_size : 256;
+		cache_queue = mem_realloc(cache_queue,
+		                          cache_queue_size * sizeof(*cache_queue));
+	}
+	pmk_cache_id(&cache_queue[cache_queued], essid, essidlen, key,
+	             keylen);
+	memcpy(cache_queue[cache_queued++].pmk, pmk, sizeof(cache_queue->pmk));
+}
+
+void pmk_cache_flush(void)
+{
+/* One write per batch, so that --fork'ed processes don't mix up records */
+	if (cache_fd >= 0 && cache_queued)
+		pmk_cache_write(cache_queue, cache_queued * sizeof(*cache_queue));
+	cache_queued = 0;
+}
+
+void pmk_cache_done(void)
+{
+	pmk_cache_flush();
+
+	if (cache_recs) {
+#if defined(HAVE_MMAP)
+		if (cache_mapped)
+			munmap((char*)cache_recs - PMK_CACHE_MAGIC_LEN,
+			       cache_map_size);
+		else
+#endif
+		{
+			char *buf = (char*)cache_recs - PMK_CACHE_MAGIC_LEN;
+
+			MEM_FREE(buf);
+		}
+	}
+	cache_recs = NULL;
+	cache_mapped = 0;
+	cache_count = 0;
+	MEM_FREE(cache_index);
+	MEM_FREE(cache_queue);
+	cache_queue_size = 0;
+
+	if (cache_fd >= 0)
+		close(cache_fd);
+	cache_fd = -1;
+}
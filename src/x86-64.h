@@ -172,8 +172,6 @@
 #define DES_BS_VECTOR			5
 #define DES_BS_ALGORITHM_NAME		"DES 256/256 AVX-16 + 64/64"
 #elif __AVX2__ || JOHN_AVX2
-/* 256-bit as 1x256 */
-#define DES_BS_VECTOR			4
 #undef CPU_NAME
 #define CPU_NAME			"AVX2"
 #define CPU_DETECT			1
@@ -183,7 +181,17 @@
 #define CPU_FALLBACK_BINARY		"john-non-avx2"
 #define CPU_FALLBACK_BINARY_DEFAULT
 #endif
+#if __AVX512F__
+/* 512-bit as 1x512, with S-boxes made of ternary logic (vpternlogd) */
+#define DES_BS_VECTOR			8
+#undef DES_BS
+#define DES_BS				4
+#define DES_BS_ALGORITHM_NAME		"DES 512/512 AVX512F"
+#else
+/* 256-bit as 1x256 */
+#define DES_BS_VECTOR			4
 #define DES_BS_ALGORITHM_NAME		"DES 256/256 AVX2-16"
+#endif
 #elif 0
 /* 256-bit as 2x128 */
 #define DES_BS_NO_AVX256
@@ -53,7 +53,8 @@ john_register_one(&fmt_zip);
 #include "johnswap.h"
 #include "memory.h"
 #include "pkzip.h"
-#include "pbkdf2_hmac_sha1.h"
+#include "simd-intrinsics.h"
+#include "pbkdf2_hmac_engine.h"
 #include "dyna_salt.h"
 #ifdef _OPENMP
 #include <omp.h>
@@ -104,6 +105,10 @@ typedef struct my_salt_t {
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static unsigned char (*crypt_key)[((WINZIP_BINARY_SIZE+3)/4)*4];
 static my_salt *saved_salt;
+/* Derived bytes, and the PBKDF2 jobs producing them */
+static unsigned char (*derived)[32];
+static pbkdf2_job *jobs;
+static int *hit_index;
 
 
 //    filename:$zip2$*Ty*Mo*Ma*Sa*Va*Le*DF*Au*$/zip2$
@@ -138,10 +143,18 @@ static void init(struct fmt_main *self)
 	                       sizeof(*saved_key));
 	crypt_key = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*crypt_key));
+	derived = mem_calloc(self->params.max_keys_per_crypt,
+	                     sizeof(*derived));
+	jobs = mem_calloc(self->params.max_keys_per_crypt, sizeof(*jobs));
+	hit_index = mem_calloc(self->params.max_keys_per_crypt,
+	                       sizeof(*hit_index));
 }
 
 static void done(void)
 {
+	MEM_FREE(hit_index);
+	MEM_FREE(jobs);
+	MEM_FREE(derived);
 	MEM_FREE(crypt_key);
 	MEM_FREE(saved_key);
 }
@@ -263,7 +276,7 @@ static char *get_key(int index)
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
-	int index;
+	int index, hits = 0;
 
 	if (saved_salt->v.type) {
 		// This salt passed valid() but failed get_salt().
@@ -272,74 +285,50 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		return count;
 	}
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) private(index) shared(count, saved_key, saved_salt, crypt_key)
-#endif
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT) {
-#ifdef SIMD_COEF_32
-		unsigned char pwd_ver[64*MAX_KEYS_PER_CRYPT];
-		int lens[MAX_KEYS_PER_CRYPT], i;
-		int something_hit = 0, hits[MAX_KEYS_PER_CRYPT] = {0};
-		unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
-
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			lens[i] = strlen(saved_key[i+index]);
-			pin[i] = (unsigned char*)saved_key[i+index];
-			pout[i] = &pwd_ver[i*(2+2*KEY_LENGTH(saved_salt->v.mode))];
-		}
-		pbkdf2_sha1_sse((const unsigned char **)pin, lens, saved_salt->salt,
-		                SALT_LENGTH(saved_salt->v.mode), KEYING_ITERATIONS,
-		                pout, 2, 2*KEY_LENGTH(saved_salt->v.mode));
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i)
-			if (!memcmp(pout[i], saved_salt->passverify, 2))
-				something_hit = hits[i] = 1;
-		if (something_hit) {
-			pbkdf2_sha1_sse((const unsigned char **)pin, lens,
-				                saved_salt->salt,
-				                SALT_LENGTH(saved_salt->v.mode),
-				                KEYING_ITERATIONS, pout,
-				                KEY_LENGTH(saved_salt->v.mode),
-				                KEY_LENGTH(saved_salt->v.mode));
-			for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-				if (hits[i]) {
-					hmac_sha1(pout[i], KEY_LENGTH(saved_salt->v.mode),
-				                  (const unsigned char*)saved_salt->datablob,
-				                  saved_salt->comp_len, crypt_key[index+i],
-				                  WINZIP_BINARY_SIZE);
-				}
-				else
-					memset(crypt_key[index+i], 0, WINZIP_BINARY_SIZE);
-			}
-		} else {
-			for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i)
-				memset(crypt_key[index+i], 0, WINZIP_BINARY_SIZE);
-		}
-#else
-		union {
-			unsigned char pwd_ver[64];
-			uint32_t w;
-		} x;
-		unsigned char *pwd_ver = x.pwd_ver;
-
-		pbkdf2_sha1((unsigned char *)saved_key[index], strlen(saved_key[index]),
-		            saved_salt->salt, SALT_LENGTH(saved_salt->v.mode),
-		            KEYING_ITERATIONS, pwd_ver, 2,
-		            2*KEY_LENGTH(saved_salt->v.mode));
-		if (!memcmp(pwd_ver, saved_salt->passverify, 2)) {
-			pbkdf2_sha1((unsigned char *)saved_key[index],
-			            strlen(saved_key[index]), saved_salt->salt,
-			            SALT_LENGTH(saved_salt->v.mode), KEYING_ITERATIONS,
-			            pwd_ver, KEY_LENGTH(saved_salt->v.mode),
-			            KEY_LENGTH(saved_salt->v.mode));
-			hmac_sha1(pwd_ver, KEY_LENGTH(saved_salt->v.mode),
-			          (const unsigned char*)saved_salt->datablob,
-			          saved_salt->comp_len, crypt_key[index],
-			          WINZIP_BINARY_SIZE);
-		}
-		else
+/*
+ * The 2 password verification bytes follow both keys in the derived key.
+ * Only the keys whose verification bytes match have the HMAC key derived,
+ * all of them in one more batch.
+ */
+	for (index = 0; index < count; index++) {
+		jobs[index].key = (unsigned char*)saved_key[index];
+		jobs[index].keylen = strlen(saved_key[index]);
+		jobs[index].salt = saved_salt->salt;
+		jobs[index].saltlen = SALT_LENGTH(saved_salt->v.mode);
+		jobs[index].iterations = KEYING_ITERATIONS;
+		jobs[index].out = derived[index];
+		jobs[index].outlen = 2;
+		jobs[index].skip_bytes = 2 * KEY_LENGTH(saved_salt->v.mode);
+	}
+	pbkdf2_sha1_jobs(jobs, count);
+
+	for (index = 0; index < count; index++) {
+		if (memcmp(derived[index], saved_salt->passverify, 2)) {
 			memset(crypt_key[index], 0, WINZIP_BINARY_SIZE);
+			continue;
+		}
+		jobs[hits] = jobs[index];
+		jobs[hits].outlen = KEY_LENGTH(saved_salt->v.mode);
+		jobs[hits].skip_bytes = KEY_LENGTH(saved_salt->v.mode);
+		hit_index[hits++] = index;
+	}
+	if (!hits)
+		return count;
+
+	pbkdf2_sha1_jobs(jobs, hits);
+
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
+	for (index = 0; index < hits; index++) {
+		int i = hit_index[index];
+
+		hmac_sha1(derived[i], KEY_LENGTH(saved_salt->v.mode),
+		          (const unsigned char*)saved_salt->datablob,
+		          saved_salt->comp_len, crypt_key[i],
+		          WINZIP_BINARY_SIZE);
 	}
+
 	return count;
 }
 